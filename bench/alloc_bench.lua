@@ -0,0 +1,273 @@
+--
+-- allocation budget of the request path.
+--
+-- usage: lua bench/alloc_bench.lua [--check | --update]
+--
+-- it installs the counting allocator of net.http.alloc, and measures the
+-- number of allocations and bytes allocated per call of the following steps
+-- over the requests in bench/corpus.lua:
+--
+--  parse_request   parse.request with the table that receives the result
+--  read_request    Connection:read_request on the keep-alive connection
+--  set_uri         Request:set_uri of the request-target with the query
+--  header_set      Header:set of the typical response header fields
+--  reply           Responder:reply of the text and JSON response
+--
+-- and prints a JSON object per line:
+--
+--  {"step":"read_request","case":"small_get","allocs":...,"bytes":...,
+--   "budget_allocs":...,"budget_bytes":...,"ok":true}
+--
+-- the budgets are loaded from bench/alloc_budget.lua for the running Lua
+-- runtime, since each runtime allocates differently.
+-- with --check, it exits with the status 1 if a step exceeds the budget or a
+-- step of the runtime has no budget. the runtime that has no budget at all is
+-- skipped with a warning.
+-- with --update, it writes the measured values of the runtime to the budget
+-- file. the budget file is committed, and an intended increase is accepted by
+-- committing the file updated with --update.
+--
+package.path = './bench/?.lua;' .. package.path
+local format = string.format
+local concat = table.concat
+local sort = table.sort
+local floor = math.floor
+local alloc = require('net.http.alloc')
+local parse = require('net.http.parse')
+local new_connection = require('net.http.connection').new
+local new_request = require('net.http.message.request').new
+local new_header = require('net.http.header').new
+local new_responder = require('net.http.responder').new
+local new_writer = require('net.http.writer').new
+local corpus = require('corpus')
+
+local NITER = 1000
+local NWARMUP = 100
+local BUDGET_FILE = 'bench/alloc_budget.lua'
+local RUNTIME = jit and jit.version or _VERSION
+-- a measured value may differ from the budget by the rounding error and the
+-- occasional resize of the internal tables of the runtime
+local ALLOCS_TOLERANCE = 0.5
+local BYTES_TOLERANCE = 0.02
+
+local MODE = arg and arg[1]
+if MODE ~= nil and MODE ~= '--check' and MODE ~= '--update' then
+    io.stderr:write('usage: lua bench/alloc_bench.lua [--check | --update]\n')
+    os.exit(2)
+end
+
+--- measure returns the number of allocations and bytes allocated per call of
+--- fn. the arguments of fn are created by prepare before counting.
+--- @param fn function
+--- @param prepare? function
+--- @return number allocs
+--- @return number bytes
+local function measure(fn, prepare)
+    local args = {}
+    for i = 1, NITER + NWARMUP do
+        args[i] = prepare and prepare() or false
+    end
+    for i = 1, NWARMUP do
+        fn(args[i])
+    end
+
+    collectgarbage('collect')
+    collectgarbage('stop')
+    alloc.reset()
+    for i = NWARMUP + 1, NWARMUP + NITER do
+        fn(args[i])
+    end
+    local nalloc, nbytes = alloc.count()
+    collectgarbage('restart')
+    return nalloc / NITER, nbytes / NITER
+end
+
+--- new_sock returns the socket that returns the msg on every read.
+--- @param msg string
+--- @return table sock
+local function new_sock(msg)
+    return {
+        read = function()
+            return msg
+        end,
+        write = function(_, s)
+            return #s
+        end,
+    }
+end
+
+local WRITER = new_writer(new_sock(''))
+WRITER:setbufsize(0)
+
+local STEPS = {}
+
+for _, c in ipairs(corpus.requests) do
+    local msg = c.msg
+    local req = {}
+    assert(parse.request(msg, req))
+    local uri = req.uri
+
+    STEPS[#STEPS + 1] = {
+        step = 'parse_request',
+        case = c.name,
+        fn = function()
+            parse.request(msg, {})
+        end,
+    }
+
+    local conn = new_connection(new_sock(msg))
+    STEPS[#STEPS + 1] = {
+        step = 'read_request',
+        case = c.name,
+        fn = function()
+            assert(conn:read_request())
+        end,
+    }
+
+    STEPS[#STEPS + 1] = {
+        step = 'set_uri',
+        case = c.name,
+        prepare = new_request,
+        fn = function(r)
+            assert(r:set_uri(uri, true))
+        end,
+    }
+end
+
+STEPS[#STEPS + 1] = {
+    step = 'header_set',
+    case = 'response',
+    prepare = new_header,
+    fn = function(h)
+        h:set('Content-Type', 'text/plain')
+        h:set('Content-Length', '12')
+        h:set('Cache-Control', 'no-cache')
+        h:set('Set-Cookie', 'sid=4f2a9c; Path=/; HttpOnly')
+    end,
+}
+
+local function prepare_responder()
+    return new_responder(WRITER)
+end
+
+STEPS[#STEPS + 1] = {
+    step = 'reply',
+    case = 'text',
+    prepare = prepare_responder,
+    fn = function(res)
+        assert(res:reply(200, 'hello world!'))
+    end,
+}
+
+local JSON_DATA = {
+    id = 12345,
+    name = 'example',
+    tags = {
+        'a',
+        'b',
+        'c',
+    },
+}
+STEPS[#STEPS + 1] = {
+    step = 'reply',
+    case = 'json',
+    prepare = prepare_responder,
+    fn = function(res)
+        assert(res:reply(200, JSON_DATA, true))
+    end,
+}
+
+--- load_budgets loads the budget file if exists.
+--- @return table budgets
+local function load_budgets()
+    local f = io.open(BUDGET_FILE)
+    if not f then
+        return {}
+    end
+    f:close()
+    return dofile(BUDGET_FILE)
+end
+
+--- save_budgets writes the budgets to the budget file in a stable order.
+--- @param budgets table
+local function save_budgets(budgets)
+    local runtimes = {}
+    for runtime in pairs(budgets) do
+        runtimes[#runtimes + 1] = runtime
+    end
+    sort(runtimes)
+
+    local lines = {
+        '-- generated by lua bench/alloc_bench.lua --update',
+        'return {',
+    }
+    for _, runtime in ipairs(runtimes) do
+        local list = budgets[runtime]
+        local keys = {}
+        for k in pairs(list) do
+            keys[#keys + 1] = k
+        end
+        sort(keys)
+        lines[#lines + 1] = format('    [%q] = {', runtime)
+        for _, k in ipairs(keys) do
+            local v = list[k]
+            lines[#lines + 1] = format('        [%q] = { allocs = %d, ' ..
+                                           'bytes = %d },', k, v.allocs,
+                                       v.bytes)
+        end
+        lines[#lines + 1] = '    },'
+    end
+    lines[#lines + 1] = '}'
+
+    local f = assert(io.open(BUDGET_FILE, 'w'))
+    assert(f:write(concat(lines, '\n'), '\n'))
+    f:close()
+end
+
+local budgets = load_budgets()
+local budget = budgets[RUNTIME]
+if MODE == '--check' and not budget then
+    io.stderr:write(format('no budget for %s: run with --update and commit ' ..
+                               '%s\n', RUNTIME, BUDGET_FILE))
+    os.exit(0)
+end
+
+assert(alloc.start())
+local measured = {}
+local nfail = 0
+for _, s in ipairs(STEPS) do
+    local key = s.step .. '/' .. s.case
+    local allocs, bytes = measure(s.fn, s.prepare)
+    measured[key] = {
+        allocs = floor(allocs + 0.5),
+        bytes = floor(bytes + 0.5),
+    }
+
+    local line = format('{"step":"%s","case":"%s","allocs":%.2f,"bytes":%.1f',
+                        s.step, s.case, allocs, bytes)
+    local b = budget and budget[key]
+    if b then
+        local ok = allocs <= b.allocs + ALLOCS_TOLERANCE and bytes <= b.bytes *
+                       (1 + BYTES_TOLERANCE)
+        if not ok then
+            nfail = nfail + 1
+        end
+        line = line ..
+                   format(',"budget_allocs":%d,"budget_bytes":%d,"ok":%s',
+                          b.allocs, b.bytes, tostring(ok))
+    elseif MODE == '--check' then
+        nfail = nfail + 1
+        line = line .. ',"ok":false'
+    end
+    print(line .. '}')
+end
+alloc.stop()
+
+if MODE == '--update' then
+    budgets[RUNTIME] = measured
+    save_budgets(budgets)
+elseif MODE == '--check' and nfail > 0 then
+    io.stderr:write(format('%d step(s) exceeded the allocation budget of %s\n',
+                           nfail, RUNTIME))
+    os.exit(1)
+end
@@ -0,0 +1,3 @@
+-- generated by lua bench/alloc_bench.lua --update
+return {
+}
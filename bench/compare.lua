@@ -0,0 +1,46 @@
+--
+-- compares the outputs of bench/parse_bench.lua.
+--
+-- usage: lua bench/compare.lua base.jsonl head.jsonl
+--
+-- it prints the ratio of ns_per_msg and the difference of
+-- alloc_bytes_per_msg for each case.
+--
+local format = string.format
+
+--- load reads the results of the benchmark.
+--- @param pathname string
+--- @return table<string, table> results
+--- @return string[] names
+local function load(pathname)
+    local results = {}
+    local names = {}
+    for line in assert(io.lines(pathname)) do
+        local bench = line:match('"bench":"([^"]+)"')
+        if bench then
+            local name = bench .. '/' .. line:match('"case":"([^"]+)"')
+            results[name] = {
+                ns = tonumber(line:match('"ns_per_msg":([%d.]+)')),
+                alloc = tonumber(line:match('"alloc_bytes_per_msg":([%d.]+)')),
+            }
+            names[#names + 1] = name
+        end
+    end
+    return results, names
+end
+
+local base = load(assert(arg[1], 'base file required'))
+local head, names = load(assert(arg[2], 'head file required'))
+
+print(format('%-28s %12s %12s %8s %10s', 'case', 'base ns', 'head ns',
+             'ratio', 'alloc +/-'))
+for _, name in ipairs(names) do
+    local b = base[name]
+    local h = head[name]
+    if b then
+        print(format('%-28s %12.1f %12.1f %8.3f %10.1f', name, b.ns, h.ns,
+                     h.ns / b.ns, h.alloc - b.alloc))
+    else
+        print(format('%-28s %12s %12.1f %8s %10s', name, '-', h.ns, '-', '-'))
+    end
+end
@@ -0,0 +1,334 @@
+--
+-- end-to-end loopback benchmark of net.http.server and net.http.fetch.
+--
+-- usage: lua bench/loopback_bench.lua [requests] [clients]
+--
+-- it starts the server on the loopback tcp socket and the unix socket, and
+-- drives it from the client processes in the following scenarios:
+--
+--  keepalive       GET on the persistent connection
+--  close           GET with 'Connection: close' on a new connection
+--  pipelined       16 pipelined GETs on the persistent connection
+--  chunked_upload  POST of the 4KB chunked content
+--  static_file     GET of the 64KB file
+--  json            GET of the JSON reply
+--  fetch           GET with net.http.fetch and the default connection pool
+--
+-- and prints a JSON object per line:
+--
+--  {"scenario":"keepalive","transport":"tcp","clients":4,"requests":...,
+--   "rps":...,"p50_us":...,"p99_us":...,"p999_us":...}
+--
+local format = string.format
+local concat = table.concat
+local rep = string.rep
+local ceil = math.ceil
+local sort = table.sort
+local process = require('net.http.process')
+local socket = require('net.http.socket')
+local hrtime = socket.hrtime
+local new_server = require('net.http.server').new
+local new_scheduler = require('net.http.scheduler').new
+local new_responder = require('net.http.responder').new
+local new_connection = require('net.http.connection').new
+local new_inet_client = require('net.stream.inet').client.new
+local new_unix_client = require('net.stream.unix').client.new
+local fetch = require('net.http.fetch')
+
+local NREQ = tonumber(arg and arg[1]) or 10000
+local NCLIENT = tonumber(arg and arg[2]) or 4
+local PORT = 18080
+local SOCKFILE = '/tmp/net-http-loopback-bench.sock'
+local FILENAME = os.tmpname()
+local PIPELINE_DEPTH = 16
+local JSON = {
+    id = 12345,
+    name = 'example',
+    tags = {
+        'foo',
+        'bar',
+        'baz',
+    },
+}
+
+--- sleep sleeps for the msec milliseconds.
+--- @param msec integer
+local function sleep(msec)
+    socket.poll({}, msec)
+end
+
+--- handle serves the requests on the connection.
+--- @param c net.http.connection
+local function handle(c)
+    local req = c:read_request()
+    while req do
+        local res = new_responder(c)
+        c:set_connection_header(res.header)
+        local path = req.path
+        if path == '/json' then
+            res:reply(200, JSON, true)
+        elseif path == '/file' then
+            res:reply_file(200, FILENAME)
+        elseif path == '/upload' then
+            local data = req.content and req.content:readall() or ''
+            res:ok(tostring(#data))
+        else
+            res:ok('hello world!')
+        end
+        if not c:flush() or not c:is_keepalive() then
+            return
+        end
+        req = c:read_request()
+    end
+end
+
+--- start_server starts the server process.
+--- @param addr string
+--- @return integer pid
+local function start_server(addr)
+    local pid = assert(process.fork())
+    if pid == 0 then
+        local s = assert(new_server(addr, {
+            reuseaddr = true,
+        }))
+        assert(s:listen(1024))
+        local sched = assert(new_scheduler())
+        sched:serve(s, handle)
+        assert(sched:run())
+        os.exit(0)
+    end
+    return pid
+end
+
+local function request(method, path, header, body)
+    local lines = {
+        format('%s %s HTTP/1.1', method, path),
+        'Host: localhost',
+    }
+    for i = 1, #(header or {}) do
+        lines[#lines + 1] = header[i]
+    end
+    return concat(lines, '\r\n') .. '\r\n\r\n' .. (body or '')
+end
+
+local GET = request('GET', '/hello')
+local GET_CLOSE = request('GET', '/hello', {
+    'Connection: close',
+})
+local GET_JSON = request('GET', '/json')
+local GET_FILE = request('GET', '/file')
+local CHUNK = rep('x', 1024)
+local POST_CHUNKED = request('POST', '/upload', {
+    'Transfer-Encoding: chunked',
+}, rep(format('%x\r\n%s\r\n', #CHUNK, CHUNK), 4) .. '0\r\n\r\n')
+
+--- send sends the request.
+--- @param c net.http.connection
+--- @param msg string
+local function send(c, msg)
+    assert(c:write(msg))
+    assert(c:flush())
+end
+
+--- recv receives the response and its content.
+--- @param c net.http.connection
+local function recv(c)
+    local res = assert(c:read_response())
+    if res.content then
+        assert(res.content:readall())
+    end
+end
+
+--- roundtrip sends the requests on the persistent connection one by one.
+--- @param msg string
+--- @return function scenario
+local function roundtrip(msg)
+    return function(connect, n, lat)
+        local c = connect()
+        for i = 1, n do
+            local t = hrtime()
+            send(c, msg)
+            recv(c)
+            lat[i] = (hrtime() - t) / 1000
+        end
+        c:close()
+    end
+end
+
+local SCENARIOS = {
+    {
+        name = 'keepalive',
+        run = roundtrip(GET),
+    },
+    {
+        name = 'close',
+        run = function(connect, n, lat)
+            for i = 1, n do
+                local t = hrtime()
+                local c = connect()
+                send(c, GET_CLOSE)
+                recv(c)
+                c:close()
+                lat[i] = (hrtime() - t) / 1000
+            end
+        end,
+    },
+    {
+        name = 'pipelined',
+        run = function(connect, n, lat)
+            local c = connect()
+            local batch = rep(GET, PIPELINE_DEPTH)
+            for _ = 1, ceil(n / PIPELINE_DEPTH) do
+                local t = hrtime()
+                send(c, batch)
+                for _ = 1, PIPELINE_DEPTH do
+                    recv(c)
+                    lat[#lat + 1] = (hrtime() - t) / 1000
+                end
+            end
+            c:close()
+        end,
+    },
+    {
+        name = 'chunked_upload',
+        run = roundtrip(POST_CHUNKED),
+    },
+    {
+        name = 'static_file',
+        run = roundtrip(GET_FILE),
+    },
+    {
+        name = 'json',
+        run = roundtrip(GET_JSON),
+    },
+    {
+        name = 'fetch',
+        run = function(_, n, lat, transport)
+            local uri = format('http://127.0.0.1:%d/hello', PORT)
+            local opts = transport == 'unix' and {
+                sockfile = SOCKFILE,
+            } or nil
+            for i = 1, n do
+                local t = hrtime()
+                local res = assert(fetch(uri, opts))
+                assert(res.content:readall())
+                lat[i] = (hrtime() - t) / 1000
+            end
+        end,
+    },
+}
+
+local CONNECT = {
+    tcp = function()
+        return new_connection(assert(new_inet_client('127.0.0.1', PORT)))
+    end,
+    unix = function()
+        return new_connection(assert(new_unix_client(SOCKFILE)))
+    end,
+}
+
+--- run_clients runs the scenario in the client processes, and returns the
+--- latencies in microseconds and the elapsed nanoseconds.
+--- @param scenario table
+--- @param transport string
+--- @return number[] lat
+--- @return integer elapsed
+local function run_clients(scenario, transport)
+    local files = {}
+    local pids = {}
+    for i = 1, NCLIENT do
+        files[i] = os.tmpname()
+        local pid = assert(process.fork())
+        if pid == 0 then
+            local lat = {}
+            local start = hrtime()
+            scenario.run(CONNECT[transport], ceil(NREQ / NCLIENT), lat,
+                         transport)
+            local f = assert(io.open(files[i], 'w'))
+            f:write(format('%d %d\n', start, hrtime()))
+            f:write(concat(lat, '\n'), '\n')
+            f:close()
+            os.exit(0)
+        end
+        pids[pid] = true
+    end
+
+    -- wait for the clients
+    local nclient = NCLIENT
+    while nclient > 0 do
+        local pid, status = process.reap()
+        if not pid then
+            sleep(10)
+        elseif pids[pid] then
+            assert(status == 0, format('%s/%s: client exited with %s',
+                                       scenario.name, transport,
+                                       tostring(status)))
+            nclient = nclient - 1
+        end
+    end
+
+    -- collect the results
+    local lat = {}
+    local first, last
+    for i = 1, NCLIENT do
+        local f = assert(io.open(files[i]))
+        local start, finish = f:read('*n', '*n')
+        first = (not first or start < first) and start or first
+        last = (not last or finish > last) and finish or last
+        for v in f:lines() do
+            lat[#lat + 1] = tonumber(v)
+        end
+        f:close()
+        os.remove(files[i])
+    end
+    return lat, last - first
+end
+
+--- percentile
+--- @param lat number[] sorted latencies
+--- @param q number
+--- @return number
+local function percentile(lat, q)
+    return lat[ceil(#lat * q)] or 0
+end
+
+-- create the static file
+local f = assert(io.open(FILENAME, 'w'))
+f:write(rep('0123456789abcdef', 4096))
+f:close()
+
+for _, transport in ipairs({
+    'tcp',
+    'unix',
+}) do
+    os.remove(SOCKFILE)
+    local addr = transport == 'tcp' and '127.0.0.1:' .. PORT or SOCKFILE
+    local pid = start_server(addr)
+    -- wait for the server to listen
+    for _ = 1, 100 do
+        local ok, c = pcall(CONNECT[transport])
+        if ok then
+            c:close()
+            break
+        end
+        sleep(10)
+    end
+
+    for _, scenario in ipairs(SCENARIOS) do
+        local lat, elapsed = run_clients(scenario, transport)
+        sort(lat)
+        print(format('{"scenario":"%s","transport":"%s","clients":%d,' ..
+                         '"requests":%d,"rps":%.0f,"p50_us":%.1f,' ..
+                         '"p99_us":%.1f,"p999_us":%.1f}', scenario.name,
+                     transport, NCLIENT, #lat, #lat / (elapsed / 1e9),
+                     percentile(lat, 0.5), percentile(lat, 0.99),
+                     percentile(lat, 0.999)))
+    end
+
+    process.kill(pid, process.SIGTERM)
+    while not process.reap() do
+        sleep(10)
+    end
+end
+os.remove(FILENAME)
+os.remove(SOCKFILE)
@@ -0,0 +1,95 @@
+--
+-- parser micro-benchmark.
+--
+-- usage: lua bench/parse_bench.lua [seconds]
+--
+-- it runs parse.request, parse.response, parse.header and parse.chunksize
+-- over the messages in bench/corpus.lua, and prints a JSON object per line:
+--
+--  {"bench":"request","case":"small_get","bytes":37,"iterations":...,
+--   "ns_per_msg":...,"bytes_per_sec":...,"alloc_bytes_per_msg":...}
+--
+-- alloc_bytes_per_msg is the number of bytes allocated in the Lua heap per
+-- message, including the table that receives the result.
+-- the first line describes the environment of the benchmark.
+-- use bench/compare.lua to compare the outputs of two commits.
+--
+package.path = './bench/?.lua;' .. package.path
+local format = string.format
+local clock = os.clock
+local parse = require('net.http.parse')
+local corpus = require('corpus')
+
+local DURATION = tonumber(arg and arg[1]) or 0.5
+
+--- measure calls the fn with the msg repeatedly for the DURATION seconds.
+--- @param fn function
+--- @param msg string
+--- @return integer n the number of iterations
+--- @return number elapsed the seconds
+local function measure(fn, msg)
+    local n = 1
+    while true do
+        local t = clock()
+        for _ = 1, n do
+            fn(msg, {})
+        end
+        local elapsed = clock() - t
+        if elapsed >= DURATION then
+            return n, elapsed
+        end
+        -- estimate the number of iterations that takes the DURATION seconds
+        if elapsed < DURATION / 100 then
+            n = n * 100
+        else
+            n = math.ceil(n * DURATION * 1.1 / elapsed)
+        end
+    end
+end
+
+--- allocated returns the number of bytes allocated per call of fn.
+--- @param fn function
+--- @param msg string
+--- @return number bytes
+local function allocated(fn, msg)
+    local n = 1000
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local before = collectgarbage('count')
+    for _ = 1, n do
+        fn(msg, {})
+    end
+    local after = collectgarbage('count')
+    collectgarbage('restart')
+    return (after - before) * 1024 / n
+end
+
+--- run runs the benchmark of the cases.
+--- @param bench string
+--- @param fn function
+--- @param cases table[]
+local function run(bench, fn, cases)
+    for _, c in ipairs(cases) do
+        local msg = c.msg
+        -- verify the message before measuring
+        local ok, err = fn(msg, {})
+        if not ok then
+            error(format('%s/%s: %s', bench, c.name, tostring(err)))
+        end
+
+        fn(msg, {})
+        local n, elapsed = measure(fn, msg)
+        print(format('{"bench":"%s","case":"%s","bytes":%d,"iterations":%d,' ..
+                         '"ns_per_msg":%.1f,"bytes_per_sec":%.0f,' ..
+                         '"alloc_bytes_per_msg":%.1f}', bench, c.name, #msg,
+                     n, elapsed * 1e9 / n, #msg * n / elapsed,
+                     allocated(fn, msg)))
+    end
+end
+
+print(format('{"lua":"%s","simd":"%s","duration":%g}',
+             jit and jit.version or _VERSION, parse.SIMD, DURATION))
+run('request', parse.request, corpus.requests)
+run('response', parse.response, corpus.responses)
+run('header', parse.header, corpus.headers)
+run('chunksize', parse.chunksize, corpus.chunksizes)
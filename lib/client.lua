@@ -0,0 +1,347 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local concat = table.concat
+local is_string = require('lauxhlib.is').str
+local is_table = require('lauxhlib.is').table
+local is_file = require('lauxhlib.is').file
+local is_boolean = require('lauxhlib.is').bool
+local fatalf = require('error').fatalf
+local is_error = require('error').is
+local errno = require('errno')
+local new_errno = errno.new
+local new_inet_client = require('net.stream.inet').client.new
+local new_unix_client = require('net.stream.unix').client.new
+local new_connection = require('net.http.connection').new
+local new_pool = require('net.http.pool').new
+local encode_query = require('net.http.query').encode
+local new_header = require('net.http.header').new
+local new_request = require('net.http.message.request').new
+local instanceof = require('metamodule').instanceof
+--- constants
+local DEFAULT_UA = 'lua-net-http'
+local DEFAULT_POOL = new_pool()
+local WELL_KNOWN_PORT = {
+    http = '80',
+    https = '443',
+}
+-- the request of these methods can be retried automatically
+-- https://datatracker.ietf.org/doc/html/rfc9110#section-9.2.2
+local IDEMPOTENT_METHODS = {
+    GET = true,
+    HEAD = true,
+    OPTIONS = true,
+    PUT = true,
+    DELETE = true,
+    TRACE = true,
+}
+
+--- @class net.http.client.target
+--- @field req net.http.message.request
+--- @field port string
+--- @field key string the key of the connection pool
+--- @field pool net.http.pool|false
+--- @field opts table
+
+--- prepare verifies the options and creates the request to the uri.
+--- it throws an error to the caller of the caller if the arguments are
+--- invalid.
+--- @param uri string
+--- @param opts? table<string, any>
+--- @return net.http.client.target? target
+--- @return any err
+local function prepare(uri, opts)
+    if not is_string(uri) then
+        fatalf(3, 'uri must be string')
+    elseif opts == nil then
+        opts = {}
+    elseif not is_table(opts) then
+        fatalf(3, 'opts must be table')
+    end
+    --[[@cast opts table]]
+
+    -- verify options
+    if opts.sockfile ~= nil and not is_string(opts.sockfile) then
+        fatalf(3, 'opts.sockfile must be string')
+    elseif opts.content ~= nil and not is_string(opts.content) and
+        not is_file(opts.content) and
+        not instanceof(opts.content, 'net.http.content') and
+        not instanceof(opts.content, 'net.http.form') then
+        fatalf(3,
+               'opts.content must be string, net.http.content or net.http.form')
+    elseif opts.retry ~= nil and not is_boolean(opts.retry) then
+        fatalf(3, 'opts.retry must be boolean')
+    end
+
+    local pool = opts.pool
+    if pool == nil then
+        pool = DEFAULT_POOL
+    elseif pool ~= false and not instanceof(pool, 'net.http.pool') then
+        fatalf(3, 'opts.pool must be net.http.pool or false')
+    end
+
+    local req = new_request()
+
+    -- set header
+    if opts.header then
+        if instanceof(opts.header, 'net.http.header') then
+            req.header = opts.header
+        elseif is_table(opts.header) then
+            req.header = new_header(opts.header)
+        else
+            fatalf(3, 'opts.header must be table or net.http.header')
+        end
+    end
+
+    -- set default User-Agent
+    if not req.header:get('User-Agent') then
+        req.header:set('User-Agent', DEFAULT_UA)
+    end
+
+    -- set uri
+    local ok, err = req:set_uri(uri)
+    if not ok then
+        return nil, err
+    end
+
+    -- verify scheme
+    if not req.scheme then
+        return nil, new_errno('EINVAL', 'url scheme not defined')
+    end
+    local port = WELL_KNOWN_PORT[req.scheme]
+    if not port then
+        return nil, new_errno('EINVAL', 'unsupported url scheme')
+    elseif req.port then
+        -- use custom port
+        port = req.port
+    end
+
+    -- set method
+    if opts.method then
+        ok, err = req:set_method(opts.method)
+        if not ok then
+            return nil, err
+        end
+    end
+
+    -- set version
+    if opts.version then
+        ok, err = req:set_version(opts.version)
+        if not ok then
+            return nil, err
+        end
+    end
+
+    -- set query
+    if opts.query then
+        req.query = encode_query(opts.query)
+    end
+
+    -- set default path
+    if not req.path then
+        req.path = '/'
+    end
+
+    return {
+        req = req,
+        port = port,
+        -- the connections are shared among the requests to the same endpoint
+        key = concat({
+            req.scheme,
+            req.hostname,
+            port,
+            opts.sockfile or '',
+            opts.servername or '',
+            opts.insecure == true and 'insecure' or '',
+        }, '|'),
+        pool = pool,
+        opts = opts,
+    }
+end
+
+--- is_retryable returns true if the request that failed on the reused
+--- connection can be sent again on a new connection. it is retried only if
+--- the connection seems to have been closed by the peer before any bytes of
+--- the response are received, and the content of the request can be sent
+--- again. the request of the non-idempotent method is retried only if
+--- opts.retry is true.
+--- @param c net.http.connection
+--- @param target net.http.client.target
+--- @param err any
+--- @param timeout? boolean
+--- @return boolean ok
+local function is_retryable(c, target, err, timeout)
+    local opts = target.opts
+    local content = opts.content
+    if timeout or (content ~= nil and not is_string(content)) or
+        (not IDEMPOTENT_METHODS[target.req.method] and opts.retry ~= true) then
+        return false
+    elseif err and not is_error(err, errno.EPIPE) and
+        not is_error(err, errno.ECONNRESET) then
+        -- the malformed response or the other failure
+        return false
+    end
+    return c.reader:size() == 0
+end
+
+--- connect checks out the idle connection from the pool, or establishes the
+--- new connection to the target.
+--- if the target uses the pool, the slot of the active connection is
+--- acquired, and it must be released by close() or release().
+--- @param target net.http.client.target
+--- @param reuse boolean
+--- @return net.http.connection? c
+--- @return any err
+--- @return boolean? timeout
+--- @return boolean? reused
+local function connect(target, reuse)
+    local pool = target.pool
+    if pool then
+        local ok, err = pool:acquire(target.key)
+        if not ok then
+            return nil, err
+        elseif reuse then
+            local c = pool:get(target.key)
+            if c then
+                return c, nil, nil, true
+            end
+        end
+    end
+
+    local req = target.req
+    local opts = target.opts
+    local tlscfg
+    if req.scheme == 'https' then
+        -- create tls config
+        tlscfg = {}
+        if opts.insecure == true then
+            tlscfg.noverify_cert = true
+            tlscfg.noverify_name = true
+            tlscfg.noverify_time = true
+        end
+    end
+
+    -- create client
+    local sock, err, timeout
+    if opts.sockfile == nil then
+        sock, err, timeout = new_inet_client(req.hostname, target.port, {
+            deadline = opts.deadline,
+            tlscfg = tlscfg,
+            servername = opts.servername,
+        })
+    else
+        sock, err, timeout = new_unix_client(opts.sockfile, {
+            deadline = opts.deadline,
+            tlscfg = tlscfg,
+            servername = opts.servername,
+        })
+    end
+    if not sock then
+        if pool then
+            pool:release(target.key)
+        end
+        return nil, err, timeout
+    end
+
+    -- create new client connection
+    return new_connection(sock)
+end
+
+--- close closes the connection, and releases the slot of the active
+--- connection of the target.
+--- @param c net.http.connection
+--- @param target net.http.client.target
+local function close(c, target)
+    c:close()
+    if target.pool then
+        target.pool:release(target.key)
+    end
+end
+
+--- send sends the request to the connection.
+--- the request can be sent again on the new connection after the failure.
+--- @param c net.http.connection
+--- @param target net.http.client.target
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function send(c, target)
+    local req = target.req
+    local opts = target.opts
+    local content = opts.content
+    -- the header may have been sent on the previous connection
+    req.header_sent = nil
+    local n, err, timeout
+    if content == nil then
+        n, err, timeout = req:write_header(c)
+    elseif is_string(content) then
+        n, err, timeout = req:write(c, content)
+    elseif is_file(content) then
+        n, err, timeout = req:write_file(c, content)
+    elseif instanceof(content, 'net.http.content') then
+        n, err, timeout = req:write_content(c, content)
+    else
+        n, err, timeout = req:write_form(c, content, opts.boundary)
+    end
+    if not n or timeout then
+        return false, err, timeout
+    end
+
+    n, err, timeout = c:flush()
+    if not n then
+        return false, err, timeout
+    end
+    return true
+end
+
+--- release returns the connection to the pool when the response content has
+--- been consumed.
+--- @param c net.http.connection
+--- @param target net.http.client.target
+--- @param res net.http.message.response
+local function release(c, target, res)
+    local req = target.req
+    local pool = target.pool
+    local reuse = pool and c:is_keepalive() and req:is_keepalive()
+    local function done()
+        if reuse then
+            pool:put(target.key, c)
+        else
+            close(c, target)
+        end
+    end
+
+    if res.content then
+        res.content:onconsumed(done)
+    else
+        done()
+    end
+end
+
+return {
+    prepare = prepare,
+    is_retryable = is_retryable,
+    connect = connect,
+    close = close,
+    send = send,
+    release = release,
+}
@@ -0,0 +1,236 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local ipairs = ipairs
+local tonumber = tonumber
+local concat = table.concat
+local find = string.find
+local gmatch = string.gmatch
+local lower = string.lower
+local match = string.match
+local pcall = pcall
+local errorf = require('error').format
+local new_errno = require('errno').new
+local new_chunk_handler = require('net.http.content.chunked').new_handler
+-- net.http.zstream is installed by the net-http-zstream rock that requires
+-- zlib. without it, the content is never compressed.
+local has_zstream, zstream = pcall(require, 'net.http.zstream')
+local new_zstream = has_zstream and zstream.new or function()
+    return nil, new_errno('ENOTSUP', 'net.http.zstream is not installed')
+end
+--- constants
+-- the content-codings in order of preference
+local ENCODINGS = has_zstream and {
+    'gzip',
+    'deflate',
+} or {}
+-- the media types that are compressible except text/* and the structured
+-- syntax suffixes +json and +xml.
+-- the media types of the compressed data, such as image/png, application/zip
+-- and font/woff2, are not listed.
+local COMPRESSIBLE = {
+    ['application/javascript'] = true,
+    ['application/json'] = true,
+    ['application/wasm'] = true,
+    ['application/x-javascript'] = true,
+    ['application/x-www-form-urlencoded'] = true,
+    ['application/xml'] = true,
+    ['font/otf'] = true,
+    ['font/ttf'] = true,
+    ['image/bmp'] = true,
+    ['image/x-icon'] = true,
+}
+local INCOMPRESSIBLE = {
+    -- the events must be delivered without waiting for the compressor
+    ['text/event-stream'] = true,
+}
+
+--- negotiate selects the content-coding from the Accept-Encoding header value.
+--- if the value is nil, or no content-coding is acceptable, returns nil.
+--- the default candidates are empty if net.http.zstream is not installed.
+--- @param val? string|string[]
+--- @param encodings? string[] the candidates in order of preference
+--- @return string? encoding
+local function negotiate(val, encodings)
+    if type(val) == 'table' then
+        val = concat(val, ',')
+    end
+    if not val then
+        return nil
+    end
+
+    -- Accept-Encoding  = #( codings [ weight ] )
+    -- codings          = content-coding / "identity" / "*"
+    local qvalues = {}
+    for coding in gmatch(val, '[^,]+') do
+        local name, params = match(coding, '^%s*([^%s;]+)%s*(.*)$')
+        if name then
+            name = lower(name)
+            if name == 'x-gzip' then
+                name = 'gzip'
+            end
+            local q = match(params, '^;%s*[qQ]%s*=%s*([%d.]+)')
+            qvalues[name] = q and tonumber(q) or 1
+        end
+    end
+
+    local any = qvalues['*']
+    local encoding, maxq
+    for _, v in ipairs(encodings or ENCODINGS) do
+        local q = qvalues[v] or any
+        if q and q > 0 and (not maxq or q > maxq) then
+            encoding, maxq = v, q
+        end
+    end
+    return encoding
+end
+
+--- is_compressible returns true if the content of the Content-Type header
+--- value is worth compressing.
+--- @param val? string
+--- @return boolean ok
+local function is_compressible(val)
+    local mime = val and match(val, '^%s*([^%s;]+)')
+    if not mime then
+        return false
+    end
+    mime = lower(mime)
+    if INCOMPRESSIBLE[mime] then
+        return false
+    end
+    return COMPRESSIBLE[mime] == true or find(mime, '^text/') ~= nil or
+               find(mime, '%+json$') ~= nil or find(mime, '%+xml$') ~= nil
+end
+
+--- compress compresses the data into the content-coding at once.
+--- @param encoding string 'gzip' or 'deflate'
+--- @param data string
+--- @param level? integer the compression level from -1 to 9
+--- @return string? data
+--- @return any err
+local function compress(encoding, data, level)
+    local stream, err = new_zstream(encoding, level)
+    if not stream then
+        return nil, errorf('failed to compress()', err)
+    end
+
+    local head
+    head, err = stream:update(data)
+    if not head then
+        stream:close()
+        return nil, errorf('failed to compress()', err)
+    end
+
+    local tail
+    tail, err = stream:finish()
+    if not tail then
+        return nil, errorf('failed to compress()', err)
+    end
+    return head .. tail
+end
+
+--- @class net.http.compress.Compressor : net.http.content.chunked.Handler
+--- @field stream net.http.zstream
+--- @field handler net.http.content.chunked.Handler
+local Compressor = {}
+
+--- init creates the chunk handler that compresses the content of the chunked
+--- transfer coding.
+--- @param encoding string 'gzip' or 'deflate'
+--- @param level? integer the compression level from -1 to 9
+--- @param handler? net.http.content.chunked.Handler the handler that writes
+--- the compressed chunks
+--- @return net.http.compress.Compressor? compressor
+--- @return any err
+function Compressor:init(encoding, level, handler)
+    local stream, err = new_zstream(encoding, level)
+    if not stream then
+        return nil, errorf('failed to create a compressor', err)
+    end
+    self.stream = stream
+    self.handler = handler or new_chunk_handler()
+    return self
+end
+
+--- write_chunk compresses the data, and writes the compressed bytes as a
+--- chunk if the compressor produced any.
+--- @param w net.http.writer
+--- @param s string
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Compressor:write_chunk(w, s)
+    local data, err = self.stream:update(s)
+    if not data then
+        return nil, errorf('failed to write_chunk()', err)
+    elseif #data == 0 then
+        return 0
+    end
+    return self.handler:write_chunk(w, data)
+end
+
+--- write_last_chunk writes the rest of the compressed bytes, and the
+--- last-chunk.
+--- @param w net.http.writer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Compressor:write_last_chunk(w)
+    local data, err = self.stream:finish()
+    if not data then
+        return nil, errorf('failed to write_last_chunk()', err)
+    end
+
+    local len = 0
+    if #data > 0 then
+        local n, timeout
+        n, err, timeout = self.handler:write_chunk(w, data)
+        if not n or timeout then
+            return n, err, timeout
+        end
+        len = n
+    end
+
+    local n, timeout
+    n, err, timeout = self.handler:write_last_chunk(w)
+    if not n then
+        return nil, err, timeout
+    end
+    return len + n
+end
+
+--- write_trailer
+--- @param w net.http.writer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Compressor:write_trailer(w)
+    return self.handler:write_trailer(w)
+end
+
+return {
+    negotiate = negotiate,
+    is_compressible = is_compressible,
+    compress = compress,
+    new = require('metamodule').new(Compressor),
+}
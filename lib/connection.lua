@@ -20,28 +20,47 @@
 -- THE SOFTWARE.
 --
 --- assign to local
-local sub = string.sub
+local type = type
+local select = select
 local errorf = require('error').format
+local fatalf = require('error').fatalf
+local is_pint = require('lauxhlib.is').pint
+local is_finite = require('lauxhlib.is').finite
 local new_reader = require('net.http.reader').new
 local new_writer = require('net.http.writer').new
 local new_request = require('net.http.message.request').new
 local new_response = require('net.http.message.response').new
 local new_content = require('net.http.content').new
 local new_chunked_content = require('net.http.content.chunked').new
+local is_alive = require('net.http.socket').is_alive
 local parse = require('net.http.parse')
-local parse_request = parse.request
-local parse_response = parse.response
+local metrics = require('net.http.metrics')
+local new_parser = parse.new
+local parse_requests = parse.requests
 --- constants
 -- need more bytes
 local EAGAIN = parse.EAGAIN
 local EMSG = parse.EMSG
 --- parse error code to http status code
 local DEFAULT_READSIZE = 4096
+local DEFAULT_MAXREQS = 32
+-- the socket of the content that has already been received
+local NOSOCK = {
+    read = function()
+    end,
+}
 
 --- @class net.http.connection
 --- @field protected sock net.stream.Socket
 --- @field protected reader net.http.reader
 --- @field protected writer net.http.writer
+--- @field protected parser net.http.parse.parser
+--- @field protected pending? net.http.message
+--- @field protected message? net.http.message the last received message
+--- @field protected nmsg integer the number of received messages
+--- @field protected max_requests? integer
+--- @field protected idle_timeout? number
+--- @field keepalive boolean
 --- @field content net.http.content
 local Connection = {}
 
@@ -54,9 +73,119 @@ function Connection:init(sock)
     self.readsize = DEFAULT_READSIZE
     self.reader = new_reader(sock)
     self.writer = new_writer(sock)
+    self.parser = new_parser()
+    self.keepalive = true
+    self.nmsg = 0
     return self
 end
 
+--- set_max_requests sets the maximum number of messages to be received on
+--- the connection. the connection does not persist after the last message.
+--- @param n? integer
+function Connection:set_max_requests(n)
+    if n ~= nil and not is_pint(n) then
+        fatalf(2, 'n must be integer greater than 0')
+    end
+    self.max_requests = n
+    if n and self.nmsg >= n then
+        self.keepalive = false
+    end
+end
+
+--- set_idle_timeout sets the timeout seconds to wait for the next message on
+--- the persistent connection. it is applied with the rcvtimeo() method of the
+--- socket while no bytes of the next message are received.
+--- @param sec? number
+function Connection:set_idle_timeout(sec)
+    if sec ~= nil and (not is_finite(sec) or sec <= 0) then
+        fatalf(2, 'sec must be finite-number greater than 0')
+    end
+    self.idle_timeout = sec
+end
+
+--- is_alive returns true if the idle connection can be reused.
+--- it returns false if the peer has closed the connection, or the unexpected
+--- bytes have been received.
+--- @return boolean ok
+function Connection:is_alive()
+    local msg = self.message
+    local content = msg and msg.content
+    if not self.keepalive or self.pending or self.reader:size() > 0 or
+        (content and not content.is_consumed) then
+        return false
+    end
+
+    local fd = self:fd()
+    if fd then
+        return is_alive(fd)
+    end
+    return true
+end
+
+--- is_keepalive returns true if the connection persists after the last
+--- received message.
+--- @return boolean ok
+function Connection:is_keepalive()
+    return self.keepalive
+end
+
+--- has_pipelined returns true if the bytes of the next message have already
+--- been received. the responses of the pipelined requests can be written to
+--- the buffer and flushed at once after the last one, by calling flush() only
+--- when it returns false. the small responses are copied into the buffer of
+--- the writer, and only the large data is written by writev or sendfile.
+--- @return boolean ok
+function Connection:has_pipelined()
+    local n = self.reader:size()
+    local msg = self.message
+    local content = msg and msg.content
+    if not self.keepalive then
+        return false
+    elseif content and not content.is_consumed then
+        -- the remaining size of the chunked content is unknown
+        return not content.is_chunked and n > content.len
+    end
+    return n > 0
+end
+
+--- set_connection_header sets the 'Connection' header of the response to the
+--- last received request. the 'close' option is set if the connection does
+--- not persist, and the 'keep-alive' option is set if the HTTP/1.0 connection
+--- persists.
+--- @param header net.http.header
+function Connection:set_connection_header(header)
+    if not self.keepalive then
+        header:set('Connection', 'close')
+    elseif self.message and self.message.version == 1.0 then
+        header:set('Connection', 'keep-alive')
+    end
+end
+
+--- fd returns the file descriptor of the socket if the socket has a fd()
+--- method.
+--- @return integer? fd
+function Connection:fd()
+    local sock = self.sock
+    if type(sock.fd) == 'function' then
+        return sock:fd()
+    end
+end
+
+--- nonblock enables or disables the non-blocking mode of the socket if the
+--- socket has a nonblock() method. the read methods of the connection return
+--- the timeout instead of blocking, and can be called again when the socket
+--- becomes readable.
+--- @param enabled boolean
+--- @return boolean ok false if the socket does not support it
+function Connection:nonblock(enabled)
+    local sock = self.sock
+    if type(sock.nonblock) ~= 'function' then
+        return false
+    end
+    sock:nonblock(enabled)
+    return true
+end
+
 --- close
 --- @return boolean ok
 --- @return any err
@@ -77,6 +206,35 @@ function Connection:write(data)
     return n, nil, timeout
 end
 
+--- writev writes the data strings to the connection at once
+--- @param ... string
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Connection:writev(...)
+    local n, err, timeout = self.writer:writev(...)
+    if err then
+        return nil, errorf('failed to writev()', err)
+    end
+    return n, nil, timeout
+end
+
+--- sendfile writes the len bytes of the file from the offset to the connection.
+--- if the timeout occurs, n is the number of bytes already sent.
+--- @param file file*
+--- @param len integer
+--- @param offset integer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Connection:sendfile(file, len, offset)
+    local n, err, timeout = self.writer:sendfile(file, len, offset)
+    if err then
+        return nil, errorf('failed to sendfile()', err)
+    end
+    return n, nil, timeout
+end
+
 --- flush a buffered data to the connection.
 --- @return integer? n
 --- @return any err
@@ -89,40 +247,85 @@ function Connection:flush()
     return n, nil, timeout
 end
 
+--- set_lazy_header sets whether the header of the received message is looked
+--- up in the received bytes instead of being converted into the table.
+--- @param enabled boolean
+function Connection:set_lazy_header(enabled)
+    if type(enabled) ~= 'boolean' then
+        fatalf(2, 'enabled must be boolean')
+    end
+    self.parser:setlazy(enabled)
+end
+
+--- new_message_content creates the content of the received message.
+--- @param reader net.http.reader
+--- @param header net.http.header
+--- @return net.http.content? content
+local function new_message_content(reader, header)
+    -- 3.3.3.  Message Body Length
+    -- https://datatracker.ietf.org/doc/html/rfc7230#section-3.3.3
+    --
+    -- If a message is received with both a Transfer-Encoding and a
+    -- Content-Length header field, the Transfer-Encoding overrides the
+    -- Content-Length.
+    --
+    -- Such a message might indicate an attempt to perform request
+    -- smuggling (Section 9.5) or response splitting (Section 9.4) and
+    -- ought to be handled as an error.
+    --
+    -- A sender MUST remove the received Content-Length field prior to
+    -- forwarding such a message downstream.
+    --
+    local len = header:content_length()
+    if header:is_transfer_encoding_chunked() then
+        return new_chunked_content(reader)
+    elseif len and len > 0 then
+        return new_content(reader, len)
+    end
+end
+
 --- read_message
 --- @param msg net.http.message
---- @param parser function
+--- @param parser fun(p:net.http.parse.parser, buf:net.http.buffer, msg:table):(integer?, any)
 --- @return boolean ok
 --- @return any err
 --- @return boolean? timeout
 function Connection:read_message(msg, parser)
     local reader = self.reader
+    local buf = reader.buf
     local readsize = self.readsize
+    local p = self.parser
     local header = msg.header
-    local str = ''
 
     msg.header = header.dict
     while true do
-        local s, err, timeout = reader:read(readsize)
-        if err then
-            return false, errorf('failed to read_message()', err)
-        elseif not s then
-            return false, nil, timeout
-        end
-        str = str .. s
-
         -- TODO: add methods to sets the MAX_MSGLEN, MAX_HDRLEN and MAX_HDRNUM
         -- parse message
-        -- parser(str, tbl, MAX_MSGLEN, MAX_HDRLEN, MAX_HDRNUM)
-        local cur
-        cur, err = parser(str, msg)
+        -- the parser scans the received bytes in place and resumes parsing
+        -- from the position where it stopped. the bytes of the parsed message
+        -- are consumed from the buffer.
+        local rec = metrics.recorder
+        local t = rec and metrics.now()
+        local cur, err = parser(p, buf, msg)
+        if rec then
+            rec:elapsed('parse', t)
+        end
         -- parsed
         if cur then
-            -- prepend extra data
-            reader:prepend(sub(str, cur + 1))
-
             -- create header
+            local view = msg.header
             msg.header = header
+            if type(view) == 'userdata' then
+                header:setview(view)
+            end
+            if rec then
+                local nhdr = header:size()
+                rec:incr('messages')
+                rec:incr('header_fields', nhdr)
+                rec:incr('header_bytes', cur)
+                rec:observe('header_fields', nhdr)
+                rec:observe('header_bytes', cur)
+            end
 
             -- 3.3.3.  Message Body Length
             -- https://datatracker.ietf.org/doc/html/rfc7230#section-3.3.3
@@ -138,21 +341,109 @@ function Connection:read_message(msg, parser)
             -- A sender MUST remove the received Content-Length field prior to
             -- forwarding such a message downstream.
             --
-            local len = header:content_length()
-            if header:is_transfer_encoding_chunked() then
-                msg.content = new_chunked_content(reader)
-            elseif len and len > 0 then
-                msg.content = new_content(reader, len)
-            end
-
+            msg.content = new_message_content(reader, header)
             return true
 
         elseif err.type ~= EAGAIN then
             -- parse error
+            if rec then
+                rec:incr('parse_error.' .. err.type.name)
+            end
+            msg.header = header
+            p:reset()
             return false, err
         end
+
         -- more bytes need
+        local n, timeout
+        n, err, timeout = reader:fill(readsize)
+        if err then
+            msg.header = header
+            p:reset()
+            return false, errorf('failed to read_message()', err)
+        elseif not n then
+            msg.header = header
+            if timeout then
+                -- keep the partially parsed message to resume parsing
+                self.pending = msg
+            else
+                p:reset()
+            end
+            return false, nil, timeout
+        end
+    end
+end
+
+--- discard discards the unread content of the last received message.
+--- @param self net.http.connection
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function discard(self)
+    local msg = self.message
+    local content = msg and msg.content
+    if content and not content.is_consumed then
+        local _, err, timeout = content:dispose()
+        if err then
+            return false, errorf('failed to discard the content', err)
+        elseif not content.is_consumed then
+            return false, nil, timeout
+        end
+    end
+    self.message = nil
+    return true
+end
+
+--- wait waits for the next message until the idle timeout expires.
+--- @param self net.http.connection
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function wait(self)
+    local sock = self.sock
+    if self.reader:size() > 0 or type(sock.rcvtimeo) ~= 'function' then
+        return true
     end
+
+    local prev = sock:rcvtimeo(self.idle_timeout)
+    local n, err, timeout = self.reader:fill(self.readsize)
+    sock:rcvtimeo(prev)
+    if err then
+        return false, errorf('failed to wait for the next message', err)
+    end
+    return n ~= nil, nil, timeout
+end
+
+--- next_message prepares to receive the next message on the connection.
+--- the unread content of the last message is discarded if the connection
+--- persists.
+--- @param self net.http.connection
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function next_message(self)
+    if not self.keepalive then
+        -- the bytes following the last message are not a message
+        self.message = nil
+        return true
+    end
+
+    local ok, err, timeout = discard(self)
+    if ok and self.idle_timeout and self.nmsg > 0 then
+        ok, err, timeout = wait(self)
+    end
+    return ok, err, timeout
+end
+
+--- received updates the state of the connection by the received message.
+--- @param self net.http.connection
+--- @param msg net.http.message
+local function received(self, msg)
+    local nmsg = self.nmsg + 1
+    local max = self.max_requests
+    self.nmsg = nmsg
+    self.message = msg
+    self.keepalive = msg:is_keepalive() and (not max or nmsg < max)
 end
 
 --- read_request
@@ -160,8 +451,21 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Connection:read_request()
-    local req = new_request()
-    local ok, err, timeout = self:read_message(req, parse_request)
+    -- resume reading the pending message
+    local req = self.pending
+    if req then
+        self.pending = nil
+    else
+        local ok, err, timeout = next_message(self)
+        if err then
+            return nil, errorf('failed to read_request()', err)
+        elseif not ok then
+            return nil, nil, timeout
+        end
+        req = new_request()
+    end
+
+    local ok, err, timeout = self:read_message(req, self.parser.request)
     if ok then
         -- parse-uri
         ok, err = req:set_uri(req.uri, true)
@@ -169,6 +473,7 @@ function Connection:read_request()
             -- invalid uri format
             return nil, EMSG:new('failed to read_request()', err)
         end
+        received(self, req)
         return req
     elseif err then
         return nil, errorf('failed to read_request()', err)
@@ -176,15 +481,141 @@ function Connection:read_request()
     return nil, nil, timeout
 end
 
+--- read_requests reads a request, and then reads the pipelined requests that
+--- have already been received in the buffer at once. the requests following
+--- the request that has an unread content are not read.
+--- the bytes are consumed only up to the last returned request. if a
+--- pipelined request is invalid, the requests before it are returned, and
+--- the next read_request() returns the error of the invalid request.
+--- @param max? integer the maximum number of requests to read
+--- @return net.http.message.request[]? reqs
+--- @return any err
+--- @return boolean? timeout
+function Connection:read_requests(max)
+    if max == nil then
+        max = DEFAULT_MAXREQS
+    elseif not is_pint(max) then
+        fatalf(2, 'max must be integer greater than 0')
+    end
+
+    local req, err, timeout = self:read_request()
+    if not req then
+        return nil, err, timeout
+    end
+
+    local reqs = {
+        req,
+    }
+    local reader = self.reader
+    local buf = reader.buf
+    if max == 1 or req.content or not self.keepalive or buf:size() == 0 then
+        return reqs
+    end
+
+    -- parse the pipelined requests at once
+    local msgs, cur = parse_requests(buf, max > 256 and 255 or max - 1)
+    if not msgs then
+        -- the error will be returned by the next read_request()
+        return reqs
+    end
+
+    local nmsg = #msgs
+    for i = 1, nmsg do
+        local msg = msgs[i]
+        req = new_request()
+        req.method = msg.method
+        req.version = msg.version
+        req.header.dict = msg.header
+        if not req:set_uri(msg.uri, true) then
+            -- the error will be returned by the next read_request()
+            nmsg = i - 1
+            break
+        end
+
+        local body = msg.body
+        if body then
+            -- the content has already been received
+            local r = new_reader(NOSOCK)
+            r:prepend(body)
+            req.content = new_content(r, #body)
+        else
+            req.content = new_message_content(reader, req.header)
+        end
+        reqs[#reqs + 1] = req
+        received(self, req)
+        if not self.keepalive then
+            -- the following requests must not be processed
+            nmsg = i
+            break
+        end
+    end
+
+    if nmsg < #msgs then
+        -- consume the bytes of the returned requests only
+        cur = 0
+        if nmsg > 0 then
+            cur = select(2, parse_requests(buf, nmsg))
+        end
+    end
+    buf:consume(cur)
+
+    return reqs
+end
+
+--- frame_response removes the content of the response that cannot have the
+--- content, and marks the connection as non-persistent if the content of the
+--- response is delimited by closing the connection.
+--- @param self net.http.connection
+--- @param res net.http.message.response
+--- @param method? string
+local function frame_response(self, res, method)
+    -- 6.3.  Message Body Length
+    -- https://datatracker.ietf.org/doc/html/rfc9112#section-6.3
+    --
+    -- Any response to a HEAD request and any response with a 1xx
+    -- (Informational), 204 (No Content), or 304 (Not Modified) status code
+    -- is always terminated by the first empty line after the header fields,
+    -- regardless of the header fields present in the message, and thus
+    -- cannot contain a message body or trailer section.
+    --
+    -- Otherwise, this is a response message without a declared message body
+    -- length, so the message body length is determined by the number of
+    -- octets received prior to the server closing the connection.
+    --
+    local code = res.status
+    if method == 'HEAD' or code < 200 or code == 204 or code == 304 then
+        res.content = nil
+    elseif not res.content and not res.header:content_length() and
+        not res.header:is_transfer_encoding_chunked() then
+        self.keepalive = false
+    end
+end
+
 --- read_response
+--- @param method? string the method of the request
 --- @return net.http.message.response? res
 --- @return any err
 --- @return boolean? timeout
-function Connection:read_response()
-    local res = new_response()
-    local ok, err, timeout = self:read_message(res, parse_response)
+function Connection:read_response(method)
+    -- resume reading the pending message
+    local res = self.pending
+    if res then
+        self.pending = nil
+    else
+        local ok, err, timeout = next_message(self)
+        if err then
+            return nil, errorf('failed to read_response()', err)
+        elseif not ok then
+            return nil, nil, timeout
+        end
+        res = new_response()
+    end
+
+    local ok, err, timeout = self:read_message(res, self.parser.response)
 
     if ok then
+        received(self, res)
+        frame_response(self, res, method)
         return res
     elseif err then
         return nil, errorf('failed to read_response()', err)
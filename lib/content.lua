@@ -19,10 +19,12 @@
 -- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 -- THE SOFTWARE.
 --
+local type = type
 local fatalf = require('error').fatalf
 local errorf = require('error').format
 local is_uint = require('lauxhlib.is').uint
 local is_pint = require('lauxhlib.is').pint
+local metrics = require('net.http.metrics')
 --- constants
 local DEFAULT_CHUNKSIZE = 1024 * 8
 
@@ -32,6 +34,7 @@ local DEFAULT_CHUNKSIZE = 1024 * 8
 --- @field consumed integer
 --- @field is_chunked boolean
 --- @field is_consumed boolean
+--- @field protected consumed_fn? function
 local Content = {}
 
 --- init
@@ -51,6 +54,29 @@ function Content:init(r, len)
     return self
 end
 
+--- onconsumed sets the function that is called once when the content has
+--- been consumed. it is called immediately if already consumed.
+--- @param fn? function
+function Content:onconsumed(fn)
+    if fn ~= nil and type(fn) ~= 'function' then
+        fatalf(2, 'fn must be function')
+    end
+    self.consumed_fn = fn
+    if self.is_consumed then
+        self:set_consumed()
+    end
+end
+
+--- set_consumed marks the content as consumed.
+function Content:set_consumed()
+    self.is_consumed = true
+    local fn = self.consumed_fn
+    if fn then
+        self.consumed_fn = nil
+        fn()
+    end
+end
+
 --- size
 --- @return integer? size
 function Content:size()
@@ -74,7 +100,9 @@ local function read(self, chunksize)
             return nil, nil, timeout
         end
         self.len = self.len - #s
-        self.is_consumed = self.len <= 0
+        if self.len <= 0 then
+            self:set_consumed()
+        end
         return s
     end
 end
@@ -104,7 +132,9 @@ function Content:readall()
             return nil, errorf('failed to readall()', err)
         elseif s then
             self.len = self.len - #s
-            self.is_consumed = self.len <= 0
+            if self.len <= 0 then
+                self:set_consumed()
+            end
             return s
         end
     end
@@ -123,6 +153,8 @@ function Content:copy(w, chunksize)
         fatalf(2, 'chunksize must be uint greater than 0')
     end
 
+    local rec = metrics.recorder
+    local t = rec and metrics.now()
     local ncopy = 0
     local s, err, timeout = read(self, chunksize)
     while s do
@@ -142,6 +174,10 @@ function Content:copy(w, chunksize)
     elseif timeout then
         return nil, nil, timeout
     end
+    if rec then
+        rec:elapsed('copy', t)
+        rec:incr('bytes_copied', ncopy)
+    end
     return ncopy
 end
 
@@ -159,13 +195,58 @@ function Content:dispose(chunksize)
 end
 
 --- write
+--- if the handler is passed, the content is written in the chunked transfer
+--- coding through the handler.
 --- @param w net.http.writer
 --- @param chunksize? integer
+--- @param handler? net.http.content.chunked.Handler
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Content:write(w, chunksize)
-    return self:copy(w, chunksize)
+function Content:write(w, chunksize, handler)
+    if handler == nil then
+        return self:copy(w, chunksize)
+    elseif chunksize == nil then
+        chunksize = DEFAULT_CHUNKSIZE
+    elseif not is_pint(chunksize) then
+        fatalf(2, 'chunksize must be uint greater than 0')
+    end
+
+    local len = 0
+    local s, err, timeout = read(self, chunksize)
+    while s do
+        local n
+        n, err, timeout = handler:write_chunk(w, s)
+        if err then
+            return nil, errorf('failed to write()', err)
+        elseif not n or timeout then
+            return nil, nil, timeout
+        end
+        len = len + #s
+        s, err, timeout = read(self, chunksize)
+    end
+
+    if err then
+        return nil, errorf('failed to write()', err)
+    elseif timeout then
+        return nil, nil, timeout
+    end
+
+    local n
+    n, err, timeout = handler:write_last_chunk(w)
+    if err then
+        return nil, errorf('failed to write()', err)
+    elseif not n then
+        return nil, nil, timeout
+    end
+
+    n, err, timeout = handler:write_trailer(w)
+    if err then
+        return nil, errorf('failed to write()', err)
+    elseif not n then
+        return nil, nil, timeout
+    end
+    return len
 end
 
 return {
@@ -19,23 +19,23 @@
 -- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 -- THE SOFTWARE.
 --
+local type = type
 local concat = table.concat
 local format = string.format
-local find = string.find
 local sub = string.sub
 local errorf = require('error').format
 local fatalf = require('error').fatalf
 local is_pint = require('lauxhlib.is').pint
 local parse = require('net.http.parse')
-local parse_header = parse.header
-local parse_chunksize = parse.chunksize
+local new_chunked_decoder = parse.new_chunked
 --- constants
 local CRLF = '\r\n'
 
 --- @class net.http.content.chunked.Handler
 local Handler = {}
 
---- read_chunk
+--- read_chunk is called for each part of the chunk-data as it arrives.
+--- a large chunk may be passed in multiple parts with the same ext table.
 --- @param s string
 --- @param ext table<string, string>
 --- @return string s
@@ -57,6 +57,8 @@ function Handler:read_trailer(trailer)
 end
 
 --- write_chunk
+--- if the timeout occurs after the part of the chunk is written, then returns
+--- the number of bytes written and true.
 --- @param w net.http.writer
 --- @param s string
 --- @return integer? n
@@ -65,15 +67,22 @@ end
 function Handler:write_chunk(w, s)
     -- chunk = chunk-size [ chunk-ext ] CRLF
     --         chunk-data CRLF
-    local n, err, timeout = w:write(concat({
-        format('%x', #s),
-        s,
-        '',
-    }, CRLF))
+    local n, err, timeout
+    if w.writev then
+        -- write the chunk-size, chunk-data and CRLF without copying the
+        -- chunk-data
+        n, err, timeout = w:writev(format('%x\r\n', #s), s, CRLF)
+    else
+        n, err, timeout = w:write(concat({
+            format('%x', #s),
+            s,
+            '',
+        }, CRLF))
+    end
     if err then
         return nil, errorf('failed to write_chunk()', err)
-    elseif not n then
-        return nil, nil, timeout
+    elseif not n or timeout then
+        return n, nil, timeout
     end
     return n
 end
@@ -119,10 +128,12 @@ local EAGAIN = parse.EAGAIN
 
 --- @class net.http.content.chunked : net.http.content
 --- @field reader net.http.reader
+--- @field decoder net.http.parse.chunked
 --- @field bufsize integer
 --- @field is_chunked boolean
 --- @field is_read_chunk boolean
 --- @field is_read_trailer boolean
+--- @field is_coalesce boolean
 --- @field chunk string
 local ChunkedContent = {}
 
@@ -131,50 +142,66 @@ local ChunkedContent = {}
 --- @return net.http.content.chunked content
 function ChunkedContent:init(r)
     self.reader = r
+    self.decoder = new_chunked_decoder()
     self.bufsize = 4096
     self.is_chunked = true
     self.is_read_chunk = false
     self.is_read_trailer = false
+    self.is_coalesce = false
     self.chunk = ''
     return self
 end
 
+--- setcoalesce sets whether the write method coalesces the small pieces of
+--- data read from the reader into a chunk of the specified chunksize.
+--- if enabled, each chunk except the last one is filled up to the chunksize.
+--- @param enabled boolean
+function ChunkedContent:setcoalesce(enabled)
+    if type(enabled) ~= 'boolean' then
+        fatalf(2, 'enabled must be boolean')
+    end
+    self.is_coalesce = enabled
+end
+
 --- read_trailer
 --- @param self net.http.content.chunked
 --- @param handler net.http.content.chunked.Handler
 --- @return any err
 --- @return boolean? timeout
 local function read_trailer(self, handler)
-    -- read chunked-encoded string
+    -- decode chunked-encoded bytes in the reader buffer
     local r = self.reader
+    local buf = r.buf
+    local dec = self.decoder
     local bufsize = self.bufsize
-    local str = ''
 
     --
     -- trailer-part = *( header-field CRLF ) CRLF
     --
     -- parse trailer-part
     while true do
-        -- read data
-        local s, err, timeout = r:read(bufsize)
-        if err then
-            return errorf('failed to read_trailer()', err)
-        elseif not s then
-            return nil, timeout
-        end
-        str = str .. s
-
         local trailer = {}
-        local tail
-        tail, err = parse_header(str, trailer)
-        if tail then
+        local ok, err = dec:trailer(buf, trailer)
+        if ok then
             self.is_read_trailer = true
-            r:prepend(sub(str, tail + 1))
             err = handler:read_trailer(trailer)
-            return err and errorf('failed to read_trailer()', err) or nil
+            if err then
+                return errorf('failed to read_trailer()', err)
+            end
+            self:set_consumed()
+            return nil
         elseif err.type ~= EAGAIN then
             return err
         end
+
+        -- read data
+        local n, timeout
+        n, err, timeout = r:fill(bufsize)
+        if err then
+            return errorf('failed to read_trailer()', err)
+        elseif not n then
+            return nil, timeout
+        end
     end
 end
 
@@ -186,102 +213,81 @@ end
 --- @return any err
 --- @return boolean? timeout
 local function read_chunk(self, chunksize, handler)
-    -- read chunked-encoded string
+    -- decode chunked-encoded bytes in the reader buffer
     local r = self.reader
+    local buf = r.buf
+    local dec = self.decoder
     local bufsize = self.bufsize
-    local chunk = self.chunk
-    local str = ''
+    local chunks = {
+        self.chunk,
+    }
+    local nchunk = #self.chunk
 
+    --
+    -- 4.1.  Chunked Transfer Coding
+    -- https://tools.ietf.org/html/rfc7230#section-4.1
+    --
+    -- chunked-body     = *chunk
+    --                    last-chunk
+    --                    trailer-part
+    --                    CRLF
+    --
+    -- chunk            = chunk-size [ chunk-ext ] CRLF
+    --                    chunk-data CRLF
+    -- chunk-size       = 1*HEXDIG
+    -- last-chunk       = 1*("0") [ chunk-ext ] CRLF
+    --
+    -- chunk-ext        = *( BWS ";" BWS chunk-ext-name [ BWS "=" BWS chunk-ext-val ] )
+    -- chunk-ext-name   = token
+    -- chunk-ext-val    = token / quoted-string
+    -- BWS              = *( SP / HTAB )
+    --                  ; Bad White Space for backward compatibility
+    --
     while true do
-        local s, err, timeout = r:read(bufsize)
-        if err then
-            return false, errorf('failed to read_chunk()', err)
-        elseif not s then
-            return false, nil, timeout
-        end
-        str = str .. s
-
-        --
-        -- 4.1.  Chunked Transfer Coding
-        -- https://tools.ietf.org/html/rfc7230#section-4.1
-        --
-        -- chunked-body     = *chunk
-        --                    last-chunk
-        --                    trailer-part
-        --                    CRLF
-        --
-        -- chunk            = chunk-size [ chunk-ext ] CRLF
-        --                    chunk-data CRLF
-        -- chunk-size       = 1*HEXDIG
-        -- last-chunk       = 1*("0") [ chunk-ext ] CRLF
-        --
-        -- chunk-ext        = *( BWS ";" BWS chunk-ext-name [ BWS "=" BWS chunk-ext-val ] )
-        -- chunk-ext-name   = token
-        -- chunk-ext-val    = token / quoted-string
-        -- BWS              = *( SP / HTAB )
-        --                  ; Bad White Space for backward compatibility
-        --
-        repeat
-            -- read chunk-size
-            local ext = {}
-            local csize, perr, cur = parse_chunksize(str, ext)
-            if csize then
-                -- remove chunk-size [ chunk-ext ] CRLF
-                str = sub(str, cur + 1)
-
-                -- last-chunk
-                if csize == 0 then
-                    self.is_read_chunk = true
-                    -- add chunk-ext
-                    err = handler:read_last_chunk(ext)
-                    if err then
-                        return false, err
-                    end
-                    r:prepend(str)
-                    self.chunk = chunk
-                    return true
-                end
-
-                --
-                -- chunk-data = 1*OCTET ; a sequence of chunk-size octets
-                --
-                -- read chunk-data (csize + CRLF)
-                while #str < csize + 2 do
-                    s, err, timeout = r:read(bufsize)
-                    if err then
-                        return false, errorf('failed to read_chunk()', err)
-                    elseif not s then
-                        return false, nil, timeout
-                    end
-                    str = str .. s
-                end
-
-                -- check end-of-line (CRLF) of chunk-data
-                local head, tail = find(str, '^\r*\n', csize + 1)
-                if not head then
-                    -- invalid end-of-line terminator
-                    return false, parse.EEOL:new()
-                end
+        -- the decoder returns the chunk-data in the buffer and the
+        -- chunk-extensions of the chunk
+        local s, err, ext = dec:read(buf)
+        if s then
+            -- check chunk by handler
+            s, err = handler:read_chunk(s, ext)
+            if err then
+                self.chunk = concat(chunks)
+                return false, errorf('failed to read_chunk()', err)
+            end
+            chunks[#chunks + 1] = s
+            nchunk = nchunk + #s
 
-                -- check chunk by handler
-                s, err = handler:read_chunk(sub(str, 1, csize), ext)
+            -- stops reading when the specified chunk size is reached
+            if chunksize and nchunk >= chunksize then
+                self.chunk = concat(chunks)
+                return true
+            end
+        elseif ext then
+            -- last-chunk
+            self.is_read_chunk = true
+            self.chunk = concat(chunks)
+            -- add chunk-ext
+            err = handler:read_last_chunk(ext)
+            if err then
+                return false, err
+            end
+            return true
+        elseif err.type ~= EAGAIN then
+            -- invalid chunk-size format or end-of-line terminator
+            return false, err
+        else
+            -- more bytes need
+            local n, timeout
+            n, err, timeout = r:fill(bufsize)
+            if not n then
+                -- keep the chunks that have already been read
+                self.chunk = concat(chunks)
                 if err then
                     return false, errorf('failed to read_chunk()', err)
                 end
-                chunk = chunk .. s
-                str = sub(str, tail + 1)
-
-                -- stops reading when the specified chunk size is reached
-                if chunksize and #chunk >= chunksize then
-                    r:prepend(str)
-                    self.chunk = chunk
-                    return true
-                end
-            elseif perr and perr.type ~= EAGAIN then
-                -- invalid chunk-size format
-                return false, perr
+                return false, nil, timeout
             end
-        until not csize
+        end
     end
 end
 
@@ -458,18 +464,20 @@ function ChunkedContent:write(w, chunksize, handler)
 
     -- read and write string
     local r = self.reader
+    -- readfull() waits until the buffer has the chunksize bytes
+    local readfn = self.is_coalesce and r.readfull or r.read
     local len = 0
-    local s, err, timeout = r:read(chunksize)
+    local s, err, timeout = readfn(r, chunksize)
     while s do
         local n
         n, err, timeout = handler:write_chunk(w, s)
         if err then
             return nil, errorf('failed to write()', err)
-        elseif not n then
+        elseif not n or timeout then
             return nil, nil, timeout
         end
         len = len + #s
-        s, err, timeout = r:read(chunksize)
+        s, err, timeout = readfn(r, chunksize)
     end
 
     if err then
@@ -498,4 +506,5 @@ end
 
 return {
     new = require('metamodule').new(ChunkedContent, 'net.http.content'),
+    new_handler = Handler,
 }
@@ -1,49 +0,0 @@
---
--- Copyright (C) 2017 Masatoshi Teruya
---
--- Permission is hereby granted, free of charge, to any person obtaining a copy
--- of this software and associated documentation files (the "Software"), to deal
--- in the Software without restriction, including without limitation the rights
--- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
--- copies of the Software, and to permit persons to whom the Software is
--- furnished to do so, subject to the following conditions:
---
--- The above copyright notice and this permission notice shall be included in
--- all copies or substantial portions of the Software.
---
--- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
--- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
--- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
--- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
--- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
--- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
--- THE SOFTWARE.
---
--- lib/date.lua
--- lua-net-http
--- Created by Masatoshi Teruya on 17/09/25.
---
---- assign to local
-local date = os.date
---- file scope variables
-local FORMAT = '!%a, %d %b %Y %H:%M:%S GMT'
-local CURRENT_DATE = date(FORMAT)
-
---- update
---- @return string|osdate?
-local function update()
-    CURRENT_DATE = date(FORMAT)
-    return CURRENT_DATE
-end
-
---- now
---- @return string|osdate?
-local function now()
-    return CURRENT_DATE
-end
-
-return {
-    update = update,
-    now = now,
-}
-
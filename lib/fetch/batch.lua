@@ -0,0 +1,335 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local pairs = pairs
+local ipairs = ipairs
+local floor = math.floor
+local concat = table.concat
+local remove = table.remove
+local errorf = require('error').format
+local EBUSY = require('errno').EBUSY
+local new_reader = require('net.http.reader').new
+local new_content = require('net.http.content').new
+local client = require('net.http.client')
+local prepare = client.prepare
+local is_retryable = client.is_retryable
+local connect = client.connect
+local close = client.close
+local send = client.send
+local release = client.release
+local socket = require('net.http.socket')
+local poll = socket.poll
+local clock = socket.clock
+--- constants
+-- the socket of the content that has already been received
+local NOSOCK = {
+    read = function()
+    end,
+}
+
+--- @class net.http.fetch.batch.task
+--- @field id integer
+--- @field target net.http.client.target
+--- @field deadline? integer the deadline in the milliseconds of clock()
+--- @field c? net.http.connection
+--- @field fd? integer the file descriptor that is polled
+--- @field reused? boolean
+--- @field res? net.http.message.response
+--- @field chunks? string[] the received content
+--- @field busy? any the error of the pool that has no slot for the task
+
+--- @class net.http.fetch.batch.result
+--- @field id integer
+--- @field res? net.http.message.response
+--- @field err any
+--- @field timeout? boolean
+
+--- @class net.http.fetch.batch
+--- only waiting for the responses is multiplexed by poll(). the connection is
+--- established and the request is sent with the blocking I/O, one request at
+--- a time in next(). so a slow connect or upload delays the other requests of
+--- the batch, and their deadlines are not checked until it is done.
+--- @field protected nreq integer the number of added requests
+--- @field protected queue net.http.fetch.batch.task[] the requests to be sent
+--- @field protected tasks table<integer, net.http.fetch.batch.task>
+--- @field protected nwait integer
+--- @field protected results net.http.fetch.batch.result[]
+local Batch = {}
+
+--- init
+--- @return net.http.fetch.batch batch
+function Batch:init()
+    self.nreq = 0
+    self.queue = {}
+    self.tasks = {}
+    self.nwait = 0
+    self.results = {}
+    return self
+end
+
+--- add adds the request to the batch. the arguments are the same as fetch(),
+--- and opts.deadline is applied until the response content is received.
+--- the deadline of the connect is applied by the socket, and sending the
+--- request is not interrupted by the deadline.
+--- the request is sent on the next call of the next() method.
+--- @param uri string
+--- @param opts? table<string, any>
+--- @return integer id
+function Batch:add(uri, opts)
+    local target, err = prepare(uri, opts)
+    local id = self.nreq + 1
+    self.nreq = id
+    if not target then
+        self.results[#self.results + 1] = {
+            id = id,
+            err = errorf('failed to fetch()', err),
+        }
+        return id
+    end
+
+    local deadline = target.opts.deadline
+    self.queue[#self.queue + 1] = {
+        id = id,
+        target = target,
+        deadline = deadline and clock() + floor(deadline) or nil,
+    }
+    return id
+end
+
+--- size returns the number of the requests whose results have not been
+--- returned yet.
+--- @return integer n
+function Batch:size()
+    return #self.queue + self.nwait + #self.results
+end
+
+--- finish appends the result of the task.
+--- @param self net.http.fetch.batch
+--- @param task net.http.fetch.batch.task
+--- @param res? net.http.message.response
+--- @param err any
+--- @param timeout? boolean
+local function finish(self, task, res, err, timeout)
+    self.results[#self.results + 1] = {
+        id = task.id,
+        res = res,
+        err = err and errorf('failed to fetch()', err),
+        timeout = timeout,
+    }
+end
+
+--- unregister stops polling the connection of the task.
+--- @param self net.http.fetch.batch
+--- @param task net.http.fetch.batch.task
+local function unregister(self, task)
+    local fd = task.fd
+    if fd then
+        task.fd = nil
+        self.tasks[fd] = nil
+        self.nwait = self.nwait - 1
+        task.c:nonblock(false)
+    end
+end
+
+local start
+
+--- failed closes the connection of the task, and retries the request once
+--- with a new connection if the idle connection has been closed by the peer.
+--- @param self net.http.fetch.batch
+--- @param task net.http.fetch.batch.task
+--- @param err any
+--- @param timeout? boolean
+local function failed(self, task, err, timeout)
+    unregister(self, task)
+    local retry = task.reused and not task.res and
+                      is_retryable(task.c, task.target, err, timeout)
+    close(task.c, task.target)
+    if retry then
+        start(self, task, false)
+        return
+    end
+    finish(self, task, nil, err, timeout)
+end
+
+--- step reads the response of the task as much as possible without blocking.
+--- @param self net.http.fetch.batch
+--- @param task net.http.fetch.batch.task
+local function step(self, task)
+    local c = task.c
+    local res = task.res
+    if not res then
+        local err, timeout
+        res, err, timeout = c:read_response(task.target.req.method)
+        if not res then
+            if err or not timeout or not task.fd then
+                failed(self, task, err, timeout)
+            end
+            return
+        end
+        task.res = res
+        task.chunks = {}
+    end
+
+    -- read the content into the memory
+    local content = res.content
+    local chunks = task.chunks
+    while content and not content.is_consumed do
+        local s, err, timeout = content:read()
+        if s then
+            chunks[#chunks + 1] = s
+        elseif not content.is_consumed then
+            if err or not timeout or not task.fd then
+                failed(self, task, err, timeout)
+            end
+            return
+        end
+    end
+
+    unregister(self, task)
+    release(c, task.target, res)
+    if content then
+        local data = concat(chunks)
+        local r = new_reader(NOSOCK)
+        r:prepend(data)
+        res.content = new_content(r, #data)
+    end
+    finish(self, task, res)
+end
+
+--- start sends the request of the task.
+--- @param self net.http.fetch.batch
+--- @param task net.http.fetch.batch.task
+--- @param reuse boolean
+start = function(self, task, reuse)
+    local c, err, timeout, reused = connect(task.target, reuse)
+    if not c then
+        if err and err.type == EBUSY then
+            -- wait for the active connection of the same key to be released
+            task.busy = err
+            self.queue[#self.queue + 1] = task
+            return
+        end
+        finish(self, task, nil, err, timeout)
+        return
+    end
+    task.busy = nil
+    task.c = c
+    task.reused = reused
+
+    local ok
+    ok, err, timeout = send(c, task.target)
+    if not ok then
+        failed(self, task, err, timeout)
+        return
+    end
+
+    -- wait for the response without blocking if the socket supports it
+    local fd = c:fd()
+    if fd and c:nonblock(true) then
+        task.fd = fd
+        self.tasks[fd] = task
+        self.nwait = self.nwait + 1
+    end
+    step(self, task)
+end
+
+--- expire closes the connections of the tasks that exceed the deadline.
+--- @param self net.http.fetch.batch
+--- @return integer? msec the milliseconds until the nearest deadline
+local function expire(self)
+    local now = clock()
+    local msec
+    for _, task in pairs(self.tasks) do
+        local deadline = task.deadline
+        if deadline then
+            if deadline <= now then
+                unregister(self, task)
+                close(task.c, task.target)
+                finish(self, task, nil, nil, true)
+            elseif not msec or deadline - now < msec then
+                msec = deadline - now
+            end
+        end
+    end
+    return msec
+end
+
+--- next sends the added requests at once, and waits for the response that
+--- arrives first. the content of the response has already been received.
+--- the request that has no slot of the active connection in the pool is sent
+--- after a connection of the same key is released. if no response of the
+--- batch is waited for, it fails with the EBUSY error.
+--- it returns nil if all the results have been returned.
+--- @return integer? id
+--- @return net.http.message.response? res
+--- @return any err
+--- @return boolean? timeout
+function Batch:next()
+    -- send the queued requests
+    local queue = self.queue
+    self.queue = {}
+    for _, task in ipairs(queue) do
+        start(self, task, true)
+    end
+    if self.nwait == 0 and #self.results == 0 then
+        -- the slots are held by the connections outside of the batch
+        queue = self.queue
+        self.queue = {}
+        for _, task in ipairs(queue) do
+            finish(self, task, nil, task.busy)
+        end
+    end
+
+    -- wait for the responses
+    local results = self.results
+    while #results == 0 and self.nwait > 0 do
+        local msec = expire(self)
+        if #results > 0 then
+            break
+        end
+
+        local fds = {}
+        for fd in pairs(self.tasks) do
+            fds[#fds + 1] = fd
+        end
+        local ready, err = poll(fds, msec)
+        if not ready then
+            return nil, nil, errorf('failed to poll()', err)
+        end
+
+        for _, fd in ipairs(ready) do
+            local task = self.tasks[fd]
+            if task then
+                step(self, task)
+            end
+        end
+    end
+
+    local result = remove(results, 1)
+    if result then
+        return result.id, result.res, result.err, result.timeout
+    end
+end
+
+return {
+    new = require('metamodule').new(Batch),
+}
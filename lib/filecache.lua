@@ -0,0 +1,266 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local pairs = pairs
+local floor = math.floor
+local format = string.format
+local fopen = require('io.fopen')
+local fstat = require('fstat')
+local fatalf = require('error').fatalf
+local is_table = require('lauxhlib.is').table
+local is_pint = require('lauxhlib.is').pint
+local is_finite = require('lauxhlib.is').finite
+local clock = require('net.http.socket').clock
+local format_date = require('net.http.date').format
+--- constants
+local DEFAULT_MAXFILES = 128
+local DEFAULT_REVALIDATE = 1
+
+--- @class net.http.filecache.entry
+--- @field pathname string
+--- @field file file*
+--- @field size integer
+--- @field mtime integer
+--- @field mime? string the content type resolved by the user of the entry
+--- @field etag string
+--- @field last_modified string
+--- @field checked integer the time when the file was checked in msec
+--- @field used integer the time when the entry was used in msec
+--- @field nref integer the number of the users of the entry
+--- @field detached? boolean true if the entry has been removed from the cache
+
+--- open opens the file, and creates the entry of the file.
+--- @param pathname string
+--- @return net.http.filecache.entry? entry
+--- @return any err
+local function open(pathname)
+    local f, err = fopen(pathname)
+    if not f then
+        return nil, err
+    end
+
+    local stat
+    stat, err = fstat(f)
+    if not stat then
+        f:close()
+        return nil, err
+    end
+
+    local mtime = floor(stat.mtime)
+    local now = clock()
+    return {
+        pathname = pathname,
+        file = f,
+        size = stat.size,
+        mtime = mtime,
+        etag = format('"%x-%x"', mtime, stat.size),
+        last_modified = format_date(mtime),
+        checked = now,
+        used = now,
+        nref = 0,
+    }
+end
+
+--- @class net.http.filecache
+--- @field protected maxfiles integer
+--- @field protected revalidate integer
+--- @field protected nfile integer the number of the cached open files
+--- @field protected nerr integer the number of the cached errors
+--- @field protected entries table<string, net.http.filecache.entry|table>
+local FileCache = {}
+
+--- init creates the cache of the open files and their metadata.
+--- the cached file is checked with fstat at most once per opts.revalidate
+--- seconds, and it is reopened if the file has been modified or replaced.
+--- the file of the removed entry is closed when the last user of the entry
+--- releases it. the errors of the files that cannot be opened are cached
+--- apart from the open files, up to opts.maxfiles entries.
+--- @param opts? table
+--- @return net.http.filecache cache
+function FileCache:init(opts)
+    if opts == nil then
+        opts = {}
+    elseif not is_table(opts) then
+        fatalf(2, 'opts must be table')
+    end
+
+    local maxfiles = opts.maxfiles
+    if maxfiles == nil then
+        maxfiles = DEFAULT_MAXFILES
+    elseif not is_pint(maxfiles) then
+        fatalf(2, 'opts.maxfiles must be integer greater than 0')
+    end
+
+    local revalidate = opts.revalidate
+    if revalidate == nil then
+        revalidate = DEFAULT_REVALIDATE
+    elseif not is_finite(revalidate) or revalidate < 0 then
+        fatalf(2, 'opts.revalidate must be finite-number greater than or ' ..
+                   'equal to 0')
+    end
+
+    self.maxfiles = maxfiles
+    self.revalidate = revalidate * 1000
+    self.nfile = 0
+    self.nerr = 0
+    self.entries = {}
+    return self
+end
+
+--- size returns the number of the cached open files.
+--- @return integer n
+function FileCache:size()
+    return self.nfile
+end
+
+--- detach removes the entry from the cache, and closes its file if no one
+--- uses it.
+--- @param self net.http.filecache
+--- @param entry net.http.filecache.entry|table
+local function detach(self, entry)
+    self.entries[entry.pathname] = nil
+    if entry.err then
+        self.nerr = self.nerr - 1
+        return
+    end
+    self.nfile = self.nfile - 1
+    entry.detached = true
+    if entry.nref == 0 then
+        entry.file:close()
+    end
+end
+
+--- remove removes the entry of the pathname.
+--- @param pathname string
+--- @return boolean ok
+function FileCache:remove(pathname)
+    local entry = self.entries[pathname]
+    if entry then
+        detach(self, entry)
+        return true
+    end
+    return false
+end
+
+--- clear removes all entries.
+function FileCache:clear()
+    for _, entry in pairs(self.entries) do
+        detach(self, entry)
+    end
+end
+
+--- release releases the entry returned by get(). the file of the entry is
+--- closed if the entry has been removed from the cache and no one uses it.
+--- @param entry net.http.filecache.entry
+function FileCache:release(entry)
+    local nref = entry.nref - 1
+    entry.nref = nref
+    if nref == 0 and entry.detached then
+        entry.file:close()
+    end
+end
+
+--- evict removes the least recently used entry of the errors if err is true,
+--- or of the open files.
+--- @param self net.http.filecache
+--- @param err boolean
+local function evict(self, err)
+    local lru
+    for _, entry in pairs(self.entries) do
+        if (entry.err ~= nil) == err and (not lru or entry.used < lru.used) then
+            lru = entry
+        end
+    end
+    if lru then
+        detach(self, lru)
+    end
+end
+
+--- is_fresh returns true if the file of the entry has not been modified.
+--- @param entry net.http.filecache.entry
+--- @return boolean ok
+local function is_fresh(entry)
+    if entry.err then
+        return false
+    end
+    local stat = fstat(entry.file)
+    -- nlink is 0 if the file has been removed or replaced by rename
+    return stat ~= nil and stat.nlink > 0 and stat.size == entry.size and
+               floor(stat.mtime) == entry.mtime
+end
+
+--- get returns the entry of the pathname. if the file cannot be opened, the
+--- error is also cached until the entry is revalidated.
+--- the returned entry must be released by release() after use.
+--- @param pathname string
+--- @return net.http.filecache.entry? entry
+--- @return any err
+function FileCache:get(pathname)
+    local now = clock()
+    local entry = self.entries[pathname]
+    if entry then
+        local fresh = now - entry.checked < self.revalidate
+        if not fresh and is_fresh(entry) then
+            entry.checked = now
+            fresh = true
+        end
+
+        if fresh then
+            entry.used = now
+            if entry.err then
+                return nil, entry.err
+            end
+            entry.nref = entry.nref + 1
+            return entry
+        end
+        detach(self, entry)
+    end
+
+    local err
+    entry, err = open(pathname)
+    if not entry then
+        if self.nerr >= self.maxfiles then
+            evict(self, true)
+        end
+        self.nerr = self.nerr + 1
+        self.entries[pathname] = {
+            pathname = pathname,
+            err = err,
+            checked = now,
+            used = now,
+        }
+        return nil, err
+    end
+
+    if self.nfile >= self.maxfiles then
+        evict(self, false)
+    end
+    self.nfile = self.nfile + 1
+    entry.nref = 1
+    self.entries[pathname] = entry
+    return entry
+end
+
+return {
+    open = open,
+    new = require('metamodule').new(FileCache),
+}
@@ -0,0 +1,347 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+local find = string.find
+local sub = string.sub
+local lower = string.lower
+local type = type
+local ipairs = ipairs
+local errorf = require('error').format
+local fatalf = require('error').fatalf
+local is_string = require('lauxhlib.is').str
+local is_table = require('lauxhlib.is').table
+local is_pint = require('lauxhlib.is').pint
+local instanceof = require('metamodule').instanceof
+local new_errno = require('errno').new
+local new_header = require('net.http.header').new
+local is_valid_boundary = require('net.http.form').is_valid_boundary
+local parse = require('net.http.parse')
+local parse_header = parse.header
+local parse_parameters = parse.parameters
+--- constants
+local EAGAIN = parse.EAGAIN
+local DEFAULT_CHUNKSIZE = 1024 * 8
+local MAX_HDRSIZE = 1024 * 8
+local HANDLER_METHODS = {
+    'read_part',
+    'read_data',
+    'read_end',
+}
+-- decoder states
+local PREAMBLE = 1
+local DELIMITER = 2
+local HEADER = 3
+local BODY = 4
+local EPILOGUE = 5
+local DONE = 6
+
+--- @class net.http.form.multipart.Part
+--- @field header net.http.header
+--- @field name string
+--- @field filename string?
+
+--- @class net.http.form.multipart.Handler
+local Handler = {}
+
+--- read_part is called with the part when its header has been read.
+--- @param part net.http.form.multipart.Part
+--- @return any err
+function Handler:read_part(part)
+end
+
+--- read_data is called for each slice of the part body as it arrives.
+--- @param part net.http.form.multipart.Part
+--- @param s string
+--- @return any err
+function Handler:read_data(part, s)
+end
+
+--- read_end is called when the part body has been read.
+--- @param part net.http.form.multipart.Part
+--- @return any err
+function Handler:read_end(part)
+end
+
+Handler = require('metamodule').new.Handler(Handler)
+
+--- @class net.http.form.multipart
+--- @field content net.http.content
+--- @field delimiter string
+--- @field state integer
+--- @field buf string
+--- @field part net.http.form.multipart.Part?
+local Multipart = {}
+
+--- init
+--- @param content net.http.content
+--- @param boundary string
+--- @return net.http.form.multipart decoder
+function Multipart:init(content, boundary)
+    if not instanceof(content, 'net.http.content') then
+        fatalf(2, 'content must be net.http.content')
+    elseif not is_string(boundary) or not is_valid_boundary(boundary) then
+        fatalf(2, 'boundary must be valid-boundary string')
+    end
+
+    self.content = content
+    self.delimiter = '\r\n--' .. boundary
+    self.state = PREAMBLE
+    -- the first delimiter may appear at the beginning of the content without
+    -- the preceding CRLF
+    self.buf = '\r\n'
+    return self
+end
+
+--- read_preamble discards the bytes before the first delimiter.
+--- @param self net.http.form.multipart
+--- @return boolean ok
+local function read_preamble(self)
+    local buf = self.buf
+    local _, tail = find(buf, self.delimiter, 1, true)
+    if tail then
+        self.buf = sub(buf, tail + 1)
+        self.state = DELIMITER
+        return true
+    end
+    -- keep the bytes that may be the head of the delimiter
+    self.buf = sub(buf, -(#self.delimiter - 1))
+    return false
+end
+
+--- read_delimiter reads the bytes following the boundary of the delimiter.
+--- @param self net.http.form.multipart
+--- @return boolean ok
+--- @return any err
+local function read_delimiter(self)
+    --
+    -- 5.1.1.  Common Syntax
+    -- https://datatracker.ietf.org/doc/html/rfc2046#section-5.1.1
+    --
+    --  multipart-body := [preamble CRLF]
+    --                    dash-boundary transport-padding CRLF
+    --                    body-part *encapsulation
+    --                    close-delimiter transport-padding
+    --                    [CRLF epilogue]
+    --  encapsulation := delimiter transport-padding
+    --                   CRLF body-part
+    --  close-delimiter := delimiter "--"
+    --  transport-padding := *LWSP-char
+    --
+    local buf = self.buf
+    if find(buf, '^%-%-') then
+        -- close-delimiter
+        self.buf = ''
+        self.state = EPILOGUE
+        return true
+    end
+
+    local _, tail = find(buf, '^[ \t]*\r\n')
+    if tail then
+        self.buf = sub(buf, tail + 1)
+        self.state = HEADER
+        return true
+    elseif #buf <= MAX_HDRSIZE and
+        (buf == '-' or find(buf, '^[ \t]*\r?$')) then
+        -- more bytes need
+        return false
+    end
+    return false, new_errno('EILSEQ', 'invalid multipart delimiter')
+end
+
+--- read_header reads the header of the part and passes the part to the
+--- handler.
+--- @param self net.http.form.multipart
+--- @param handler net.http.form.multipart.Handler
+--- @return boolean ok
+--- @return any err
+local function read_header(self, handler)
+    local buf = self.buf
+    local header = new_header()
+    local cur, err = parse_header(buf, header.dict)
+    if not cur then
+        if err.type ~= EAGAIN then
+            return false, err
+        elseif #buf > MAX_HDRSIZE then
+            return false, new_errno('EMSGSIZE', 'multipart header too large')
+        end
+        -- more bytes need
+        return false
+    end
+
+    --
+    -- 4.2.  Content-Disposition Header Field for Each Part
+    -- https://datatracker.ietf.org/doc/html/rfc7578#section-4.2
+    --
+    -- Each part MUST contain a Content-Disposition header field where the
+    -- disposition type is "form-data". The Content-Disposition header field
+    -- MUST also contain an additional parameter of "name"; the parameter
+    -- may also contain the "filename" of the file.
+    --
+    local val = header:get('content-disposition')
+    local head, tail = find(val or '', '%s*;%s*')
+    local params = {}
+    if not head or lower(sub(val, 1, head - 1)) ~= 'form-data' or
+        not parse_parameters(sub(val, tail + 1), params) or not params.name then
+        return false, new_errno('EILSEQ', 'invalid Content-Disposition header')
+    end
+    local part = {
+        header = header,
+        name = params.name,
+        filename = params.filename,
+    }
+
+    self.buf = sub(buf, cur + 1)
+    self.part = part
+    self.state = BODY
+    err = handler:read_part(part)
+    if err then
+        return false, errorf('failed to read_part()', err)
+    end
+    return true
+end
+
+--- read_body passes the bytes of the part body to the handler until the
+--- delimiter.
+--- @param self net.http.form.multipart
+--- @param handler net.http.form.multipart.Handler
+--- @return boolean ok
+--- @return any err
+local function read_body(self, handler)
+    local buf = self.buf
+    local part = self.part
+    local delimiter = self.delimiter
+    local head, tail = find(buf, delimiter, 1, true)
+    if not head then
+        -- pass the bytes except the tail that may be the head of the
+        -- delimiter
+        local pos = #buf - #delimiter + 2
+        pos = find(buf, '\r', pos > 1 and pos or 1, true) or #buf + 1
+        if pos > 1 then
+            self.buf = sub(buf, pos)
+            local err = handler:read_data(part, sub(buf, 1, pos - 1))
+            if err then
+                return false, errorf('failed to read_data()', err)
+            end
+        end
+        -- more bytes need
+        return false
+    end
+
+    self.buf = sub(buf, tail + 1)
+    self.part = nil
+    self.state = DELIMITER
+    if head > 1 then
+        local err = handler:read_data(part, sub(buf, 1, head - 1))
+        if err then
+            return false, errorf('failed to read_data()', err)
+        end
+    end
+    local err = handler:read_end(part)
+    if err then
+        return false, errorf('failed to read_end()', err)
+    end
+    return true
+end
+
+--- read_epilogue discards the bytes after the close-delimiter.
+--- @param self net.http.form.multipart
+--- @param chunksize integer
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function read_epilogue(self, chunksize)
+    local n, err, timeout = self.content:dispose(chunksize)
+    if err then
+        return false, errorf('failed to read_epilogue()', err)
+    elseif not n then
+        return false, nil, timeout
+    end
+    self.state = DONE
+    return true
+end
+
+--- decode reads the content and passes each part to the handler as it
+--- arrives; the header of the part first, then the slices of its body.
+--- the part bodies are never buffered as a whole.
+--- if the timeout is returned, it can be called again to resume decoding.
+--- if the handler returns an error, decoding is aborted and the rest of the
+--- content is left unread.
+--- @param handler net.http.form.multipart.Handler
+--- @param chunksize integer?
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Multipart:decode(handler, chunksize)
+    if not is_table(handler) then
+        fatalf(2, 'handler must be table')
+    end
+    for _, name in ipairs(HANDLER_METHODS) do
+        if type(handler[name]) ~= 'function' then
+            fatalf(2, 'handler.%s must be function', name)
+        end
+    end
+    if chunksize == nil then
+        chunksize = DEFAULT_CHUNKSIZE
+    elseif not is_pint(chunksize) then
+        fatalf(2, 'chunksize must be uint greater than 0')
+    end
+
+    local state = self.state
+    while state ~= DONE do
+        local ok, err, timeout
+        if state == PREAMBLE then
+            ok = read_preamble(self)
+        elseif state == DELIMITER then
+            ok, err = read_delimiter(self)
+        elseif state == HEADER then
+            ok, err = read_header(self, handler)
+        elseif state == BODY then
+            ok, err = read_body(self, handler)
+        else
+            ok, err, timeout = read_epilogue(self, chunksize)
+        end
+
+        if err or timeout then
+            return false, err, timeout
+        elseif not ok then
+            -- read data
+            local s
+            s, err, timeout = self.content:read(chunksize)
+            if err then
+                return false, errorf('failed to decode()', err)
+            elseif timeout then
+                return false, nil, timeout
+            elseif not s then
+                return false, new_errno('EILSEQ',
+                                        'unexpected end of multipart content')
+            end
+            self.buf = self.buf .. s
+        end
+        state = self.state
+    end
+
+    return true
+end
+
+return {
+    new = require('metamodule').new(Multipart),
+    new_handler = Handler,
+}
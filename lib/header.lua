@@ -35,27 +35,30 @@ local is_string = require('lauxhlib.is').str
 local is_table = require('lauxhlib.is').table
 local new_errno = require('errno').new
 local parse = require('net.http.parse')
-local parse_header_name = parse.header_name
+local parse_header_key = parse.header_key
 local parse_header_value = parse.header_value
 local parse_tchar = parse.tchar
 local parse_parameters = parse.parameters
+local serialize_header = require('net.http.serialize').header
 
 --- is_valid_key
 --- @param key string
---- @return string? key
+--- @return string? lkey the lowercase key
+--- @return string? ckey the canonical-case key
 --- @return any err
 local function is_valid_key(key)
     if not is_string(key) then
-        return nil, new_errno('EINVAL',
-                              format('string expected, got %s', type(key)))
+        return nil, nil, new_errno('EINVAL',
+                                   format('string expected, got %s', type(key)))
     end
     key = trim(key)
 
-    local ok, err = parse_header_name(key)
-    if not ok then
-        return nil, err
+    -- the well-known key is returned as the pre-created strings
+    local lk, ck = parse_header_key(key)
+    if not lk then
+        return nil, nil, ck
     end
-    return key
+    return lk, ck or capitalize(key)
 end
 
 --- is_valid_val
@@ -107,6 +110,7 @@ end
 
 --- @class net.http.header
 --- @field dict table<integer|string, table>
+--- @field protected view? net.http.parse.headers
 local Header = {}
 
 --- init
@@ -128,8 +132,30 @@ function Header:init(header)
     return self
 end
 
+--- setview sets the header view of the parsed message. the header-fields are
+--- looked up in the received bytes until the header is modified or iterated.
+--- @param view net.http.parse.headers
+function Header:setview(view)
+    self.dict = {}
+    self.view = view
+end
+
+--- materialize converts the header view into the dict.
+--- @return table<integer|string, table> dict
+function Header:materialize()
+    local view = self.view
+    if view then
+        self.view = nil
+        view:totable(self.dict)
+    end
+    return self.dict
+end
+
 --- size
 function Header:size()
+    if self.view then
+        return #self.view
+    end
     return #self.dict
 end
 
@@ -138,9 +164,9 @@ end
 --- @param val? string
 --- @return boolean ok
 function Header:set(key, val)
-    local k, err = is_valid_key(key)
+    local lk, ck, err = is_valid_key(key)
 
-    if not k then
+    if not lk then
         fatalf(2, 'invalid key: %s', err)
     elseif val ~= nil then
         if is_table(val) then
@@ -161,8 +187,7 @@ function Header:set(key, val)
         end
     end
 
-    local dict = self.dict
-    local lk = lower(k)
+    local dict = self:materialize()
     -- remove key
     if val == nil then
         local item = dict[lk]
@@ -186,7 +211,7 @@ function Header:set(key, val)
         local idx = #dict + 1
         item = {
             idx = idx,
-            key = capitalize(key),
+            key = ck,
             val = val,
         }
         dict[lk], dict[idx] = item, item
@@ -217,7 +242,7 @@ end
 --- @param val any
 --- @return boolean ok
 function Header:add(key, val)
-    local k, err = is_valid_key(key)
+    local lk, ck, err = is_valid_key(key)
 
     if err then
         fatalf(2, 'invalid key: %s', err)
@@ -238,8 +263,7 @@ function Header:add(key, val)
         fatalf(2, 'val must be string or string[]')
     end
 
-    local dict = self.dict
-    local lk = lower(k)
+    local dict = self:materialize()
     local item = dict[lk]
     if item then
         -- append values
@@ -252,7 +276,7 @@ function Header:add(key, val)
         local idx = #dict + 1
         item = {
             idx = idx,
-            key = capitalize(k),
+            key = ck,
             val = val,
         }
         dict[lk], dict[idx] = item, item
@@ -273,6 +297,11 @@ function Header:get(key, all)
         fatalf(2, 'all must be boolean')
     end
 
+    local view = self.view
+    if view then
+        return view:get(key, all)
+    end
+
     local item = self.dict[lower(key)]
     if item then
         return all and item.val or item.val[#item.val], item.key
@@ -284,7 +313,7 @@ end
 --- pairs
 --- @return function next
 function Header:pairs()
-    local dict = self.dict
+    local dict = self:materialize()
     local idx = 0
     local item, key, val, vidx
 
@@ -310,33 +339,32 @@ function Header:pairs()
     end
 end
 
---- write headers to writer
+--- serialize returns the header-fields terminated by an empty line as a
+--- string. if the line is specified, it is placed before the header-fields.
+--- if the block of pre-serialized header-fields is specified, it is placed
+--- after the line.
+--- @param line? string
+--- @param block? string
+--- @return string s
+function Header:serialize(line, block)
+    return serialize_header(self:materialize(), line, block)
+end
+
+--- write headers to writer.
+--- the first-line and the header-fields are written at once.
 --- @param w net.http.writer
+--- @param line? string
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Header:write(w)
-    local total = 0
-
-    for _, k, v in self:pairs() do
-        local s = format('%s: %s\r\n', k, v)
-        local n, err, timeout = w:write(s)
-        if err then
-            return nil, errorf('failed to write()', err)
-        elseif not n then
-            return nil, nil, timeout
-        end
-        total = total + n
-    end
-
-    local n, err, timeout = w:write('\r\n')
+function Header:write(w, line)
+    local n, err, timeout = w:write(serialize_header(self:materialize(), line))
     if err then
         return nil, errorf('failed to write()', err)
     elseif not n then
         return nil, nil, timeout
     end
-
-    return total + 2
+    return n
 end
 
 --- get_content_type
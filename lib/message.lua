@@ -20,18 +20,26 @@
 -- THE SOFTWARE.
 --
 local tostring = tostring
+local tonumber = tonumber
 local format = string.format
+local gmatch = string.gmatch
+local lower = string.lower
 local errorf = require('error').format
 local fatalf = require('error').fatalf
 local new_errno = require('errno').new
 local instanceof = require('metamodule').instanceof
 local is_string = require('lauxhlib.is').str
 local is_file = require('lauxhlib.is').file
+local is_uint = require('lauxhlib.is').uint
 local is_finite = require('lauxhlib.is').finite
-local pread = require('io.pread')
 local fstat = require('fstat')
 local new_header = require('net.http.header').new
+local sendfile = require('net.http.writer').sendfile
+local metrics = require('net.http.metrics')
 --- constants
+-- the data of this size or larger is passed to writev() as a separate iovec,
+-- and the smaller data is copied into the buffer with the header.
+local WRITEV_MINSIZE = 1024 * 4
 local LIST_VALID_VERSION = '0.9 | 1.0 | 1.1'
 local VALID_VERSION = {}
 for _, v in ipairs({
@@ -46,6 +54,7 @@ end
 --- @field header net.http.header
 --- @field version number
 --- @field content? net.http.content
+--- @field template? net.http.template
 --- @field header_sent? integer
 local Message = {}
 
@@ -74,53 +83,131 @@ function Message:set_version(version)
     return true
 end
 
+--- is_keepalive returns true if the connection persists after the message.
+--- the HTTP/1.1 connection persists unless the 'Connection' header has the
+--- 'close' option, and the HTTP/1.0 connection persists only if it has the
+--- 'keep-alive' option.
+--- @return boolean ok
+function Message:is_keepalive()
+    local keepalive = tonumber(self.version) == 1.1
+    local vals = self.header:get('Connection', true)
+    if vals then
+        for i = 1, #vals do
+            for opt in gmatch(lower(vals[i]), '[^%s,]+') do
+                if opt == 'close' then
+                    return false
+                elseif opt == 'keep-alive' then
+                    keepalive = true
+                end
+            end
+        end
+    end
+    return keepalive
+end
+
+--- set_template sets the template of the header fields.
+--- the header fields of the template are written with the header fields of
+--- the message.
+--- @param tmpl? net.http.template
+function Message:set_template(tmpl)
+    if tmpl ~= nil and not instanceof(tmpl, 'net.http.template') then
+        fatalf(2, 'tmpl must be net.http.template')
+    end
+    self.template = tmpl
+end
+
+--- firstline returns the first-line of the message.
+--- @return string? line
+--- @return any err
+function Message:firstline()
+    return ''
+end
+
 --- write_firstline
 --- @param w net.http.writer
 --- @return integer? n
 --- @return any err
 --- @return boolean? timeout
 function Message:write_firstline(w)
-    return 0
+    local line, err = self:firstline()
+    if not line then
+        return nil, errorf('failed to write_firstline()', err)
+    elseif #line == 0 then
+        return 0
+    end
+
+    local n, timeout
+    n, err, timeout = w:write(line)
+    if err then
+        return nil, errorf('failed to write_firstline()', err)
+    elseif not n then
+        return nil, nil, timeout
+    end
+    return n
 end
 
---- write_header
+--- serialize_header
 --- @param self net.http.message
---- @param w net.http.writer
 --- @param with_content? boolean
---- @return integer? n
+--- @return string? head
 --- @return any err
---- @return boolean? timeout
-local function write_header(self, w, with_content)
+local function serialize_header(self, with_content)
     if self.header_sent then
-        fatalf(2, 'header has already been sent')
+        fatalf(3, 'header has already been sent')
     end
-    self.header_sent = 0
 
     local header = self.header
-    if with_content and not header:get('Content-Type') then
+    local tmpl = self.template
+    if with_content and not header:get('Content-Type') and
+        not (tmpl and tmpl:has('Content-Type')) then
         -- add default Content-Type header
         header:set('Content-Type', 'application/octet-stream')
     end
 
-    -- write first-line
-    local n, err, timeout = self:write_firstline(w)
-    if err then
+    local line, err = self:firstline()
+    if not line then
+        return nil, err
+    elseif not tmpl then
+        -- serialize first-line and header into a string
+        return header:serialize(line)
+    elseif tmpl:is_overridden(header) then
+        -- the pre-serialized block cannot be used
+        tmpl:merge(header)
+        return header:serialize(line)
+    end
+    -- splice the pre-serialized block of the template
+    return header:serialize(line, tmpl.block)
+end
+
+--- write_header
+--- @param self net.http.message
+--- @param w net.http.writer
+--- @param with_content? boolean
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+local function write_header(self, w, with_content)
+    local rec = metrics.recorder
+    local t = rec and metrics.now()
+    local head, err = serialize_header(self, with_content)
+    self.header_sent = 0
+    if not head then
         return nil, errorf('failed to write_header()', err)
-    elseif not n then
-        return nil, nil, timeout
     end
 
-    -- write header
-    local len = n
-    n, err, timeout = self.header:write(w)
+    local n, timeout
+    n, err, timeout = w:write(head)
     if err then
         return nil, errorf('failed to write_header()', err)
     elseif not n then
         return nil, nil, timeout
     end
-    self.header_sent = len + n
+    self.header_sent = n
+    if rec then
+        rec:elapsed('write_header', t)
+    end
 
-    return self.header_sent
+    return n
 end
 
 --- write_header
@@ -132,12 +219,15 @@ function Message:write_header(w)
 end
 
 --- write_content
+--- if the chunk handler is passed, the content is written in the chunked
+--- transfer coding through the handler.
 --- @param w net.http.writer
 --- @param content net.http.content
+--- @param handler? net.http.content.chunked.Handler
 --- @return integer? n
 --- @return any err
 --- @return boolean? timeout
-function Message:write_content(w, content)
+function Message:write_content(w, content, handler)
     if not instanceof(content, 'net.http.content') then
         fatalf(2, 'content must be net.http.content')
     end
@@ -146,7 +236,7 @@ function Message:write_content(w, content)
     if not self.header_sent then
         local header = self.header
 
-        if content.is_chunked then
+        if content.is_chunked or handler then
             if not header:is_transfer_encoding_chunked() then
                 header:set('Content-Length')
                 header:set('Transfer-Encoding', 'chunked')
@@ -168,7 +258,7 @@ function Message:write_content(w, content)
     end
 
     -- write content
-    local n, err, timeout = content:write(w)
+    local n, err, timeout = content:write(w, nil, handler)
     if err then
         return nil, errorf('failed to write_content()', err)
     elseif not n then
@@ -177,26 +267,43 @@ function Message:write_content(w, content)
     return len + n
 end
 
---- write_file
+--- write_file writes the size bytes of the file from the offset.
+--- if the size is not specified, the rest of the file from the offset is
+--- written. if the offset is not specified, the current position of the file
+--- is used.
+--- if the timeout occurs while sending the file, the content has been sent
+--- partially and the connection must be closed.
 --- @param w net.http.writer
 --- @param file file*
+--- @param size? integer
+--- @param offset? integer
 --- @return integer? n
 --- @return any err
 --- @return boolean? timeout
-function Message:write_file(w, file)
+function Message:write_file(w, file, size, offset)
     if not is_file(file) then
         fatalf(2, 'file must be file*')
+    elseif size ~= nil and not is_uint(size) then
+        fatalf(2, 'size must be uint')
+    elseif offset ~= nil and not is_uint(offset) then
+        fatalf(2, 'offset must be uint')
     end
 
-    local stat, err = fstat(file)
-    if not stat then
-        return nil, errorf('failed to write_file()', err)
+    local err
+    if offset == nil then
+        -- get the cursor position
+        offset = file:seek()
+    end
+    if size == nil then
+        -- calculate the remaining content size
+        local stat
+        stat, err = fstat(file)
+        if not stat then
+            return nil, errorf('failed to write_file()', err)
+        end
+        size = stat.size - offset
     end
-
-    -- get the cursor position and calculate the remaining content size
     local len = 0
-    local offset = file:seek()
-    local size = stat.size - offset
 
     if not self.header_sent then
         self.header:set('Content-Length', tostring(size))
@@ -212,35 +319,21 @@ function Message:write_file(w, file)
     end
 
     -- write content
-    local bufsize = 4096
-    local s
-    s, err = pread(file, bufsize, offset)
-    while s do
-        local n, timeout
-        n, err, timeout = w:write(s)
-        if err then
-            return nil, errorf('failed to write_file()', err)
-        elseif not n then
-            return nil, nil, timeout
-        end
-        len = len + n
-
-        if n < bufsize then
-            break
-        end
-        -- next read
-        offset = offset + #s
-        s, err = pread(file, bufsize, offset)
-    end
-
+    local n, timeout
+    n, err, timeout = sendfile(w, file, size, offset)
     if err then
         return nil, errorf('failed to write_file()', err)
+    elseif not n or timeout then
+        return nil, nil, timeout
     end
+    len = len + n
 
     return len
 end
 
 --- write data
+--- if the timeout occurs after the part of the header and data is written at
+--- once by writev, then returns the number of bytes written and true.
 --- @param w net.http.writer
 --- @param data? string
 --- @return integer? n
@@ -259,6 +352,29 @@ function Message:write(w, data)
 
     if not self.header_sent then
         self.header:set('Content-Length', tostring(size))
+        if size >= WRITEV_MINSIZE and w.writev then
+            -- write header and data at once without copying the data
+            local head, err = serialize_header(self, true)
+            self.header_sent = 0
+            if not head then
+                return nil, errorf('failed to write()', err)
+            end
+
+            local n, timeout
+            n, err, timeout = w:writev(head, data)
+            if err then
+                return nil, errorf('failed to write()', err)
+            elseif not n then
+                return nil, nil, timeout
+            elseif timeout then
+                -- n bytes of the header and data have been written
+                self.header_sent = n < #head and n or #head
+                return n, nil, true
+            end
+            self.header_sent = #head
+            return n
+        end
+
         -- write header
         local n, err, timeout = write_header(self, w, size > 0)
         if err then
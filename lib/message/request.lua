@@ -30,16 +30,17 @@ local ipairs = ipairs
 local is_string = require('lauxhlib.is').str
 local errorf = require('error').format
 local fatalf = require('error').fatalf
-local pread = require('io.pread')
 local base64encode = require('base64mix').encode
 local instanceof = require('metamodule').instanceof
 local parse_url = require('url').parse
 local realpath = require('realpath')
 local new_errno = require('errno').new
 local new_header = require('net.http.header').new
+local sendfile = require('net.http.writer').sendfile
 local new_form = require('net.http.form').new
 local decode_form = require('net.http.form').decode
 local is_valid_boundary = require('net.http.form').is_valid_boundary
+local new_multipart = require('net.http.form.multipart').new
 --- constants
 local WELL_KNOWN_PORT = {
     ['80'] = true,
@@ -78,6 +79,7 @@ LIST_VALID_METHOD = concat(LIST_VALID_METHOD, ' | ')
 --- @field query string
 --- @field query_params table
 --- @field fragment string
+--- @field multipart net.http.form.multipart?
 local Request = {}
 
 --- init
@@ -185,16 +187,47 @@ function Request:read_form(maxsize, filetmpl)
     return self.form
 end
 
---- write_firstline
---- @param w net.http.writer
---- @return integer? n
+--- read_multipart reads the multipart/form-data content and passes each part
+--- to the handler as it arrives, without spooling the part bodies to the
+--- files. if the timeout is returned, it can be called again to resume.
+--- @param handler net.http.form.multipart.Handler
+--- @param chunksize? integer
+--- @return boolean ok
 --- @return any err
 --- @return boolean? timeout
-function Request:write_firstline(w)
+function Request:read_multipart(handler, chunksize)
+    local dec = self.multipart
+    if not dec then
+        local mime, err, params = self.header:content_type()
+        if err then
+            return false, errorf('failed to read_multipart()', err)
+        elseif mime ~= 'multipart/form-data' then
+            return false, new_errno('EINVAL',
+                                    'invalid Content-Type header: multipart/form-data required')
+        elseif not params or not params.boundary then
+            return false, new_errno('EINVAL',
+                                    'invalid Content-Type header: boundary not defined')
+        elseif not is_valid_boundary(params.boundary) then
+            return false, new_errno('EINVAL',
+                                    'invalid Content-Type header: invalid boundary')
+        elseif not self.content then
+            return false, new_errno('EINVAL', 'content not found')
+        end
+        dec = new_multipart(self.content, params.boundary)
+        self.multipart = dec
+    end
+
+    return dec:decode(handler, chunksize)
+end
+
+--- firstline returns the request-line.
+--- @return string? line
+--- @return any err
+function Request:firstline()
     if not self.host then
         local ok, err = self:set_uri(self.uri)
         if not ok then
-            return nil, errorf('failed to write_firstline()', err)
+            return nil, err
         end
     end
 
@@ -212,7 +245,7 @@ function Request:write_firstline(w)
         self.header:set('Authorization', 'Basic ' .. base64encode(self.userinfo))
     end
 
-    local n, err, timeout = w:write(concat({
+    return concat({
         self.method,
         ' ',
         self.path,
@@ -220,13 +253,7 @@ function Request:write_firstline(w)
         ' HTTP/',
         format('%.1f', self.version),
         '\r\n',
-    }))
-    if err then
-        return nil, errorf('failed to write_firstline()', err)
-    elseif not n then
-        return nil, nil, timeout
-    end
-    return n
+    })
 end
 
 --- write_form
@@ -296,26 +323,14 @@ local function write_form(self, w, form, boundary, tmpfiles)
             end
             nsent = nsent + n
         else
-            -- TODO: add support sendfile api
-            local file = v.file
-            local offset = v.offset
-            local s, err = pread(file, 4096, offset)
-            while s do
-                local n, timeout
-                n, err, timeout = w:write(s)
-                if err then
-                    return nil, errorf('failed to write_form()', err)
-                elseif not n then
-                    return nil, nil, timeout
-                end
-                nsent = nsent + n
-                offset = offset + #s
-                s, err = pread(file, 4096, offset)
-            end
-
+            local n, err, timeout = sendfile(w, v.file, v.len - v.offset,
+                                             v.offset)
             if err then
                 return nil, errorf('failed to write_form()', err)
+            elseif not n or timeout then
+                return nil, nil, timeout
             end
+            nsent = nsent + n
         end
     end
 
@@ -54,24 +54,19 @@ function Response:set_status(code)
     return true
 end
 
---- write_firstline
---- @param w net.http.writer
---- @return integer? n
---- @return any err
---- @return boolean? timeout
-function Response:write_firstline(w)
-    local line = toline(self.status, self.version, self.reason)
-
+--- firstline returns the status-line.
+--- @return string line
+function Response:firstline()
     -- set date header
     self.header:set('Date', date_now())
 
-    local n, err, timeout = w:write(line)
-    if err then
-        return nil, errorf('failed to write_firstline()', err)
-    elseif not n then
-        return nil, nil, timeout
+    -- use the pre-compiled status-line
+    local tmpl = self.template
+    if tmpl and tmpl.line and tmpl.status == self.status and tmpl.version ==
+        self.version and self.reason == nil then
+        return tmpl.line
     end
-    return n
+    return toline(self.status, self.version, self.reason)
 end
 
 return {
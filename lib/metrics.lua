@@ -0,0 +1,234 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local pairs = pairs
+local floor = math.floor
+local log = math.log
+local hrtime = require('net.http.socket').hrtime
+local getpid = require('net.http.socket').getpid
+local encode_json = require('yyjson').encode
+local new_metamodule = require('metamodule').new
+--- constants
+-- the bucket i counts the values in [2^(i-2), 2^(i-1)), and the first bucket
+-- counts the values less than 1. the last bucket counts the rest.
+local NBUCKET = 32
+local INV_LN2 = 1 / log(2)
+local BOUNDS = {}
+for i = 1, NBUCKET - 1 do
+    BOUNDS[i] = 2 ^ (i - 1)
+end
+
+--- @class net.http.metrics.histogram
+--- @field count integer
+--- @field sum number
+--- @field max number
+--- @field buckets integer[]
+local Histogram = {}
+
+--- init
+--- @return net.http.metrics.histogram h
+function Histogram:init()
+    local buckets = {}
+    for i = 1, NBUCKET do
+        buckets[i] = 0
+    end
+    self.count = 0
+    self.sum = 0
+    self.max = 0
+    self.buckets = buckets
+    return self
+end
+
+--- observe records the value.
+--- @param v number
+function Histogram:observe(v)
+    local i = 1
+    if v >= 1 then
+        i = floor(log(v) * INV_LN2) + 2
+        if i > NBUCKET then
+            i = NBUCKET
+        end
+    end
+    self.buckets[i] = self.buckets[i] + 1
+    self.count = self.count + 1
+    self.sum = self.sum + v
+    if v > self.max then
+        self.max = v
+    end
+end
+
+--- percentile returns the upper bound of the bucket that contains the q
+--- quantile of the recorded values.
+--- @param q number
+--- @return number v
+function Histogram:percentile(q)
+    local rank = self.count * q
+    local n = 0
+    for i = 1, NBUCKET - 1 do
+        n = n + self.buckets[i]
+        if n >= rank then
+            return BOUNDS[i]
+        end
+    end
+    return self.max
+end
+
+--- snapshot
+--- @return table snapshot
+function Histogram:snapshot()
+    local buckets = {}
+    for i = 1, NBUCKET do
+        buckets[i] = self.buckets[i]
+    end
+    return {
+        count = self.count,
+        sum = self.sum,
+        max = self.max,
+        p50 = self:percentile(0.5),
+        p99 = self:percentile(0.99),
+        buckets = buckets,
+    }
+end
+
+local new_histogram = new_metamodule.Histogram(Histogram)
+
+--- @class net.http.metrics.recorder
+--- @field counters table<string, integer>
+--- @field histograms table<string, net.http.metrics.histogram>
+local Recorder = {}
+
+--- init
+--- @return net.http.metrics.recorder rec
+function Recorder:init()
+    self.counters = {}
+    self.histograms = {}
+    return self
+end
+
+--- incr increments the counter.
+--- @param name string
+--- @param n? integer
+function Recorder:incr(name, n)
+    self.counters[name] = (self.counters[name] or 0) + (n or 1)
+end
+
+--- observe records the value to the histogram.
+--- @param name string
+--- @param v number
+function Recorder:observe(name, v)
+    local h = self.histograms[name]
+    if not h then
+        h = new_histogram()
+        self.histograms[name] = h
+    end
+    h:observe(v)
+end
+
+--- elapsed records the microseconds elapsed since the time t returned by
+--- hrtime() to the histogram of the phase.
+--- @param phase string
+--- @param t integer
+function Recorder:elapsed(phase, t)
+    self:observe(phase, (hrtime() - t) / 1000)
+end
+
+--- snapshot
+--- @return table snapshot
+function Recorder:snapshot()
+    local counters = {}
+    for k, v in pairs(self.counters) do
+        counters[k] = v
+    end
+    local histograms = {}
+    for k, h in pairs(self.histograms) do
+        histograms[k] = h:snapshot()
+    end
+    return {
+        pid = getpid(),
+        bounds = BOUNDS,
+        counters = counters,
+        histograms = histograms,
+    }
+end
+
+local new_recorder = new_metamodule.Recorder(Recorder)
+
+--- the instrumentation hooks check this field, and record nothing while it is
+--- nil.
+--- @class net.http.metrics
+--- @field recorder? net.http.metrics.recorder
+local metrics = {
+    now = hrtime,
+}
+
+--- enable starts recording the metrics of this process.
+--- @return net.http.metrics.recorder rec
+function metrics.enable()
+    if not metrics.recorder then
+        metrics.recorder = new_recorder()
+    end
+    return metrics.recorder
+end
+
+--- disable stops recording the metrics, and discards the recorded metrics.
+function metrics.disable()
+    metrics.recorder = nil
+end
+
+--- reset discards the recorded metrics.
+function metrics.reset()
+    if metrics.recorder then
+        metrics.recorder = new_recorder()
+    end
+end
+
+--- elapsed records the microseconds elapsed since the time t returned by
+--- now() to the histogram of the phase, such as the handler.
+--- @param phase string
+--- @param t integer
+function metrics.elapsed(phase, t)
+    local rec = metrics.recorder
+    if rec then
+        rec:elapsed(phase, t)
+    end
+end
+
+--- snapshot returns the copy of the recorded metrics of this process.
+--- the durations are recorded in microseconds, and the bounds are the upper
+--- bounds of the buckets of the histograms.
+--- @return table? snapshot
+function metrics.snapshot()
+    local rec = metrics.recorder
+    return rec and rec:snapshot()
+end
+
+--- export returns the snapshot as a JSON string.
+--- @return string? json
+--- @return any err
+function metrics.export()
+    local snapshot = metrics.snapshot()
+    if snapshot then
+        return encode_json(snapshot)
+    end
+end
+
+return metrics
@@ -0,0 +1,244 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local pairs = pairs
+local time = os.time
+local fatalf = require('error').fatalf
+local is_table = require('lauxhlib.is').table
+local is_string = require('lauxhlib.is').str
+local is_pint = require('lauxhlib.is').pint
+local is_finite = require('lauxhlib.is').finite
+local new_errno = require('errno').new
+--- constants
+local DEFAULT_MAXIDLE = 8
+local DEFAULT_IDLE_TIMEOUT = 30
+
+--- @class net.http.pool.item
+--- @field conn net.http.connection
+--- @field time integer the time when the connection was returned
+
+--- @class net.http.pool
+--- @field protected maxidle integer
+--- @field protected maxactive? integer
+--- @field protected idle_timeout number
+--- @field protected hosts table<string, net.http.pool.item[]>
+--- @field protected active table<string, integer>
+local Pool = {}
+
+--- init
+--- @param opts? table
+--- @return net.http.pool pool
+function Pool:init(opts)
+    if opts == nil then
+        opts = {}
+    elseif not is_table(opts) then
+        fatalf(2, 'opts must be table')
+    end
+
+    local maxidle = opts.maxidle
+    if maxidle == nil then
+        maxidle = DEFAULT_MAXIDLE
+    elseif not is_pint(maxidle) then
+        fatalf(2, 'opts.maxidle must be integer greater than 0')
+    end
+
+    local maxactive = opts.maxactive
+    if maxactive ~= nil and not is_pint(maxactive) then
+        fatalf(2, 'opts.maxactive must be integer greater than 0')
+    end
+
+    local idle_timeout = opts.idle_timeout
+    if idle_timeout == nil then
+        idle_timeout = DEFAULT_IDLE_TIMEOUT
+    elseif not is_finite(idle_timeout) or idle_timeout <= 0 then
+        fatalf(2, 'opts.idle_timeout must be finite-number greater than 0')
+    end
+
+    self.maxidle = maxidle
+    self.maxactive = maxactive
+    self.idle_timeout = idle_timeout
+    self.hosts = {}
+    self.active = {}
+    return self
+end
+
+--- evict_idle closes the idle connections that exceed the idle timeout.
+--- @param self net.http.pool
+--- @param key string
+--- @param deadline integer
+local function evict_idle(self, key, deadline)
+    local idle = self.hosts[key]
+    -- the idle connections are sorted by the time they were returned
+    local n = 0
+    for i = 1, #idle do
+        if idle[i].time >= deadline then
+            break
+        end
+        idle[i].conn:close()
+        n = i
+    end
+
+    if n == #idle then
+        self.hosts[key] = nil
+    elseif n > 0 then
+        local rest = {}
+        for i = n + 1, #idle do
+            rest[#rest + 1] = idle[i]
+        end
+        self.hosts[key] = rest
+    end
+end
+
+--- evict closes the idle connections that exceed the idle timeout.
+function Pool:evict()
+    local deadline = time() - self.idle_timeout
+    for key in pairs(self.hosts) do
+        evict_idle(self, key, deadline)
+    end
+end
+
+--- size returns the number of the idle connections of the key.
+--- @param key string
+--- @return integer n
+function Pool:size(key)
+    local idle = self.hosts[key]
+    return idle and #idle or 0
+end
+
+--- nactive returns the number of the active connections of the key.
+--- @param key string
+--- @return integer n
+function Pool:nactive(key)
+    return self.active[key] or 0
+end
+
+--- acquire reserves a slot of the active connection of the key before the
+--- connection is checked out by get() or established.
+--- if the active connections of the key reach opts.maxactive, it does not
+--- wait for the slot to be released and returns the EBUSY error.
+--- the slot is released by put() or release().
+--- @param key string
+--- @return boolean ok
+--- @return any err
+function Pool:acquire(key)
+    if not is_string(key) then
+        fatalf(2, 'key must be string')
+    end
+
+    local n = self.active[key] or 0
+    local max = self.maxactive
+    if max and n >= max then
+        return false, new_errno('EBUSY', 'too many active connections')
+    end
+    self.active[key] = n + 1
+    return true
+end
+
+--- release releases the slot of the active connection of the key that has
+--- been closed instead of being returned by put().
+--- @param key string
+function Pool:release(key)
+    if not is_string(key) then
+        fatalf(2, 'key must be string')
+    end
+
+    local n = self.active[key]
+    if n then
+        self.active[key] = n > 1 and n - 1 or nil
+    end
+end
+
+--- get checks out the most recently returned idle connection of the key.
+--- the connection that exceeds the idle timeout or that cannot be reused is
+--- closed.
+--- @param key string
+--- @return net.http.connection? conn
+function Pool:get(key)
+    if not is_string(key) then
+        fatalf(2, 'key must be string')
+    end
+
+    local idle = self.hosts[key]
+    if not idle then
+        return nil
+    end
+
+    local deadline = time() - self.idle_timeout
+    for i = #idle, 1, -1 do
+        local item = idle[i]
+        idle[i] = nil
+        if item.time >= deadline and item.conn:is_alive() then
+            if i == 1 then
+                self.hosts[key] = nil
+            end
+            return item.conn
+        end
+        item.conn:close()
+    end
+    self.hosts[key] = nil
+end
+
+--- put returns the connection to the pool, and releases the slot of the
+--- active connection.
+--- the connection is closed if it cannot be reused or the idle connections
+--- of the key reach the maximum number.
+--- @param key string
+--- @param conn net.http.connection
+--- @return boolean ok
+function Pool:put(key, conn)
+    if not is_string(key) then
+        fatalf(2, 'key must be string')
+    end
+    self:release(key)
+
+    local now = time()
+    if self.hosts[key] then
+        evict_idle(self, key, now - self.idle_timeout)
+    end
+
+    local idle = self.hosts[key] or {}
+    if #idle >= self.maxidle or not conn:is_alive() then
+        conn:close()
+        return false
+    end
+    idle[#idle + 1] = {
+        conn = conn,
+        time = now,
+    }
+    self.hosts[key] = idle
+    return true
+end
+
+--- close closes all the idle connections.
+function Pool:close()
+    local hosts = self.hosts
+    self.hosts = {}
+    for _, idle in pairs(hosts) do
+        for i = 1, #idle do
+            idle[i].conn:close()
+        end
+    end
+end
+
+return {
+    new = require('metamodule').new(Pool),
+}
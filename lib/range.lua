@@ -0,0 +1,129 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local tonumber = tonumber
+local max = math.max
+local min = math.min
+local sort = table.sort
+local gmatch = string.gmatch
+local match = string.match
+--- constants
+local DEFAULT_MAXRANGES = 16
+
+--- compare
+--- @param a integer[]
+--- @param b integer[]
+--- @return boolean
+local function compare(a, b)
+    return a[1] < b[1]
+end
+
+--- parse parses the Range header value for the representation of the size,
+--- and returns the list of the satisfiable byte ranges, each of which is the
+--- pair of the first and last byte positions. the ranges are sorted in
+--- ascending order, and the overlapping or adjacent ranges are coalesced.
+--- it returns nil if the value is invalid or has more than maxranges ranges,
+--- so that the Range header should be ignored, or returns false if no range
+--- is satisfiable.
+---
+---  Range           = ranges-specifier
+---  ranges-specifier = range-unit "=" range-set
+---  range-set       = 1#range-spec
+---  range-spec      = int-range / suffix-range / other-range
+---  int-range       = first-pos "-" [ last-pos ]
+---  suffix-range    = "-" suffix-length
+---
+--- @param val string
+--- @param size integer
+--- @param maxranges? integer
+--- @return integer[][]|false|nil ranges
+local function parse(val, size, maxranges)
+    local set = match(val, '^%s*[bB][yY][tT][eE][sS]%s*=(.+)$')
+    if not set then
+        return nil
+    end
+
+    local list = {}
+    local nspec = 0
+    for spec in gmatch(set, '[^,]+') do
+        -- ignore the empty list elements
+        if not match(spec, '^%s*$') then
+            local first, last = match(spec, '^%s*(%d*)%-(%d*)%s*$')
+            if not first or (first == '' and last == '') then
+                return nil
+            end
+
+            nspec = nspec + 1
+            if first == '' then
+                -- suffix-range
+                local len = tonumber(last)
+                if len > 0 and size > 0 then
+                    list[#list + 1] = {
+                        max(size - len, 0),
+                        size - 1,
+                    }
+                end
+            else
+                first = tonumber(first)
+                last = last == '' and size - 1 or tonumber(last)
+                if last < first then
+                    return nil
+                elseif first < size then
+                    list[#list + 1] = {
+                        first,
+                        min(last, size - 1),
+                    }
+                end
+            end
+        end
+    end
+
+    if nspec == 0 then
+        return nil
+    elseif #list == 0 then
+        return false
+    end
+
+    -- coalesce the overlapping or adjacent ranges
+    sort(list, compare)
+    local ranges = {
+        list[1],
+    }
+    for i = 2, #list do
+        local prev = ranges[#ranges]
+        local r = list[i]
+        if r[1] <= prev[2] + 1 then
+            prev[2] = max(prev[2], r[2])
+        else
+            ranges[#ranges + 1] = r
+        end
+    end
+
+    if #ranges > (maxranges or DEFAULT_MAXRANGES) then
+        return nil
+    end
+    return ranges
+end
+
+return {
+    parse = parse,
+}
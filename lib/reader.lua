@@ -19,36 +19,79 @@
 -- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 -- THE SOFTWARE.
 --
-local new_reader = require('bufio.reader').new
+local fatalf = require('error').fatalf
+local is_pint = require('lauxhlib.is').pint
+local new_buffer = require('net.http.buffer').new
+local metrics = require('net.http.metrics')
+--- constants
+local DEFAULT_BUFSIZE = 4096
 
 --- @class net.http.reader
---- @field protected reader bufio.reader
+--- @field protected sock net.Socket
+--- @field protected bufsize integer
+--- @field buf net.http.buffer
 local Reader = {}
 
 --- init
 --- @param sock net.Socket
 --- @return net.http.reader reader
 function Reader:init(sock)
-    self.reader = new_reader(sock)
+    self.sock = sock
+    self.bufsize = DEFAULT_BUFSIZE
+    self.buf = new_buffer()
     return self
 end
 
---- setbufsize sets the buffer size.
+--- setbufsize sets the number of bytes to read from the connection at once.
 --- @param size integer
 function Reader:setbufsize(size)
-    self.reader:setbufsize(size)
+    if not is_pint(size) then
+        fatalf(2, 'size must be uint greater than 0')
+    end
+    self.bufsize = size
 end
 
 --- size returns the number of bytes of the unread portion of the buffer.
 --- @return integer size
 function Reader:size()
-    return self.reader:size()
+    return self.buf:size()
 end
 
 --- prepend prepends the data to the reader buffer.
 --- @param data string
 function Reader:prepend(data)
-    self.reader:prepend(data)
+    self.buf:prepend(data)
+end
+
+--- fill reads a data from the connection and appends it to the buffer.
+--- if the error or timeout occurs, then returns nil, err, timeout
+--- otherwise, returns the number of bytes of the unread portion of the buffer.
+--- @param size integer?
+--- @return integer? size
+--- @return any err
+--- @return boolean? timeout
+function Reader:fill(size)
+    local bufsize = self.bufsize
+    if not size or size < bufsize then
+        size = bufsize
+    end
+
+    local rec = metrics.recorder
+    local t = rec and metrics.now()
+    local data, err, timeout = self.sock:read(size)
+    if rec then
+        rec:elapsed('read', t)
+        rec:incr('read_calls')
+        if data then
+            rec:incr('bytes_in', #data)
+        end
+    end
+    if err then
+        return nil, err
+    elseif not data then
+        return nil, nil, timeout
+    end
+    return self.buf:write(data)
 end
 
 --- read a data string from the connection.
@@ -59,13 +102,16 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Reader:read(size)
-    local data, err, timeout = self.reader:read(size)
-    if err then
-        return nil, err
-    elseif timeout then
-        return nil, nil, true
+    local buf = self.buf
+    if buf:size() == 0 then
+        local _, err, timeout = self:fill(size)
+        if err then
+            return nil, err
+        elseif timeout then
+            return nil, nil, true
+        end
     end
-    return data
+    return buf:read(size)
 end
 
 --- readfull reads data from the connection until the buffer is full.
@@ -76,16 +122,23 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Reader:readfull(size)
-    local data, err, timeout = self.reader:readfull(size)
-    if err then
-        return nil, err
-    elseif timeout then
-        return nil, nil, true
+    local buf = self.buf
+    local n = buf:size()
+    while n < size do
+        local err, timeout
+        n, err, timeout = self:fill(size - n)
+        if err then
+            return nil, err
+        elseif timeout then
+            return nil, nil, true
+        elseif not n then
+            -- returns the remaining data if the connection is closed
+            break
+        end
     end
-    return data
+    return buf:read(size)
 end
 
 return {
-    new = require('metamodule').new(Reader, 'bufio.reader'),
+    new = require('metamodule').new(Reader),
 }
-
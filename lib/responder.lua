@@ -20,17 +20,39 @@
 -- THE SOFTWARE.
 --
 local find = string.find
+local lower = string.lower
+local gsub = string.gsub
+local gmatch = string.gmatch
+local format = string.format
+local random = math.random
 local type = type
+local tonumber = tonumber
 local pcall = pcall
-local fopen = require('io.fopen')
+local select = select
 local fatalf = require('error').fatalf
 local errorf = require('error').format
 local checkopt = require('lauxhlib.checkopt')
 local is_file = require('lauxhlib.is').file
+local instanceof = require('metamodule').instanceof
+local is_table = require('lauxhlib.is').table
+local is_int = require('lauxhlib.is').int
+local is_uint = require('lauxhlib.is').uint
 local encode_json = require('yyjson').encode
 local new_mime = require('mime').new
+local date_now = require('net.http.date').now
 local new_response = require('net.http.message.response').new
 local code2message = require('net.http.status').code2message
+local canned = require('net.http.template').canned
+local parse_date = require('net.http.date').parse
+local open_file = require('net.http.filecache').open
+local parse_range = require('net.http.range').parse
+local sendfile = require('net.http.writer').sendfile
+local negotiate = require('net.http.compress').negotiate
+local is_compressible = require('net.http.compress').is_compressible
+local compress = require('net.http.compress').compress
+local new_compressor = require('net.http.compress').new
+--- constants
+local DEFAULT_COMPRESS_MINSIZE = 256
 
 --- @class mime
 --- @field getmime fun(self, ext: string, as_pathname:boolean?): string?
@@ -41,8 +63,17 @@ local code2message = require('net.http.status').code2message
 --- @field private mime mime
 --- @field private filter fun(code:integer, data: any, as_json:boolean?):(data:any, err:any)
 --- @field private message net.http.message.response
+--- @field private compression? net.http.responder.compression
+--- @field private request? net.http.message.request
+--- @field private filecache? net.http.filecache
 local Responder = {}
 
+--- @class net.http.responder.compression
+--- @field accept? string|string[] the Accept-Encoding header value
+--- @field encoding? string the negotiated content-coding
+--- @field level integer
+--- @field minsize integer
+
 --- init
 --- @param writer net.http.writer
 --- @param mime? mime
@@ -76,6 +107,131 @@ function Responder:init(writer, mime, filter)
     return self
 end
 
+--- set_template sets the template of the header fields.
+--- @param tmpl? net.http.template
+function Responder:set_template(tmpl)
+    if tmpl ~= nil and not instanceof(tmpl, 'net.http.template') then
+        fatalf(2, 'tmpl must be net.http.template')
+    end
+    self.message:set_template(tmpl)
+end
+
+--- set_compression enables the compression of the response content with the
+--- content-coding negotiated from the Accept-Encoding header value of the
+--- request. the content is compressed if the Content-Type is compressible and
+--- its size is not less than opts.minsize bytes.
+--- the 'Vary: Accept-Encoding' header is added to the compressible responses
+--- even if the client does not accept any content-coding.
+--- @param accept? string|string[] the Accept-Encoding header value
+--- @param opts? table
+--- @return string? encoding the negotiated content-coding
+function Responder:set_compression(accept, opts)
+    if opts == nil then
+        opts = {}
+    elseif not is_table(opts) then
+        fatalf(2, 'opts must be table')
+    end
+
+    local level = opts.level
+    if level == nil then
+        level = -1
+    elseif not is_int(level) or level < -1 or level > 9 then
+        fatalf(2, 'opts.level must be integer between -1 and 9')
+    end
+
+    local minsize = opts.minsize
+    if minsize == nil then
+        minsize = DEFAULT_COMPRESS_MINSIZE
+    elseif not is_uint(minsize) then
+        fatalf(2, 'opts.minsize must be uint')
+    end
+
+    local encoding = negotiate(accept)
+    self.compression = {
+        accept = accept,
+        encoding = encoding,
+        level = level,
+        minsize = minsize,
+    }
+    return encoding
+end
+
+--- content_type returns the Content-Type header value of the response.
+--- @param self net.http.responder
+--- @return string? val
+local function content_type(self)
+    local val = self.header:get('Content-Type')
+    if val then
+        return val
+    end
+    local tmpl = self.message.template
+    return tmpl and tmpl.header:get('Content-Type')
+end
+
+--- add_vary adds 'Accept-Encoding' to the Vary header unless it is listed.
+--- @param self net.http.responder
+local function add_vary(self)
+    local vals = self.header:get('Vary', true)
+    if vals then
+        for i = 1, #vals do
+            local v = lower(vals[i])
+            if find(v, 'accept-encoding', 1, true) or find(v, '*', 1, true) then
+                return
+            end
+        end
+    end
+    self.header:add('Vary', 'Accept-Encoding')
+end
+
+--- set_encoding sets the Content-Encoding header. the strong ETag is turned
+--- into the weak one, since the encoded representation is not byte-for-byte
+--- identical to the original.
+--- @param self net.http.responder
+--- @param encoding string
+local function set_encoding(self, encoding)
+    local header = self.header
+    header:set('Content-Encoding', encoding)
+    local etag = header:get('ETag')
+    if etag and not find(etag, '^W/') then
+        header:set('ETag', 'W/' .. etag)
+    end
+end
+
+--- compressible returns the compression settings if the response content of
+--- the size is compressed or the response varies by the Accept-Encoding.
+--- @param self net.http.responder
+--- @param size? integer
+--- @return net.http.responder.compression? compression
+local function compressible(self, size)
+    local c = self.compression
+    if c and (not size or size >= c.minsize) and
+        not self.header:get('Content-Encoding') and
+        is_compressible(content_type(self)) then
+        return c
+    end
+end
+
+--- is_chunkable returns true if the response can be sent in the chunked
+--- transfer coding that is not available in HTTP/1.0.
+--- @param self net.http.responder
+--- @return boolean ok
+local function is_chunkable(self)
+    local req = self.request
+    return tonumber(self.message.version) >= 1.1 and
+               (not req or tonumber(req.version) >= 1.1)
+end
+
+--- has_content_type
+--- @param self net.http.responder
+--- @return boolean ok
+local function has_content_type(self)
+    if self.header:get('Content-Type') then
+        return true
+    end
+    local tmpl = self.message.template
+    return tmpl ~= nil and tmpl:has('Content-Type')
+end
+
 --- write a data string to the writer.
 --- if the error or timeout occurs, then returns false, err, timeout,
 --- otherwise, returns a true
@@ -110,6 +266,43 @@ function Responder:write_file(file)
     return true
 end
 
+--- write_content writes the content to the writer.
+--- if the compression is enabled and the content is compressible, the content
+--- is compressed while it is written in the chunked transfer coding. the
+--- content is not compressed for HTTP/1.0 that has no chunked transfer coding.
+--- if the error or timeout occurs, then returns false, err, timeout,
+--- otherwise, returns a true
+--- @param content net.http.content
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Responder:write_content(content)
+    local handler, err
+    if not self.message.header_sent then
+        local size = not content.is_chunked and content:size() or nil
+        local c = compressible(self, size)
+        if c then
+            add_vary(self)
+            if c.encoding and is_chunkable(self) then
+                handler, err = new_compressor(c.encoding, c.level)
+                if not handler then
+                    return false, errorf('failed to write_content()', err)
+                end
+                set_encoding(self, c.encoding)
+            end
+        end
+    end
+
+    local _, timeout
+    _, err, timeout = self.message:write_content(self.writer, content, handler)
+    if err then
+        return false, errorf('failed to write_content()', err)
+    elseif timeout then
+        return false, nil, true
+    end
+    return true
+end
+
 --- flush a calls writer:flush() method
 --- if the error or timeout occurs, then returns flase, err, timeout,
 --- otherwise, returns a true.
@@ -126,10 +319,179 @@ function Responder:flush()
     return true
 end
 
+--- set_request sets the request message to answer. the conditional request
+--- headers of the request are evaluated by reply_file().
+--- @param req? net.http.message.request
+function Responder:set_request(req)
+    if req ~= nil and not instanceof(req, 'net.http.message.request') then
+        fatalf(2, 'req must be net.http.message.request')
+    end
+    self.request = req
+end
+
+--- set_filecache sets the cache of the open files used by reply_file().
+--- @param cache? net.http.filecache
+function Responder:set_filecache(cache)
+    if cache ~= nil and not instanceof(cache, 'net.http.filecache') then
+        fatalf(2, 'cache must be net.http.filecache')
+    end
+    self.filecache = cache
+end
+
+--- is_not_modified evaluates the If-None-Match and If-Modified-Since headers
+--- of the GET or HEAD request.
+--- @param self net.http.responder
+--- @param etag? string
+--- @param mtime integer
+--- @return boolean ok
+local function is_not_modified(self, etag, mtime)
+    local req = self.request
+    if not req or (req.method ~= 'GET' and req.method ~= 'HEAD') then
+        return false
+    end
+
+    -- If-None-Match takes precedence over If-Modified-Since
+    local vals = req.header:get('If-None-Match', true)
+    if vals then
+        -- the weak comparison
+        etag = etag and gsub(etag, '^W/', '')
+        for i = 1, #vals do
+            for tag in gmatch(vals[i], '[^,%s]+') do
+                if tag == '*' or gsub(tag, '^W/', '') == etag then
+                    return true
+                end
+            end
+        end
+        return false
+    end
+
+    local since = req.header:get('If-Modified-Since')
+    since = since and parse_date(since)
+    return since ~= nil and mtime <= since
+end
+
+--- get_ranges returns the byte ranges requested by the Range header of the
+--- GET request. the Range header is ignored if the If-Range header does not
+--- match the representation.
+--- @param self net.http.responder
+--- @param size integer
+--- @param etag? string
+--- @param mtime integer
+--- @return integer[][]|false|nil ranges
+local function get_ranges(self, size, etag, mtime)
+    local req = self.request
+    if not req or req.method ~= 'GET' then
+        return nil
+    end
+
+    local val = req.header:get('Range')
+    if not val then
+        return nil
+    end
+
+    local cond = req.header:get('If-Range')
+    if cond then
+        if find(cond, '"', 1, true) then
+            -- the strong comparison of the entity-tags
+            if cond ~= etag or find(cond, '^W/') then
+                return nil
+            end
+        elseif parse_date(cond) ~= mtime then
+            return nil
+        end
+    end
+    return parse_range(val, size)
+end
+
+--- write_ranges writes the byte ranges of the file as the 206 Partial Content
+--- response. the multiple ranges are written as the multipart/byteranges
+--- content.
+--- @param self net.http.responder
+--- @param entry net.http.filecache.entry
+--- @param ranges integer[][]
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+local function write_ranges(self, entry, ranges)
+    local msg = self.message
+    local header = self.header
+    local w = self.writer
+    local size = entry.size
+    msg:set_status(206)
+
+    if #ranges == 1 then
+        local r = ranges[1]
+        header:set('Content-Range', format('bytes %d-%d/%d', r[1], r[2], size))
+        return msg:write_file(w, entry.file, r[2] - r[1] + 1, r[1])
+    end
+
+    local ctype = content_type(self) or 'application/octet-stream'
+    local boundary = format('%08x%08x', random(0, 0x7fffffff),
+                            random(0, 0x7fffffff))
+    local parts = {}
+    local len = 0
+    for i, r in ipairs(ranges) do
+        local part = format('\r\n--%s\r\nContent-Type: %s\r\n' ..
+                                'Content-Range: bytes %d-%d/%d\r\n\r\n',
+                            boundary, ctype, r[1], r[2], size)
+        parts[i] = part
+        len = len + #part + r[2] - r[1] + 1
+    end
+    local tail = format('\r\n--%s--\r\n', boundary)
+    header:set('Content-Type', 'multipart/byteranges; boundary=' .. boundary)
+    header:set('Content-Length', tostring(len + #tail))
+
+    local n, err, timeout = msg:write_header(w)
+    if not n then
+        return nil, err, timeout
+    end
+    for i, r in ipairs(ranges) do
+        n, err, timeout = w:write(parts[i])
+        if not n then
+            return nil, err, timeout
+        end
+        n, err, timeout = sendfile(w, entry.file, r[2] - r[1] + 1, r[1])
+        if not n or timeout then
+            return nil, err, timeout
+        end
+    end
+    return w:write(tail)
+end
+
+--- open_entry opens the file, or gets it from the file cache.
+--- @param self net.http.responder
+--- @param pathname string
+--- @return net.http.filecache.entry? entry
+--- @return any err
+local function open_entry(self, pathname)
+    local cache = self.filecache
+    if cache then
+        return cache:get(pathname)
+    end
+    return open_file(pathname)
+end
+
+--- close_entry releases the entry to the file cache, or closes the file of
+--- the entry if it is not cached.
+--- @param self net.http.responder
+--- @param entry? net.http.filecache.entry
+local function close_entry(self, entry)
+    if not entry then
+        return
+    elseif self.filecache then
+        self.filecache:release(entry)
+    else
+        entry.file:close()
+    end
+end
+
 --- reply_file a write a file content to the writer.
 --- if the Content-Type header is not set, then determine the content type from
 --- the file extension and set it to the 'Content-Type' header. if the content type
 --- is not found, then set it to 'application/octet-stream' as the default.
+--- if the file is specified by the pathname, the 'Last-Modified' and 'ETag'
+--- headers are set, and the 304 Not Modified response is sent to the
+--- conditional request that matches them.
 --- @param code integer
 --- @param file string|file*
 --- @return boolean ok
@@ -153,10 +515,25 @@ function Responder:reply_file(code, file)
         return self:write('')
     end
 
+    local header = self.header
+    if filetype ~= 'string' then
+        if not has_content_type(self) then
+            -- default content type is binary
+            header:set('Content-Type', 'application/octet-stream')
+        end
+        return self:write_file(file)
+    end
+
+    local entry
+    entry, err = open_entry(self, file)
+    if not entry then
+        return false, errorf('failed to open a file', err)
+    end
+
     -- set 'Content-Type' header
-    if not self.header:get('Content-Type') then
-        local mime = 'application/octet-stream' -- default content type is binary
-        if filetype == 'string' then
+    if not has_content_type(self) then
+        local mime = entry.mime
+        if not mime then
             -- determine the content type from the file extension and set it to
             -- the 'Content-Type' header. if the content type is not found, then set
             -- it to 'application/octet-stream' as the default.
@@ -164,27 +541,140 @@ function Responder:reply_file(code, file)
             if mime == nil then
                 mime = 'application/octet-stream'
             elseif type(mime) ~= 'string' then
+                close_entry(self, entry)
                 return false, errorf(
                            'mime:getmime() returns non-string value: %q',
                            type(mime))
             end
+            entry.mime = mime
         end
-        self.header:set('Content-Type', mime)
+        header:set('Content-Type', mime)
     end
 
-    if filetype ~= 'string' then
-        return self:write_file(file)
+    -- set the validators
+    if not header:get('Last-Modified') then
+        header:set('Last-Modified', entry.last_modified)
+    end
+    if not header:get('ETag') then
+        header:set('ETag', entry.etag)
     end
 
-    local f
-    f, err = fopen(file)
-    if not f then
-        return false, errorf('failed to open a file', err)
+    local mtime = entry.mtime
+    if compressible(self) then
+        -- serve the precompressed sidecar file if exists
+        local sidecar = open_entry(self, file .. '.gz')
+        if sidecar then
+            add_vary(self)
+            if negotiate(self.compression.accept, {
+                'gzip',
+            }) then
+                set_encoding(self, 'gzip')
+                close_entry(self, entry)
+                entry = sidecar
+            else
+                close_entry(self, sidecar)
+            end
+        end
+    end
+
+    if code == 200 and is_not_modified(self, header:get('ETag'), mtime) then
+        close_entry(self, entry)
+        self.message:set_status(304)
+        local _, timeout
+        _, err, timeout = self.message:write_header(self.writer)
+        if err then
+            return false, errorf('failed to reply_file()', err)
+        elseif timeout then
+            return false, nil, true
+        end
+        return true
+    end
+
+    local ranges
+    if code == 200 then
+        if not header:get('Accept-Ranges') then
+            header:set('Accept-Ranges', 'bytes')
+        end
+        ranges = get_ranges(self, entry.size, header:get('ETag'), mtime)
+    end
+
+    local _, timeout
+    if ranges then
+        _, err, timeout = write_ranges(self, entry, ranges)
+    elseif ranges == false then
+        -- 416 Range Not Satisfiable
+        self.message:set_status(416)
+        header:set('Content-Type')
+        header:set('Content-Range', format('bytes */%d', entry.size))
+        _, err, timeout = self.message:write(self.writer)
+    else
+        _, err, timeout = self.message:write_file(self.writer, entry.file,
+                                                  entry.size, 0)
+    end
+    close_entry(self, entry)
+    if err then
+        return false, errorf('failed to write_file()', err)
+    elseif timeout then
+        return false, nil, true
     end
-    local timeout
-    ok, err, timeout = self:write_file(f)
-    f:close()
-    return ok, err, timeout
+    return true
+end
+
+--- writeall
+--- @param w net.http.writer
+--- @param ... string
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+local function writeall(w, ...)
+    if w.writev then
+        return w:writev(...)
+    end
+
+    local len = 0
+    for i = 1, select('#', ...) do
+        local n, err, timeout = w:write((select(i, ...)))
+        if err then
+            return nil, err
+        elseif not n then
+            return nil, nil, timeout
+        end
+        len = len + n
+    end
+    return len
+end
+
+--- reply_canned sends the pre-serialized response of the status code.
+--- the response contains the status message as a plain text, and it has the
+--- 'Connection: close' header. the header fields of the responder are ignored.
+--- the content is not sent if the request method is HEAD.
+--- it is useful to reply to a malformed request.
+--- @param code integer
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Responder:reply_canned(code)
+    if self.message.header_sent then
+        return false, errorf('cannot send a response message twice')
+    end
+
+    local res = canned(code)
+    local req = self.request
+    local content = res.content
+    if req and req.method == 'HEAD' then
+        content = ''
+    end
+    self.message.status = code
+    self.message.header_sent = 0
+    local n, err, timeout = writeall(self.writer, res.head, date_now(),
+                                     res.tail, content)
+    if err then
+        return false, errorf('failed to reply_canned()', err)
+    elseif not n or timeout then
+        return false, nil, timeout
+    end
+    self.message.header_sent = n
+    return true
 end
 
 --- reply a response message.
@@ -230,12 +720,24 @@ function Responder:reply(code, data, as_json)
             return false, errorf('failed to encode data as JSON')
         end
         self.header:set('Content-Type', 'application/json')
-    elseif not self.header:get('Content-Type') then
+    elseif not has_content_type(self) then
         self.header:set('Content-Type', 'application/octet-stream')
         if type(data) ~= 'string' then
             data = tostring(data)
         end
     end
+
+    local c = compressible(self, #data)
+    if c then
+        add_vary(self)
+        if c.encoding then
+            data, err = compress(c.encoding, data, c.level)
+            if not data then
+                return false, errorf('failed to reply()', err)
+            end
+            set_encoding(self, c.encoding)
+        end
+    end
     self.header:set('Content-Length', tostring(#data))
 
     return self:write(data)
@@ -0,0 +1,642 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+--- assign to local
+local type = type
+local select = select
+local tostring = tostring
+local floor = math.floor
+local concat = table.concat
+local sub = string.sub
+local unpack = unpack or table.unpack
+local stderr = io.stderr
+local create = coroutine.create
+local resume = coroutine.resume
+local running = coroutine.running
+local status = coroutine.status
+local yield = coroutine.yield
+local traceback = debug.traceback
+local fatalf = require('error').fatalf
+local is_table = require('lauxhlib.is').table
+local is_pint = require('lauxhlib.is').pint
+local is_finite = require('lauxhlib.is').finite
+local pread = require('io.pread')
+local new_metamodule = require('metamodule').new
+local new_epoll = require('net.http.epoll').new
+local clock = require('net.http.socket').clock
+--- constants
+local DEFAULT_TIMEOUT = 60
+local ACCEPT_BACKOFF_MIN = 0.01
+local ACCEPT_BACKOFF_MAX = 1
+local PREAD_SIZE = 1024 * 64
+
+--- @class net.http.scheduler.task
+--- @field co thread
+--- @field seq integer incremented each time the task is parked or woken
+--- @field fd? integer the fd that the task is waiting for
+--- @field args? table the arguments of the first resume
+--- @field conn? table the connection that is closed when the task ends
+--- @field deadline? integer the time that the waits of the task time out at
+
+--- @class net.http.scheduler.timer
+--- @field at integer
+--- @field task net.http.scheduler.task
+--- @field seq integer
+
+--- push_timer pushes the timer to the binary heap ordered by the time.
+--- @param heap net.http.scheduler.timer[]
+--- @param timer net.http.scheduler.timer
+local function push_timer(heap, timer)
+    local i = #heap + 1
+    heap[i] = timer
+    while i > 1 do
+        local parent = floor(i / 2)
+        if heap[parent].at <= timer.at then
+            break
+        end
+        heap[i], heap[parent] = heap[parent], timer
+        i = parent
+    end
+end
+
+--- pop_timer removes the earliest timer from the binary heap.
+--- @param heap net.http.scheduler.timer[]
+--- @return net.http.scheduler.timer? timer
+local function pop_timer(heap)
+    local top = heap[1]
+    local n = #heap
+    local last = heap[n]
+    heap[n] = nil
+    n = n - 1
+    if n > 0 then
+        local i = 1
+        heap[1] = last
+        while true do
+            local child = i * 2
+            if child > n then
+                break
+            elseif child < n and heap[child + 1].at < heap[child].at then
+                child = child + 1
+            end
+            if last.at <= heap[child].at then
+                break
+            end
+            heap[i], heap[child] = heap[child], last
+            i = child
+        end
+    end
+    return top
+end
+
+--- @class net.http.scheduler
+--- @field protected ep net.http.epoll
+--- @field protected timeout number
+--- @field protected deadline? number
+--- @field protected tasks table<thread, net.http.scheduler.task>
+--- @field protected ntask integer
+--- @field protected ready table[] the tasks to be resumed with the arguments
+--- @field protected waiting table<integer, net.http.scheduler.task>
+--- @field protected timers net.http.scheduler.timer[]
+--- @field protected is_running boolean
+local Scheduler = {}
+
+--- init
+--- @param opts? table
+--- @return net.http.scheduler sched
+function Scheduler:init(opts)
+    if opts == nil then
+        opts = {}
+    elseif not is_table(opts) then
+        fatalf(2, 'opts must be table')
+    elseif opts.timeout ~= nil and
+        (not is_finite(opts.timeout) or opts.timeout <= 0) then
+        fatalf(2, 'opts.timeout must be finite-number greater than 0')
+    elseif opts.deadline ~= nil and
+        (not is_finite(opts.deadline) or opts.deadline <= 0) then
+        fatalf(2, 'opts.deadline must be finite-number greater than 0')
+    elseif opts.maxevents ~= nil and not is_pint(opts.maxevents) then
+        fatalf(2, 'opts.maxevents must be integer greater than 0')
+    end
+
+    local ep, err = new_epoll(opts.maxevents)
+    if not ep then
+        return nil, err
+    end
+    self.ep = ep
+    self.timeout = opts.timeout or DEFAULT_TIMEOUT
+    self.deadline = opts.deadline
+    self.tasks = {}
+    self.ntask = 0
+    self.ready = {}
+    self.waiting = {}
+    self.timers = {}
+    self.is_running = false
+    return self
+end
+
+--- spawn creates the task and schedules it to run.
+--- @param self net.http.scheduler
+--- @param fn function
+--- @param conn? table
+--- @param ... any
+local function spawn(self, fn, conn, ...)
+    local task = {
+        co = create(fn),
+        seq = 0,
+        args = {
+            n = select('#', ...),
+            ...,
+        },
+        conn = conn,
+    }
+    self.tasks[task.co] = task
+    self.ntask = self.ntask + 1
+    self.ready[#self.ready + 1] = {
+        task,
+    }
+    return task
+end
+
+--- spawn runs the function in a new coroutine.
+--- @param fn function
+--- @param ... any the arguments of the function
+function Scheduler:spawn(fn, ...)
+    if type(fn) ~= 'function' then
+        fatalf(2, 'fn must be function')
+    end
+    spawn(self, fn, nil, ...)
+end
+
+--- wait parks the current task until the fd becomes readable, or writable if
+--- writable is true. it returns false if the sec seconds elapse before that.
+--- @param fd integer
+--- @param writable? boolean
+--- @param sec? number
+--- @return boolean ok
+--- @return any err
+function Scheduler:wait(fd, writable, sec)
+    local task = self.tasks[running()]
+    if not task then
+        fatalf(2, 'wait() must be called from the task of the scheduler')
+    end
+
+    -- the wait cannot outlast the deadline of the task
+    local deadline = task.deadline
+    if deadline then
+        local remain = (deadline - clock()) / 1000
+        if remain <= 0 then
+            return false
+        elseif not sec or sec > remain then
+            sec = remain
+        end
+    end
+
+    local ok, err = self.ep:watch(fd, writable)
+    if not ok then
+        return false, err
+    end
+
+    local seq = task.seq + 1
+    task.seq = seq
+    task.fd = fd
+    self.waiting[fd] = task
+    if sec then
+        push_timer(self.timers, {
+            at = clock() + floor(sec * 1000),
+            task = task,
+            seq = seq,
+        })
+    end
+    return yield()
+end
+
+--- sleep parks the current task for the sec seconds.
+--- @param sec number
+function Scheduler:sleep(sec)
+    local task = self.tasks[running()]
+    if not task then
+        fatalf(2, 'sleep() must be called from the task of the scheduler')
+    elseif not is_finite(sec) or sec < 0 then
+        fatalf(2, 'sec must be finite-number greater than or equal to 0')
+    end
+
+    local seq = task.seq + 1
+    task.seq = seq
+    push_timer(self.timers, {
+        at = clock() + floor(sec * 1000),
+        task = task,
+        seq = seq,
+    })
+    yield()
+end
+
+--- wake schedules the parked task to resume.
+--- @param self net.http.scheduler
+--- @param task net.http.scheduler.task
+--- @param ok boolean
+local function wake(self, task, ok)
+    if task.fd then
+        self.waiting[task.fd] = nil
+        task.fd = nil
+    end
+    task.seq = task.seq + 1
+    self.ready[#self.ready + 1] = {
+        task,
+        ok,
+    }
+end
+
+--- step resumes the task, and removes it when it ends.
+--- @param self net.http.scheduler
+--- @param task net.http.scheduler.task
+--- @param ok? boolean
+local function step(self, task, ok)
+    local co = task.co
+    local args = task.args
+    local err
+    if args then
+        task.args = nil
+        ok, err = resume(co, unpack(args, 1, args.n))
+    else
+        ok, err = resume(co, ok)
+    end
+    if not ok then
+        stderr:write(traceback(co, tostring(err)), '\n')
+    end
+
+    if status(co) == 'dead' then
+        self.tasks[co] = nil
+        self.ntask = self.ntask - 1
+        if task.conn then
+            task.conn:close()
+        end
+    end
+end
+
+--- next_timeout returns the milliseconds until the earliest timer expires.
+--- @param self net.http.scheduler
+--- @return integer msec -1 if no timer exists
+local function next_timeout(self)
+    local timers = self.timers
+    local timer = timers[1]
+    -- discard the timers of the tasks that have already been woken
+    while timer and timer.seq ~= timer.task.seq do
+        pop_timer(timers)
+        timer = timers[1]
+    end
+
+    if not timer then
+        return -1
+    end
+    local msec = timer.at - clock()
+    return msec > 0 and msec or 0
+end
+
+--- expire wakes the tasks whose timers have expired.
+--- @param self net.http.scheduler
+local function expire(self)
+    local timers = self.timers
+    local now = clock()
+    local timer = timers[1]
+    while timer and timer.at <= now do
+        pop_timer(timers)
+        if timer.seq == timer.task.seq then
+            wake(self, timer.task, false)
+        end
+        timer = timers[1]
+    end
+end
+
+--- run runs the tasks until all the tasks end or stop() is called.
+--- @return boolean ok
+--- @return any err
+function Scheduler:run()
+    self.is_running = true
+    while self.is_running and self.ntask > 0 do
+        -- resume the ready tasks
+        local ready = self.ready
+        self.ready = {}
+        for i = 1, #ready do
+            step(self, ready[i][1], ready[i][2])
+        end
+
+        if self.is_running and self.ntask > 0 then
+            local msec = #self.ready > 0 and 0 or next_timeout(self)
+            local fds, err = self.ep:wait(msec)
+            if not fds then
+                self.is_running = false
+                return false, err
+            end
+
+            local waiting = self.waiting
+            for i = 1, #fds do
+                local task = waiting[fds[i]]
+                if task then
+                    wake(self, task, true)
+                end
+            end
+            expire(self)
+        end
+    end
+    self.is_running = false
+    return true
+end
+
+--- stop stops the run() method after the running tasks are parked.
+function Scheduler:stop()
+    self.is_running = false
+end
+
+--- @class net.http.scheduler.Socket
+--- @field protected sched net.http.scheduler
+--- @field protected sock net.stream.Socket
+--- @field protected sockfd integer
+--- @field protected rcvto number
+--- @field protected sndto number
+local Socket = {}
+
+--- init
+--- @param sched net.http.scheduler
+--- @param sock net.stream.Socket
+--- @return net.http.scheduler.Socket sock
+function Socket:init(sched, sock)
+    sock:nonblock(true)
+    self.sched = sched
+    self.sock = sock
+    self.sockfd = sock:fd()
+    self.rcvto = sched.timeout
+    self.sndto = sched.timeout
+    return self
+end
+
+--- fd
+--- @return integer fd
+function Socket:fd()
+    return self.sockfd
+end
+
+--- rcvtimeo sets the seconds to wait for the socket to become readable.
+--- @param sec? number
+--- @return number prev
+function Socket:rcvtimeo(sec)
+    local prev = self.rcvto
+    if sec then
+        self.rcvto = sec
+    end
+    return prev
+end
+
+--- sndtimeo sets the seconds to wait for the socket to become writable.
+--- @param sec? number
+--- @return number prev
+function Socket:sndtimeo(sec)
+    local prev = self.sndto
+    if sec then
+        self.sndto = sec
+    end
+    return prev
+end
+
+--- park parks the task until the socket becomes ready.
+--- @param self net.http.scheduler.Socket
+--- @param writable boolean
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function park(self, writable)
+    local ok, err = self.sched:wait(self.sockfd, writable,
+                                    writable and self.sndto or self.rcvto)
+    if ok then
+        return true
+    elseif err then
+        return false, err
+    end
+    return false, nil, true
+end
+
+--- read
+--- @param size integer
+--- @return string? s
+--- @return any err
+--- @return boolean? timeout
+function Socket:read(size)
+    local sock = self.sock
+    while true do
+        local s, err, timeout = sock:read(size)
+        if s or err or not timeout then
+            return s, err, timeout
+        end
+
+        -- wait until readable
+        local ok
+        ok, err, timeout = park(self, false)
+        if not ok then
+            return nil, err, timeout
+        end
+    end
+end
+
+--- write
+--- @param data string
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Socket:write(data)
+    local sock = self.sock
+    local len = #data
+    local nsent = 0
+    while true do
+        local n, err, timeout = sock:write(nsent > 0 and sub(data, nsent + 1) or
+                                               data)
+        if err then
+            return nil, err
+        elseif n then
+            nsent = nsent + n
+            if nsent >= len then
+                return nsent
+            end
+        elseif not timeout then
+            -- closed by peer
+            return nil
+        end
+
+        if timeout then
+            -- wait until writable
+            local ok
+            ok, err, timeout = park(self, true)
+            if not ok then
+                return nil, err, timeout
+            end
+        end
+    end
+end
+
+--- writev
+--- @param ... string
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Socket:writev(...)
+    local sock = self.sock
+    if type(sock.writev) ~= 'function' then
+        return self:write(concat({
+            ...,
+        }))
+    end
+
+    local len = 0
+    for i = 1, select('#', ...) do
+        len = len + #select(i, ...)
+    end
+
+    local n, err, timeout = sock:writev(...)
+    if err then
+        return nil, err
+    elseif not n and not timeout then
+        return nil
+    elseif n and n >= len then
+        return n
+    end
+
+    -- write the remaining bytes of the parts that have not been sent
+    local parts = {
+        ...,
+    }
+    local i = 1
+    n = n or 0
+    while n >= #parts[i] do
+        n = n - #parts[i]
+        i = i + 1
+    end
+    parts[i] = sub(parts[i], n + 1)
+    n, err, timeout = self:write(concat(parts, '', i))
+    if not n then
+        return nil, err, timeout
+    end
+    return len
+end
+
+--- sendfile
+--- @param file file*
+--- @param len integer
+--- @param offset integer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Socket:sendfile(file, len, offset)
+    local sock = self.sock
+    if type(sock.sendfile) ~= 'function' then
+        -- write the part of the file
+        local s, err = pread(file, len < PREAD_SIZE and len or PREAD_SIZE,
+                             offset)
+        if err then
+            return nil, err
+        elseif not s or #s == 0 then
+            return 0
+        end
+        return self:write(s)
+    end
+
+    while true do
+        local n, err, timeout = sock:sendfile(file, len, offset)
+        if n or err or not timeout then
+            return n, err, timeout
+        end
+
+        -- wait until writable
+        local ok
+        ok, err, timeout = park(self, true)
+        if not ok then
+            return nil, err, timeout
+        end
+    end
+end
+
+--- close
+--- @return boolean ok
+--- @return any err
+function Socket:close()
+    self.sched.ep:unwatch(self.sockfd)
+    return self.sock:close()
+end
+
+local new_socket = new_metamodule.Socket(Socket)
+
+--- wrap wraps the non-blocking socket so that the read and write methods park
+--- the task instead of returning the timeout while the socket would block.
+--- @param sock net.stream.Socket
+--- @return net.http.scheduler.Socket sock
+function Scheduler:wrap(sock)
+    return new_socket(self, sock)
+end
+
+--- serve accepts the connections of the listening server, and calls the
+--- handler with each connection in a new task. the connection is closed when
+--- the handler returns. if the deadline option is set, the waits of the task
+--- time out once the deadline seconds have elapsed since the connection was
+--- accepted. if accept() fails, it retries after the backoff that doubles on
+--- each consecutive failure.
+--- @param s net.http.server
+--- @param handler fun(c:net.http.connection)
+function Scheduler:serve(s, handler)
+    if type(handler) ~= 'function' then
+        fatalf(2, 'handler must be function')
+    end
+
+    s:set_sockwrapper(function(sock)
+        return new_socket(self, sock)
+    end)
+    s:nonblock(true)
+    spawn(self, function()
+        local fd = s:fd()
+        local backoff = 0
+        while true do
+            local c, err = s:accept()
+            if c then
+                backoff = 0
+                local task = spawn(self, handler, c, c)
+                if self.deadline then
+                    task.deadline = clock() + floor(self.deadline * 1000)
+                end
+            elseif err then
+                -- the listening socket stays readable on the errors such as
+                -- EMFILE, so wait a while before the next accept()
+                stderr:write('failed to accept(): ', tostring(err), '\n')
+                backoff = backoff > 0 and backoff * 2 or ACCEPT_BACKOFF_MIN
+                if backoff > ACCEPT_BACKOFF_MAX then
+                    backoff = ACCEPT_BACKOFF_MAX
+                end
+                self:sleep(backoff)
+            else
+                -- wait for the next connection
+                local ok
+                ok, err = self:wait(fd)
+                if not ok then
+                    error(err)
+                end
+            end
+        end
+    end)
+end
+
+return {
+    new = new_metamodule(Scheduler),
+}
@@ -24,19 +24,62 @@
 -- Created by Masatoshi Teruya on 17/08/01.
 --
 --- assign to local
+local pairs = pairs
+local next = next
+local pcall = pcall
+local type = type
+local tostring = tostring
 local find = string.find
 local sub = string.sub
+local exit = os.exit
+local stderr = io.stderr
+local traceback = debug.traceback
 local fatalf = require('error').fatalf
+local new_errno = require('errno').new
 local new_metamodule = require('metamodule').new
 local is_string = require('lauxhlib.is').str
 local is_table = require('lauxhlib.is').table
+local is_pint = require('lauxhlib.is').pint
+local is_finite = require('lauxhlib.is').finite
 local new_inet_server = require('net.stream.inet').server.new
 local new_unix_server = require('net.stream.unix').server.new
 local new_connection = require('net.http.connection').new
+local clock = require('net.http.socket').clock
+-- net.http.process is built only on linux
+local has_process, process = pcall(require, 'net.http.process')
+if not has_process then
+    process = {}
+end
+local fork = process.fork
+local kill = process.kill
+local reap = process.reap
+local sigwait = process.sigwait
+local SIGCHLD = process.SIGCHLD
+local SIGHUP = process.SIGHUP
+local SIGKILL = process.SIGKILL
+local SIGTERM = process.SIGTERM
+--- constants
+-- the minimum interval in milliseconds to restart the crashed worker
+local RESTART_INTERVAL = 1000
+local DEFAULT_SHUTDOWN_TIMEOUT = 10
 
 -- base for net.http.server.* classes
+--- @class net.http.server
+--- @field max_requests? integer
+--- @field idle_timeout? number
+--- @field sockwrapper? fun(sock:net.stream.Socket):table
 local Server = {}
 
+--- set_sockwrapper sets the function that wraps the accepted socket before
+--- the connection is created.
+--- @param fn? fun(sock:net.stream.Socket):table
+function Server:set_sockwrapper(fn)
+    if fn ~= nil and type(fn) ~= 'function' then
+        fatalf(2, 'fn must be function')
+    end
+    self.sockwrapper = fn
+end
+
 --- accepted
 --- @param self net.stream.Socket
 --- @param sock net.stream.Socket
@@ -45,7 +88,11 @@ local Server = {}
 --- @return any err
 --- @return llsocket.addrinfo ai
 function Server:accepted(sock, ai)
-    return new_connection(sock), nil, ai
+    local wrap = self.sockwrapper
+    local c = new_connection(wrap and wrap(sock) or sock)
+    c:set_max_requests(self.max_requests)
+    c:set_idle_timeout(self.idle_timeout)
+    return c, nil, ai
 end
 
 --- @class net.http.server.Inet : net.stream.inet.Server
@@ -62,6 +109,16 @@ local UnixServer = new_metamodule.Unix(Server, 'net.stream.unix.Server')
 local UnixTLSServer = new_metamodule.UnixTLS(Server,
                                              'net.tls.stream.unix.Server')
 
+--- setopts sets the options of the persistent connections to the server.
+--- @param s net.http.server
+--- @param opts table
+--- @return net.http.server s
+local function setopts(s, opts)
+    s.max_requests = opts.max_requests
+    s.idle_timeout = opts.idle_timeout
+    return s
+end
+
 --- new
 --- @param addr string
 --- @param opts table?
@@ -74,6 +131,11 @@ local function new(addr, opts)
         opts = {}
     elseif not is_table(opts) then
         fatalf(2, 'opts must be table')
+    elseif opts.max_requests ~= nil and not is_pint(opts.max_requests) then
+        fatalf(2, 'opts.max_requests must be integer greater than 0')
+    elseif opts.idle_timeout ~= nil and
+        (not is_finite(opts.idle_timeout) or opts.idle_timeout <= 0) then
+        fatalf(2, 'opts.idle_timeout must be finite-number greater than 0')
     end
     --- @cast opts table
 
@@ -83,9 +145,9 @@ local function new(addr, opts)
         if not s then
             return nil, err
         elseif s.tls then
-            return UnixTLSServer(s.sock, s.tls)
+            return setopts(UnixTLSServer(s.sock, s.tls), opts)
         end
-        return UnixServer(s.sock)
+        return setopts(UnixServer(s.sock), opts)
     end
 
     -- inet server
@@ -101,12 +163,291 @@ local function new(addr, opts)
     if not s then
         return nil, err
     elseif s.tls then
-        return InetTSLServer(s.sock, s.tls)
+        return setopts(InetTSLServer(s.sock, s.tls), opts)
+    end
+    return setopts(InetServer(s.sock), opts)
+end
+
+--- @class net.http.server.worker
+--- @field id integer
+--- @field pid integer
+--- @field started integer the time in milliseconds when the worker started
+--- @field retired? boolean
+
+--- @class net.http.server.supervisor
+--- @field addr string
+--- @field opts table
+--- @field handler fun(s:net.http.server, id:integer)
+--- @field server? net.http.server the listener inherited by the workers
+--- @field workers table<integer, net.http.server.worker>
+--- @field restarts table<integer, integer> the worker id to restart at the time
+
+--- run_worker creates the server in the worker process and calls the handler.
+--- @param sv net.http.server.supervisor
+--- @param id integer
+local function run_worker(sv, id)
+    local ok, err = process.watch_terminate()
+    if ok then
+        local s = sv.server
+        if not s then
+            -- each worker listens to its own socket bound with SO_REUSEPORT
+            s, err = new(sv.addr, sv.opts)
+            if s then
+                ok, err = s:listen(sv.opts.backlog)
+            end
+        end
+        if s and ok then
+            ok, err = pcall(sv.handler, s, id)
+            if not ok then
+                err = traceback(err)
+            end
+        end
+    end
+
+    if err then
+        stderr:write('worker#', id, ': ', tostring(err), '\n')
+        exit(1)
+    end
+    exit(0)
+end
+
+--- spawn forks the worker process.
+--- @param sv net.http.server.supervisor
+--- @param id integer
+--- @return boolean ok
+--- @return any err
+local function spawn(sv, id)
+    local pid, err = fork()
+    if not pid then
+        return false, err
+    elseif pid == 0 then
+        run_worker(sv, id)
+    end
+    sv.workers[pid] = {
+        id = id,
+        pid = pid,
+        started = clock(),
+    }
+    return true
+end
+
+--- signal sends the signal to all the workers.
+--- @param sv net.http.server.supervisor
+--- @param signo integer
+local function signal(sv, signo)
+    for pid in pairs(sv.workers) do
+        kill(pid, signo)
+    end
+end
+
+--- reload replaces the workers with the new ones, and terminates the old
+--- workers gracefully.
+--- @param sv net.http.server.supervisor
+--- @return boolean ok
+--- @return any err
+local function reload(sv)
+    local olds = {}
+    for pid, w in pairs(sv.workers) do
+        if not w.retired then
+            olds[pid] = w
+        end
+    end
+    for pid, w in pairs(olds) do
+        local ok, err = spawn(sv, w.id)
+        if not ok then
+            return false, err
+        end
+        w.retired = true
+        kill(pid, SIGTERM)
+    end
+    return true
+end
+
+--- collect reaps the terminated workers, and schedules to restart the worker
+--- that exits unexpectedly with the non-zero status or the signal.
+--- @param sv net.http.server.supervisor
+--- @param stopping boolean
+local function collect(sv, stopping)
+    local pid, status = reap()
+    while pid do
+        local w = sv.workers[pid]
+        if w then
+            sv.workers[pid] = nil
+            if not stopping and not w.retired and status ~= 0 then
+                -- restarting is delayed if the worker crashes repeatedly
+                sv.restarts[w.id] = w.started + RESTART_INTERVAL
+            end
+        end
+        pid, status = reap()
+    end
+end
+
+--- restart restarts the crashed workers.
+--- @param sv net.http.server.supervisor
+--- @return integer? msec the milliseconds until the next restart
+--- @return any err
+local function restart(sv)
+    local now = clock()
+    local msec
+    for id, at in pairs(sv.restarts) do
+        if at <= now then
+            local ok, err = spawn(sv, id)
+            if not ok then
+                return nil, err
+            end
+            sv.restarts[id] = nil
+        elseif not msec or at - now < msec then
+            msec = at - now
+        end
+    end
+    return msec
+end
+
+--- supervise waits for the signals until all the workers exit.
+--- SIGHUP reloads the workers, SIGTERM and SIGINT shut down the workers
+--- gracefully.
+--- @param sv net.http.server.supervisor
+--- @return boolean ok
+--- @return any err
+local function supervise(sv)
+    local timeout = (sv.opts.shutdown_timeout or DEFAULT_SHUTDOWN_TIMEOUT) *
+                        1000
+    local deadline
+    while next(sv.workers) or (not deadline and next(sv.restarts)) do
+        local msec, err
+        if deadline then
+            msec = deadline - clock()
+            if msec <= 0 then
+                -- kill the workers that did not exit in time
+                signal(sv, SIGKILL)
+                msec = nil
+            end
+        else
+            msec, err = restart(sv)
+            if err then
+                signal(sv, SIGKILL)
+                return false, err
+            end
+        end
+
+        local signo
+        signo, err = sigwait(msec)
+        if err then
+            signal(sv, SIGKILL)
+            return false, err
+        elseif signo == SIGCHLD then
+            collect(sv, deadline ~= nil)
+        elseif signo == SIGHUP then
+            if not deadline then
+                local ok
+                ok, err = reload(sv)
+                if not ok then
+                    signal(sv, SIGKILL)
+                    return false, err
+                end
+            end
+        elseif signo and not deadline then
+            -- SIGTERM or SIGINT
+            signal(sv, SIGTERM)
+            deadline = clock() + timeout
+        end
+    end
+    return true
+end
+
+--- prefork forks the worker processes that call the handler with the server
+--- listening to the addr, and supervises them until SIGTERM or SIGINT is
+--- received. the inet workers listen to their own sockets bound with
+--- SO_REUSEPORT, so that the kernel distributes the connections among them.
+--- the unix workers share the listening socket created by the supervisor.
+--- the crashed workers are restarted, and SIGHUP replaces all the workers
+--- with the new ones.
+--- the handler should stop accepting the connections when is_terminated()
+--- returns true.
+--- it returns ENOTSUP error on the platform other than linux.
+--- @param addr string
+--- @param opts table?
+--- @param handler fun(s:net.http.server, id:integer)
+--- @return boolean ok
+--- @return any err
+local function prefork(addr, opts, handler)
+    if not is_string(addr) then
+        fatalf(2, 'addr must be string')
+    elseif opts == nil then
+        opts = {}
+    elseif not is_table(opts) then
+        fatalf(2, 'opts must be table')
+    elseif opts.workers ~= nil and not is_pint(opts.workers) then
+        fatalf(2, 'opts.workers must be integer greater than 0')
+    elseif opts.shutdown_timeout ~= nil and
+        (not is_finite(opts.shutdown_timeout) or opts.shutdown_timeout <=
+            0) then
+        fatalf(2, 'opts.shutdown_timeout must be finite-number greater than 0')
+    elseif type(handler) ~= 'function' then
+        fatalf(2, 'handler must be function')
+    elseif not has_process then
+        return false, new_errno('ENOTSUP',
+                                'prefork is not supported on this platform')
+    end
+
+    local wopts = {}
+    for k, v in pairs(opts) do
+        wopts[k] = v
+    end
+    wopts.reuseport = true
+
+    -- the supervisor holds the bound socket to reserve the address
+    local s, err = new(addr, wopts)
+    if not s then
+        return false, err
+    end
+
+    --- @type net.http.server.supervisor
+    local sv = {
+        addr = addr,
+        opts = wopts,
+        handler = handler,
+        workers = {},
+        restarts = {},
+    }
+    if find(addr, '^[./]') then
+        local ok
+        ok, err = s:listen(opts.backlog)
+        if not ok then
+            s:close()
+            return false, err
+        end
+        sv.server = s
+    elseif find(addr, ':0*$') or not find(addr, ':') then
+        -- the workers bind to the port assigned to the supervisor
+        local host = sub(addr, 1, (find(addr, ':') or #addr + 1) - 1)
+        sv.addr = host .. ':' .. s:getsockname():port()
+    end
+
+    local ok
+    ok, err = process.sigblock()
+    if ok then
+        for id = 1, opts.workers or process.ncpu() do
+            ok, err = spawn(sv, id)
+            if not ok then
+                signal(sv, SIGKILL)
+                break
+            end
+        end
+        if ok then
+            ok, err = supervise(sv)
+        end
+        process.sigunblock()
     end
-    return InetServer(s.sock)
+    s:close()
+    return ok, err
 end
 
 return {
     new = new,
+    prefork = prefork,
+    is_terminated = process.is_terminated or function()
+        return false
+    end,
 }
 
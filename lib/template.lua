@@ -0,0 +1,161 @@
+--
+-- Copyright (C) 2022 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+local lower = string.lower
+local pairs = pairs
+local sub = string.sub
+local format = string.format
+local concat = table.concat
+local fatalf = require('error').fatalf
+local instanceof = require('metamodule').instanceof
+local is_table = require('lauxhlib.is').table
+local new_header = require('net.http.header').new
+local status = require('net.http.status')
+local code2name = status.code2name
+local code2message = status.code2message
+local toline = status.toline
+
+--- @class net.http.template
+--- @field status? integer
+--- @field version? number
+--- @field line? string
+--- @field block string
+--- @field names table<string, boolean>
+--- @field private header net.http.header
+local Template = {}
+
+--- init compiles the header fields into the pre-serialized block.
+--- if the status code is specified, the status-line is also compiled.
+--- the compiled template should not be modified.
+--- @param header table|net.http.header
+--- @param code? integer
+--- @param version? number
+--- @param reason? string
+--- @return net.http.template tmpl
+function Template:init(header, code, version, reason)
+    if not instanceof(header, 'net.http.header') then
+        if not is_table(header) then
+            fatalf(2, 'header must be table or net.http.header')
+        end
+        header = new_header(header)
+    end
+
+    if code ~= nil then
+        if not code2name(code) then
+            fatalf(2, 'unsupported status code %q', code)
+        end
+        if version == nil then
+            version = 1.1
+        end
+        self.status = code
+        self.version = version
+        self.line = toline(code, version, reason)
+    end
+
+    -- header-fields without the empty line
+    self.block = sub(header:serialize(), 1, -3)
+    self.names = {}
+    for _, k in header:pairs() do
+        self.names[lower(k)] = true
+    end
+    self.header = header
+    return self
+end
+
+--- has returns true if the template contains the header field.
+--- @param key string
+--- @return boolean ok
+function Template:has(key)
+    return self.names[lower(key)] == true
+end
+
+--- is_overridden returns true if the header has a field that the template
+--- contains.
+--- @param header net.http.header
+--- @return boolean ok
+function Template:is_overridden(header)
+    for k in pairs(self.names) do
+        if header:get(k) then
+            return true
+        end
+    end
+    return false
+end
+
+--- merge adds the header fields of the template that the header does not
+--- contain to the header.
+--- @param header net.http.header
+function Template:merge(header)
+    local items = self.header.dict
+    for i = 1, #items do
+        local item = items[i]
+        if not header:get(item.key) then
+            header:set(item.key, item.val)
+        end
+    end
+end
+
+Template = require('metamodule').new(Template)
+
+--- @class net.http.template.canned
+--- @field head string status-line and the beginning of Date header
+--- @field tail string the rest of the header fields and the empty line
+--- @field content string the status message
+--- canned responses of the status code
+local CANNED = {}
+
+--- canned returns the pre-serialized response of the status code.
+--- the response is sent in the following order; head, current date, tail and
+--- content. the status codes 1xx, 204 and 304 are not supported since their
+--- responses cannot have a content.
+--- @param code integer
+--- @return net.http.template.canned canned
+local function canned(code)
+    local res = CANNED[code]
+    if res then
+        return res
+    elseif not code2name(code) then
+        fatalf(2, 'unsupported status code %q', code)
+    elseif code < 200 or code == 204 or code == 304 then
+        fatalf(2, 'status code %d cannot have a content', code)
+    end
+
+    local msg = code2message(code)
+    res = {
+        head = toline(code, 1.1) .. 'Date: ',
+        tail = format(concat({
+            '',
+            'Content-Type: text/plain',
+            'Content-Length: %d',
+            'Connection: close',
+            '',
+            '',
+        }, '\r\n'), #msg),
+        content = msg,
+    }
+    CANNED[code] = res
+    return res
+end
+
+return {
+    new = Template,
+    canned = canned,
+}
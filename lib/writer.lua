@@ -19,17 +19,30 @@
 -- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 -- THE SOFTWARE.
 --
+local type = type
+local select = select
+local pread = require('io.pread')
 local new_writer = require('bufio.writer').new
+local metrics = require('net.http.metrics')
+--- constants
+local PREAD_SIZE = 1024 * 64
+-- the data strings smaller than this in total are written to the buffer
+-- instead of the vectored write
+local WRITEV_MINSIZE = 1024 * 4
 
 --- @class net.http.writer
+--- @field private sock net.Socket
 --- @field private writer bufio.writer
+--- @field private unbuffered boolean
 local Writer = {}
 
 --- init
 --- @param sock net.Socket
 --- @return net.http.writer writer
 function Writer:init(sock)
+    self.sock = sock
     self.writer = new_writer(sock)
+    self.unbuffered = false
     return self
 end
 
@@ -37,6 +50,7 @@ end
 --- @param size integer
 function Writer:setbufsize(size)
     self.writer:setbufsize(size)
+    self.unbuffered = size == 0
 end
 
 --- flush a buffered data to the connection.
@@ -46,11 +60,15 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Writer:flush()
+    local rec = metrics.recorder
+    local t = rec and metrics.now()
     local n, err, timeout = self.writer:flush()
     if err then
         return nil, err
     elseif timeout then
         return nil, nil, true
+    elseif rec then
+        rec:elapsed('flush', t)
     end
     return n
 end
@@ -69,6 +87,10 @@ function Writer:write(data)
     elseif timeout then
         return nil, nil, true
     end
+    local rec = metrics.recorder
+    if rec then
+        rec:incr('bytes_out', n)
+    end
     return n
 end
 
@@ -86,10 +108,197 @@ function Writer:writeout(data)
     elseif timeout then
         return nil, nil, true
     end
+    local rec = metrics.recorder
+    if rec then
+        rec:incr('bytes_out', n)
+    end
+    return n
+end
+
+--- writev writes the data strings to the connection with a single vectored
+--- write if the connection has a writev() method, so the data strings are not
+--- joined into a new string. the buffered data is flushed before that.
+--- otherwise, or if the data strings are small enough to be copied, they are
+--- written to the buffer in order.
+--- if the error occurs, then returns nil and err. if the timeout occurs in the
+--- vectored write, then returns the number of bytes already written and true,
+--- so the caller must not write the same bytes again. if the timeout occurs
+--- while writing to the buffer, then returns nil, nil and true.
+--- otherwise, returns the number of bytes written.
+--- @param ... string
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Writer:writev(...)
+    local sock = self.sock
+    local narg = select('#', ...)
+    local buffered = type(sock.writev) ~= 'function'
+    if not buffered and not self.unbuffered then
+        local size = 0
+        for i = 1, narg do
+            size = size + #(select(i, ...))
+        end
+        buffered = size < WRITEV_MINSIZE
+    end
+
+    if buffered then
+        local len = 0
+        for i = 1, narg do
+            local n, err, timeout = self:write((select(i, ...)))
+            if not n then
+                return nil, err, timeout
+            end
+            len = len + n
+        end
+        return len
+    end
+
+    local _, err, timeout = self:flush()
+    if err then
+        return nil, err
+    elseif timeout then
+        return 0, nil, true
+    end
+
+    local rec = metrics.recorder
+    local t = rec and metrics.now()
+    local n
+    n, err, timeout = sock:writev(...)
+    if err then
+        return nil, err
+    elseif timeout then
+        -- n is the number of bytes written before the timeout
+        n = n or 0
+        if rec then
+            rec:incr('bytes_out', n)
+        end
+        return n, nil, true
+    elseif rec then
+        rec:elapsed('writev', t)
+        rec:incr('bytes_out', n)
+    end
     return n
 end
 
+--- preadfile reads the file with pread and writes it to the writer w.
+--- if the end of the file is reached before the len bytes are written, then
+--- returns the number of bytes written.
+--- if the timeout occurs, then returns the number of bytes written before the
+--- timeout and true.
+--- @param w net.http.writer
+--- @param file file*
+--- @param len integer
+--- @param offset integer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+local function preadfile(w, file, len, offset)
+    local nsent = 0
+    while nsent < len do
+        local size = len - nsent
+        if size > PREAD_SIZE then
+            size = PREAD_SIZE
+        end
+
+        local s, err = pread(file, size, offset + nsent)
+        if err then
+            return nil, err
+        elseif not s or #s == 0 then
+            -- reached the end of the file
+            break
+        end
+
+        local n, timeout
+        n, err, timeout = w:write(s)
+        if err then
+            return nil, err
+        elseif not n or timeout then
+            return nsent + (n or 0), nil, true
+        end
+        nsent = nsent + #s
+    end
+    return nsent
+end
+
+--- sendfile writes the len bytes of the file from the offset to the
+--- connection. if the connection has a sendfile() method, the buffered data is
+--- flushed and the file is sent by the kernel without copying it to the
+--- user-space. otherwise, the file is read with pread and written to the
+--- buffer.
+--- if the error occurs, then returns nil and err. if the timeout occurs, then
+--- returns the number of bytes already sent and true, so the caller can
+--- resume from offset + n instead of sending the same bytes again.
+--- otherwise, returns the number of bytes written.
+--- @param file file*
+--- @param len integer
+--- @param offset integer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+function Writer:sendfile(file, len, offset)
+    local sock = self.sock
+    if type(sock.sendfile) ~= 'function' then
+        return preadfile(self, file, len, offset)
+    end
+
+    local _, err, timeout = self:flush()
+    if err then
+        return nil, err
+    elseif timeout then
+        return 0, nil, true
+    end
+
+    local rec = metrics.recorder
+    local t = rec and metrics.now()
+    local nsent = 0
+    while nsent < len do
+        local n
+        n, err, timeout = sock:sendfile(file, len - nsent, offset + nsent)
+        if err then
+            return nil, err
+        elseif timeout then
+            -- n is the number of bytes sent before the timeout
+            nsent = nsent + (n or 0)
+            if rec then
+                rec:incr('bytes_out', nsent)
+            end
+            return nsent, nil, true
+        elseif not n then
+            return nil
+        elseif n == 0 then
+            -- reached the end of the file
+            break
+        end
+        nsent = nsent + n
+    end
+    if rec then
+        rec:elapsed('sendfile', t)
+        rec:incr('bytes_out', nsent)
+    end
+    return nsent
+end
+
+--- sendfile writes the len bytes of the file from the offset to the writer w.
+--- if w does not have a sendfile() method, the file is read with pread and
+--- written to w.
+--- if the timeout occurs, then returns the number of bytes already sent and
+--- true.
+--- @param w net.http.writer
+--- @param file file*
+--- @param len integer
+--- @param offset integer
+--- @return integer? n
+--- @return any err
+--- @return boolean? timeout
+local function sendfile(w, file, len, offset)
+    if type(w.sendfile) == 'function' then
+        return w:sendfile(file, len, offset)
+    end
+    return preadfile(w, file, len, offset)
+end
+
 return {
     new = require('metamodule').new(Writer),
+    sendfile = sendfile,
 }
 
@@ -0,0 +1,133 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/alloc.c
+ *  lua-net-http
+ */
+
+
+#include <stddef.h>
+// lua
+#include <lauxhlib.h>
+
+/**
+ * the counting allocator forwards the requests to the original allocator of
+ * the state, and counts the allocations. it is intended to measure the
+ * allocations of the code in the tests and benchmarks, so the counters are
+ * shared by the process.
+ */
+typedef struct {
+    lua_Alloc allocf;
+    void *ud;
+    lua_Integer nalloc;
+    lua_Integer nbytes;
+} alloc_counter_t;
+
+static alloc_counter_t COUNTER = {0};
+
+static void *counting_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    alloc_counter_t *c = (alloc_counter_t *)ud;
+
+    if (nsize) {
+        if (ptr == NULL) {
+            // osize is the type of the object if ptr is NULL
+            c->nalloc++;
+            c->nbytes += (lua_Integer)nsize;
+        } else if (nsize > osize) {
+            c->nalloc++;
+            c->nbytes += (lua_Integer)(nsize - osize);
+        }
+    }
+    return c->allocf(c->ud, ptr, osize, nsize);
+}
+
+/**
+ * start installs the counting allocator. it returns false if the counting
+ * allocator has already been installed.
+ */
+static int start_lua(lua_State *L)
+{
+    void *ud         = NULL;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+
+    if (allocf == counting_alloc) {
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+    COUNTER.allocf = allocf;
+    COUNTER.ud     = ud;
+    lua_setallocf(L, counting_alloc, &COUNTER);
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * stop restores the original allocator. the memory blocks allocated by the
+ * counting allocator are freed by the original allocator after that.
+ */
+static int stop_lua(lua_State *L)
+{
+    if (lua_getallocf(L, NULL) != counting_alloc) {
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+    lua_setallocf(L, COUNTER.allocf, COUNTER.ud);
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * count returns the number of allocations and the number of bytes allocated
+ * since the last reset. the growth of the reallocated blocks is counted as an
+ * allocation.
+ */
+static int count_lua(lua_State *L)
+{
+    lua_pushinteger(L, COUNTER.nalloc);
+    lua_pushinteger(L, COUNTER.nbytes);
+    return 2;
+}
+
+static int reset_lua(lua_State *L)
+{
+    (void)L;
+    COUNTER.nalloc = 0;
+    COUNTER.nbytes = 0;
+    return 0;
+}
+
+LUALIB_API int luaopen_net_http_alloc(lua_State *L)
+{
+    struct luaL_Reg funcs[] = {
+        {"start", start_lua},
+        {"stop",  stop_lua },
+        {"count", count_lua},
+        {"reset", reset_lua},
+        {NULL,    NULL     }
+    };
+
+    lua_createtable(L, 0, 4);
+    for (struct luaL_Reg *ptr = funcs; ptr->name; ptr++) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+    }
+    return 1;
+}
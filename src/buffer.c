@@ -0,0 +1,236 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/buffer.c
+ *  lua-net-http
+ */
+
+#include "buffer.h"
+// lua
+#include <lauxhlib.h>
+
+// the memory larger than this size will be released on reset
+#define BUFFER_SIZE_KEEP 65536
+
+static inline buffer_t *checkbuffer(lua_State *L)
+{
+    return luaL_checkudata(L, 1, BUFFER_MT);
+}
+
+/**
+ * checkrange checks the optional size and offset arguments, and returns the
+ * number of bytes in the range.
+ */
+static size_t checkrange(lua_State *L, buffer_t *b, size_t *offset)
+{
+    size_t len  = buffer_len(b);
+    size_t size = (size_t)lauxh_optuint64(L, 2, len);
+
+    *offset = (size_t)lauxh_optuint64(L, 3, 0);
+    if (*offset >= len) {
+        return 0;
+    } else if (size > len - *offset) {
+        return len - *offset;
+    }
+    return size;
+}
+
+static int peek_lua(lua_State *L)
+{
+    buffer_t *b   = checkbuffer(L);
+    size_t offset = 0;
+    size_t size   = checkrange(L, b, &offset);
+
+    if (!size) {
+        lua_pushnil(L);
+    } else {
+        lua_pushlstring(L, (const char *)buffer_ptr(b) + offset, size);
+    }
+    return 1;
+}
+
+static int read_lua(lua_State *L)
+{
+    buffer_t *b   = checkbuffer(L);
+    size_t offset = 0;
+    size_t size   = 0;
+
+    lua_settop(L, 2);
+    size = checkrange(L, b, &offset);
+    if (!size) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushlstring(L, (const char *)buffer_ptr(b), size);
+    buffer_consume(b, size);
+    return 1;
+}
+
+static int consume_lua(lua_State *L)
+{
+    buffer_t *b = checkbuffer(L);
+    size_t n    = (size_t)lauxh_checkuint64(L, 2);
+
+    lua_pushinteger(L, buffer_consume(b, n));
+    return 1;
+}
+
+static int find_lua(lua_State *L)
+{
+    buffer_t *b              = checkbuffer(L);
+    size_t slen              = 0;
+    const char *s            = lauxh_checklstring(L, 2, &slen);
+    size_t init              = (size_t)lauxh_optuint64(L, 3, 1);
+    const unsigned char *str = buffer_ptr(b);
+    size_t len               = buffer_len(b);
+    size_t pos               = (init > 1) ? init - 1 : 0;
+
+    if (!slen) {
+        if (pos > len) {
+            lua_pushnil(L);
+            return 1;
+        }
+        lua_pushinteger(L, pos + 1);
+        lua_pushinteger(L, pos);
+        return 2;
+    }
+
+    while (pos + slen <= len) {
+        const unsigned char *p = memchr(str + pos, *s, len - pos - slen + 1);
+        if (!p) {
+            break;
+        }
+        pos = (uintptr_t)p - (uintptr_t)str;
+        if (memcmp(p, s, slen) == 0) {
+            lua_pushinteger(L, pos + 1);
+            lua_pushinteger(L, pos + slen);
+            return 2;
+        }
+        pos++;
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
+
+static int write_lua(lua_State *L)
+{
+    buffer_t *b     = checkbuffer(L);
+    size_t len      = 0;
+    const char *str = lauxh_checklstring(L, 2, &len);
+
+    if (buffer_write(b, str, len) != 0) {
+        return luaL_error(L, "failed to allocate the buffer");
+    }
+    lua_pushinteger(L, buffer_len(b));
+    return 1;
+}
+
+static int prepend_lua(lua_State *L)
+{
+    buffer_t *b     = checkbuffer(L);
+    size_t len      = 0;
+    const char *str = lauxh_checklstring(L, 2, &len);
+
+    if (buffer_prepend(b, str, len) != 0) {
+        return luaL_error(L, "failed to allocate the buffer");
+    }
+    lua_pushinteger(L, buffer_len(b));
+    return 1;
+}
+
+static int reset_lua(lua_State *L)
+{
+    buffer_clear(checkbuffer(L), BUFFER_SIZE_KEEP);
+    return 0;
+}
+
+static int size_lua(lua_State *L)
+{
+    lua_pushinteger(L, buffer_len(checkbuffer(L)));
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, BUFFER_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    buffer_clear(lua_touserdata(L, 1), 0);
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    size_t size = (size_t)lauxh_optuint64(L, 1, 0);
+    buffer_t *b = lua_newuserdata(L, sizeof(buffer_t));
+
+    *b = (buffer_t){0};
+    if (size && buffer_reserve(b, size) != 0) {
+        return luaL_error(L, "failed to allocate the buffer");
+    }
+    lauxh_setmetatable(L, BUFFER_MT);
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_buffer(lua_State *L)
+{
+    struct luaL_Reg mmethods[] = {
+        {"__gc",       gc_lua      },
+        {"__len",      size_lua    },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg methods[] = {
+        {"size",    size_lua   },
+        {"reset",   reset_lua  },
+        {"write",   write_lua  },
+        {"prepend", prepend_lua},
+        {"find",    find_lua   },
+        {"consume", consume_lua},
+        {"read",    read_lua   },
+        {"peek",    peek_lua   },
+        {NULL,      NULL       }
+    };
+    struct luaL_Reg *ptr = mmethods;
+
+    luaL_newmetatable(L, BUFFER_MT);
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_pushliteral(L, "__index");
+    lua_newtable(L);
+    ptr = methods;
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 1);
+    lauxh_pushfn2tbl(L, "new", new_lua);
+    return 1;
+}
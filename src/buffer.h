@@ -0,0 +1,173 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/buffer.h
+ *  lua-net-http
+ */
+
+#ifndef lua_net_http_buffer_h
+#define lua_net_http_buffer_h
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_MT "net.http.buffer"
+
+// initial capacity of the buffer
+#define BUFFER_MINSIZE 1024
+
+/**
+ * buffer_t keeps the received bytes in a contiguous memory, so the parser can
+ * scan the unread bytes in place. the unread bytes are always followed by a
+ * null-terminator.
+ */
+typedef struct {
+    unsigned char *mem;
+    size_t cap;
+    // position of the unread bytes
+    size_t head;
+    // end of the unread bytes
+    size_t tail;
+} buffer_t;
+
+static inline size_t buffer_len(buffer_t *b)
+{
+    return b->tail - b->head;
+}
+
+static inline unsigned char *buffer_ptr(buffer_t *b)
+{
+    if (b->mem) {
+        return b->mem + b->head;
+    }
+    return (unsigned char *)"";
+}
+
+/**
+ * buffer_reserve makes room for n bytes after the unread bytes.
+ * the unread bytes are moved to the top of the memory if the consumed space
+ * is large enough, otherwise the memory is extended.
+ */
+static inline int buffer_reserve(buffer_t *b, size_t n)
+{
+    size_t len = b->tail - b->head;
+    size_t cap = b->cap;
+
+    if (b->tail + n < cap) {
+        return 0;
+    } else if (b->head) {
+        // move the unread bytes with a null-terminator to the top
+        memmove(b->mem, b->mem + b->head, len + 1);
+        b->head = 0;
+        b->tail = len;
+        if (len + n < cap) {
+            return 0;
+        }
+    }
+
+    if (!cap) {
+        cap = BUFFER_MINSIZE;
+    }
+    while (cap <= len + n) {
+        cap <<= 1;
+    }
+    if (cap != b->cap) {
+        unsigned char *mem = realloc(b->mem, cap);
+        if (!mem) {
+            return -1;
+        }
+        mem[b->tail] = 0;
+        b->mem       = mem;
+        b->cap       = cap;
+    }
+    return 0;
+}
+
+static inline int buffer_write(buffer_t *b, const void *data, size_t n)
+{
+    if (buffer_reserve(b, n) != 0) {
+        return -1;
+    } else if (n) {
+        memcpy(b->mem + b->tail, data, n);
+        b->tail += n;
+        b->mem[b->tail] = 0;
+    }
+    return 0;
+}
+
+static inline int buffer_prepend(buffer_t *b, const void *data, size_t n)
+{
+    if (!n) {
+        return 0;
+    } else if (n > b->head) {
+        size_t len = 0;
+
+        if (buffer_reserve(b, n) != 0) {
+            return -1;
+        }
+        // shift the unread bytes with a null-terminator
+        len = b->tail - b->head;
+        memmove(b->mem + b->head + n, b->mem + b->head, len + 1);
+        b->tail += n;
+        b->head += n;
+    }
+    b->head -= n;
+    memcpy(b->mem + b->head, data, n);
+    return 0;
+}
+
+/**
+ * buffer_consume advances the position of the unread bytes, and returns the
+ * number of bytes consumed.
+ */
+static inline size_t buffer_consume(buffer_t *b, size_t n)
+{
+    size_t len = b->tail - b->head;
+
+    if (n < len) {
+        b->head += n;
+        return n;
+    }
+    // rewind to the top of the memory
+    b->head = b->tail = 0;
+    if (b->mem) {
+        *b->mem = 0;
+    }
+    return len;
+}
+
+/**
+ * buffer_clear discards the unread bytes, and releases the memory if its
+ * capacity is greater than the keep size.
+ */
+static inline void buffer_clear(buffer_t *b, size_t keep)
+{
+    if (b->cap > keep) {
+        free(b->mem);
+        b->mem = NULL;
+        b->cap = 0;
+    } else if (b->mem) {
+        *b->mem = 0;
+    }
+    b->head = b->tail = 0;
+}
+
+#endif
@@ -0,0 +1,306 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/date.c
+ *  lua-net-http
+ */
+
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+// lua
+#include <lauxhlib.h>
+
+/**
+ *  IMF-fixdate  = day-name "," SP date1 SP time-of-day SP GMT
+ *  ; fixed length/zone/capitalization subset of the format
+ *  ; see Section 3.3 of [RFC5322]
+ *
+ *  e.g. Sun, 06 Nov 1994 08:49:37 GMT
+ */
+#define IMF_FIXDATE_LEN 29
+
+static const char DAY_NAMES[7][4] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+};
+static const char MONTH_NAMES[12][4] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+// the second of the cached date string
+static time_t CURRENT_SEC = -1;
+static char CURRENT_DATE[IMF_FIXDATE_LEN + 1];
+
+static inline void put2digit(char *p, int v)
+{
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+}
+
+static void format_date(char *buf, time_t sec)
+{
+    struct tm tm = {0};
+
+    gmtime_r(&sec, &tm);
+    memcpy(buf, DAY_NAMES[tm.tm_wday], 3);
+    buf[3] = ',';
+    buf[4] = ' ';
+    put2digit(buf + 5, tm.tm_mday);
+    buf[7] = ' ';
+    memcpy(buf + 8, MONTH_NAMES[tm.tm_mon], 3);
+    buf[11] = ' ';
+    put2digit(buf + 12, (tm.tm_year + 1900) / 100);
+    put2digit(buf + 14, (tm.tm_year + 1900) % 100);
+    buf[16] = ' ';
+    put2digit(buf + 17, tm.tm_hour);
+    buf[19] = ':';
+    put2digit(buf + 20, tm.tm_min);
+    buf[22] = ':';
+    put2digit(buf + 23, tm.tm_sec);
+    memcpy(buf + 25, " GMT", 4);
+}
+
+static inline time_t coarse_time(void)
+{
+#if defined(CLOCK_REALTIME_COARSE)
+    struct timespec ts = {0};
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0) {
+        return ts.tv_sec;
+    }
+#endif
+    return time(NULL);
+}
+
+static inline void update_date(time_t sec)
+{
+    format_date(CURRENT_DATE, sec);
+    CURRENT_SEC = sec;
+}
+
+static int update_lua(lua_State *L)
+{
+    update_date(time(NULL));
+    lua_pushlstring(L, CURRENT_DATE, IMF_FIXDATE_LEN);
+    return 1;
+}
+
+/**
+ * now returns the cached date string. the cache is refreshed at most once per
+ * second by checking the coarse clock.
+ */
+static int now_lua(lua_State *L)
+{
+    time_t sec = coarse_time();
+
+    if (sec != CURRENT_SEC) {
+        update_date(sec);
+    }
+    lua_pushlstring(L, CURRENT_DATE, IMF_FIXDATE_LEN);
+    return 1;
+}
+
+static int format_lua(lua_State *L)
+{
+    char buf[IMF_FIXDATE_LEN] = {0};
+
+    format_date(buf, (time_t)lauxh_checkinteger(L, 1));
+    lua_pushlstring(L, buf, IMF_FIXDATE_LEN);
+    return 1;
+}
+
+/**
+ * days_from_civil returns the number of days since 1970-01-01.
+ * the month is 1-based.
+ */
+static int64_t days_from_civil(int64_t y, int m, int d)
+{
+    int64_t era = 0;
+    int64_t yoe = 0;
+    int64_t doy = 0;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+static int parse_digits(const unsigned char **str, int n, int *v)
+{
+    const unsigned char *p = *str;
+
+    *v = 0;
+    for (int i = 0; i < n; i++) {
+        if (!isdigit(p[i])) {
+            return -1;
+        }
+        *v = *v * 10 + (p[i] - '0');
+    }
+    *str = p + n;
+    return 0;
+}
+
+static int parse_month(const unsigned char **str, int *mon)
+{
+    for (int i = 0; i < 12; i++) {
+        if (memcmp(*str, MONTH_NAMES[i], 3) == 0) {
+            *mon = i + 1;
+            *str += 3;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_char(const unsigned char **str, unsigned char c)
+{
+    if (**str != c) {
+        return -1;
+    }
+    *str += 1;
+    return 0;
+}
+
+// time-of-day = hour ":" minute ":" second
+static int parse_time(const unsigned char **str, int *h, int *m, int *s)
+{
+    if (parse_digits(str, 2, h) || parse_char(str, ':') ||
+        parse_digits(str, 2, m) || parse_char(str, ':') ||
+        parse_digits(str, 2, s) || *h > 23 || *m > 59 || *s > 60) {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_gmt(const unsigned char **str)
+{
+    if (memcmp(*str, " GMT", 4) != 0) {
+        return -1;
+    }
+    *str += 4;
+    return 0;
+}
+
+/**
+ * parse parses the HTTP-date and returns the seconds since the epoch.
+ *
+ *  HTTP-date    = IMF-fixdate / obs-date
+ *  obs-date     = rfc850-date / asctime-date
+ *
+ *  IMF-fixdate  = day-name "," SP date1 SP time-of-day SP GMT
+ *                 ; e.g. Sun, 06 Nov 1994 08:49:37 GMT
+ *  rfc850-date  = day-name-l "," SP date2 SP time-of-day SP GMT
+ *                 ; e.g. Sunday, 06-Nov-94 08:49:37 GMT
+ *  asctime-date = day-name SP date3 SP time-of-day SP year
+ *                 ; e.g. Sun Nov  6 08:49:37 1994
+ */
+static int parse_lua(lua_State *L)
+{
+    size_t len               = 0;
+    const unsigned char *str = (const unsigned char *)lauxh_checklstring(L, 1,
+                                                                         &len);
+    const unsigned char *end = str + len;
+    const unsigned char *p   = NULL;
+    int year                 = 0;
+    int mon                  = 0;
+    int day                  = 0;
+    int h                    = 0;
+    int m                    = 0;
+    int s                    = 0;
+
+    // the shortest format is asctime-date
+    if (len < 24) {
+        goto INVALID;
+    }
+
+    p = memchr(str, ',', len);
+    if (!p) {
+        // asctime-date = day-name SP month SP ( 2DIGIT / ( SP DIGIT ) ) SP
+        //                time-of-day SP year
+        p = str + 3;
+        if (len != 24 || parse_char(&p, ' ') || parse_month(&p, &mon) ||
+            parse_char(&p, ' ')) {
+            goto INVALID;
+        } else if (*p == ' ') {
+            p++;
+            if (parse_digits(&p, 1, &day)) {
+                goto INVALID;
+            }
+        } else if (parse_digits(&p, 2, &day)) {
+            goto INVALID;
+        }
+        if (parse_char(&p, ' ') || parse_time(&p, &h, &m, &s) ||
+            parse_char(&p, ' ') || parse_digits(&p, 4, &year)) {
+            goto INVALID;
+        }
+    } else if (p - str == 3) {
+        // IMF-fixdate = day-name "," SP 2DIGIT SP month SP 4DIGIT SP
+        //               time-of-day SP GMT
+        p++;
+        if (len != IMF_FIXDATE_LEN || parse_char(&p, ' ') ||
+            parse_digits(&p, 2, &day) || parse_char(&p, ' ') ||
+            parse_month(&p, &mon) || parse_char(&p, ' ') ||
+            parse_digits(&p, 4, &year) || parse_char(&p, ' ') ||
+            parse_time(&p, &h, &m, &s) || parse_gmt(&p)) {
+            goto INVALID;
+        }
+    } else {
+        // rfc850-date = day-name-l "," SP 2DIGIT "-" month "-" 2DIGIT SP
+        //               time-of-day SP GMT
+        p++;
+        if (end - p != 23 || parse_char(&p, ' ') ||
+            parse_digits(&p, 2, &day) || parse_char(&p, '-') ||
+            parse_month(&p, &mon) || parse_char(&p, '-') ||
+            parse_digits(&p, 2, &year) || parse_char(&p, ' ') ||
+            parse_time(&p, &h, &m, &s) || parse_gmt(&p)) {
+            goto INVALID;
+        }
+        // a two-digit year more than 50 years in the future is interpreted
+        // as the most recent year in the past that had the same last two
+        // digits. approximate it with a fixed pivot.
+        year += (year < 70) ? 2000 : 1900;
+    }
+
+    if (p != end || day < 1 || day > 31) {
+        goto INVALID;
+    }
+    lua_pushinteger(L, (lua_Integer)(days_from_civil(year, mon, day) * 86400 +
+                                     h * 3600 + m * 60 + s));
+    return 1;
+
+INVALID:
+    lua_pushnil(L);
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_date(lua_State *L)
+{
+    update_date(time(NULL));
+    lua_createtable(L, 0, 4);
+    lauxh_pushfn2tbl(L, "now", now_lua);
+    lauxh_pushfn2tbl(L, "update", update_lua);
+    lauxh_pushfn2tbl(L, "format", format_lua);
+    lauxh_pushfn2tbl(L, "parse", parse_lua);
+    return 1;
+}
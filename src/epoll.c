@@ -0,0 +1,196 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/epoll.c
+ *  lua-net-http
+ */
+
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+// lua
+#include <lauxhlib.h>
+
+#define EPOLL_MT            "net.http.epoll"
+#define EPOLL_DEFAULT_NEVTS 1024
+
+typedef struct {
+    int fd;
+    int nevt;
+    struct epoll_event *evs;
+} epoll_t;
+
+static inline epoll_t *checkepoll(lua_State *L)
+{
+    epoll_t *ep = luaL_checkudata(L, 1, EPOLL_MT);
+    if (ep->fd == -1) {
+        luaL_error(L, "attempt to use a closed epoll");
+    }
+    return ep;
+}
+
+static int push_errno(lua_State *L, const char *op)
+{
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s: %s", op, strerror(errno));
+    return 2;
+}
+
+/**
+ * watch waits for the fd to become readable, or writable if the third
+ * argument is true. the fd is watched only once, and must be watched again
+ * after it is returned by wait().
+ */
+static int watch_lua(lua_State *L)
+{
+    epoll_t *ep            = checkepoll(L);
+    int fd                 = (int)lauxh_checkinteger(L, 2);
+    int writable           = lauxh_optboolean(L, 3, 0);
+    struct epoll_event evt = {
+        .events  = (writable ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT,
+        .data.fd = fd,
+    };
+
+    // re-arm the registered fd, or register the new fd
+    if (epoll_ctl(ep->fd, EPOLL_CTL_MOD, fd, &evt) == -1 &&
+        (errno != ENOENT || epoll_ctl(ep->fd, EPOLL_CTL_ADD, fd, &evt) == -1)) {
+        return push_errno(L, "epoll_ctl");
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * unwatch removes the fd. it must be called before the fd is closed.
+ */
+static int unwatch_lua(lua_State *L)
+{
+    epoll_t *ep            = checkepoll(L);
+    int fd                 = (int)lauxh_checkinteger(L, 2);
+    struct epoll_event evt = {0};
+
+    if (epoll_ctl(ep->fd, EPOLL_CTL_DEL, fd, &evt) == -1 && errno != ENOENT) {
+        return push_errno(L, "epoll_ctl");
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * wait waits for the watched fds until the msec milliseconds elapse, and
+ * returns an array of the ready fds, that is empty on timeout or interrupt.
+ */
+static int wait_lua(lua_State *L)
+{
+    epoll_t *ep = checkepoll(L);
+    int msec    = (int)lauxh_optinteger(L, 2, -1);
+    int n       = epoll_wait(ep->fd, ep->evs, ep->nevt, msec);
+
+    if (n == -1) {
+        if (errno != EINTR) {
+            return push_errno(L, "epoll_wait");
+        }
+        n = 0;
+    }
+
+    lua_createtable(L, n, 0);
+    for (int i = 0; i < n; i++) {
+        lauxh_pushint2arr(L, i + 1, ep->evs[i].data.fd);
+    }
+    return 1;
+}
+
+static int close_lua(lua_State *L)
+{
+    epoll_t *ep = luaL_checkudata(L, 1, EPOLL_MT);
+
+    if (ep->fd != -1) {
+        close(ep->fd);
+        ep->fd = -1;
+    }
+    return 0;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, EPOLL_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int new_lua(lua_State *L)
+{
+    int nevt    = (int)lauxh_optinteger(L, 1, EPOLL_DEFAULT_NEVTS);
+    epoll_t *ep = NULL;
+
+    if (nevt <= 0) {
+        return lauxh_argerror(L, 1, "nevt must be integer greater than 0");
+    }
+    ep = lua_newuserdata(L, sizeof(epoll_t) +
+                                sizeof(struct epoll_event) * (size_t)nevt);
+    *ep = (epoll_t){
+        .fd   = epoll_create1(EPOLL_CLOEXEC),
+        .nevt = nevt,
+        .evs  = (struct epoll_event *)(ep + 1),
+    };
+    if (ep->fd == -1) {
+        return push_errno(L, "epoll_create1");
+    }
+    lauxh_setmetatable(L, EPOLL_MT);
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_epoll(lua_State *L)
+{
+    struct luaL_Reg mmethods[] = {
+        {"__gc",       close_lua   },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg methods[] = {
+        {"watch",   watch_lua  },
+        {"unwatch", unwatch_lua},
+        {"wait",    wait_lua   },
+        {"close",   close_lua  },
+        {NULL,      NULL       }
+    };
+    struct luaL_Reg *ptr = mmethods;
+
+    luaL_newmetatable(L, EPOLL_MT);
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_pushliteral(L, "__index");
+    lua_newtable(L);
+    ptr = methods;
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 1);
+    lauxh_pushfn2tbl(L, "new", new_lua);
+    return 1;
+}
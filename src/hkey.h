@@ -0,0 +1,209 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/hkey.h
+ *  lua-net-http
+ */
+
+#ifndef lua_net_http_hkey_h
+#define lua_net_http_hkey_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * hkey_t holds the well-known header field-name in lowercase and in the
+ * canonical-case, and the references to the pre-created Lua strings of them.
+ */
+typedef struct {
+    const char *name;
+    const char *canon;
+    size_t len;
+    int lref;
+    int cref;
+} hkey_t;
+
+/**
+ * the field-names are placed by the hash-and-displace perfect hash.
+ * the fnv-1a hash of the lowercase name selects one of the HKEY_NBUCKET
+ * displacements, and the hash mixed with the displacement selects the slot.
+ * the displacements must be regenerated when the names are changed.
+ */
+#define HKEY_NBUCKET 32
+#define HKEY_NSLOT   256
+
+static const uint8_t HKEY_DISP[HKEY_NBUCKET] = {
+    1, 0, 5, 4, 0, 2, 1, 3, 0, 1, 4, 13, 1, 2, 2, 0,
+    0, 6, 8, 2, 3, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2, 2,
+};
+
+static hkey_t HKEYS[HKEY_NSLOT] = {
+    [0] = {"forwarded", "Forwarded", 9},
+    [3] = {"connection", "Connection", 10},
+    [6] = {"accept-ch", "Accept-CH", 9},
+    [12] = {"referrer-policy", "Referrer-Policy", 15},
+    [13] = {"sec-ch-ua", "Sec-CH-UA", 9},
+    [17] = {"sec-fetch-user", "Sec-Fetch-User", 14},
+    [18] = {"proxy-connection", "Proxy-Connection", 16},
+    [21] = {"access-control-allow-methods", "Access-Control-Allow-Methods", 28},
+    [23] = {"transfer-encoding", "Transfer-Encoding", 17},
+    [24] = {"host", "Host", 4},
+    [27] = {"cross-origin-resource-policy", "Cross-Origin-Resource-Policy", 28},
+    [32] = {"access-control-allow-credentials",
+            "Access-Control-Allow-Credentials", 32},
+    [34] = {"proxy-authorization", "Proxy-Authorization", 19},
+    [35] = {"if-range", "If-Range", 8},
+    [37] = {"content-security-policy-report-only",
+            "Content-Security-Policy-Report-Only", 35},
+    [41] = {"proxy-authenticate", "Proxy-Authenticate", 18},
+    [42] = {"max-forwards", "Max-Forwards", 12},
+    [50] = {"via", "Via", 3},
+    [51] = {"dnt", "DNT", 3},
+    [55] = {"accept-language", "Accept-Language", 15},
+    [56] = {"if-unmodified-since", "If-Unmodified-Since", 19},
+    [60] = {"x-forwarded-for", "X-Forwarded-For", 15},
+    [63] = {"content-security-policy", "Content-Security-Policy", 23},
+    [64] = {"keep-alive", "Keep-Alive", 10},
+    [67] = {"preference-applied", "Preference-Applied", 18},
+    [71] = {"digest", "Digest", 6},
+    [75] = {"sec-ch-ua-mobile", "Sec-CH-UA-Mobile", 16},
+    [76] = {"x-powered-by", "X-Powered-By", 12},
+    [77] = {"content-language", "Content-Language", 16},
+    [78] = {"sec-websocket-version", "Sec-WebSocket-Version", 21},
+    [82] = {"access-control-allow-origin", "Access-Control-Allow-Origin", 27},
+    [83] = {"alt-svc", "Alt-Svc", 7},
+    [86] = {"cookie", "Cookie", 6},
+    [87] = {"sec-websocket-protocol", "Sec-WebSocket-Protocol", 22},
+    [90] = {"etag", "ETag", 4},
+    [93] = {"strict-transport-security", "Strict-Transport-Security", 25},
+    [94] = {"x-real-ip", "X-Real-IP", 9},
+    [95] = {"trailer", "Trailer", 7},
+    [96] = {"x-content-type-options", "X-Content-Type-Options", 22},
+    [100] = {"cross-origin-opener-policy", "Cross-Origin-Opener-Policy", 26},
+    [101] = {"pragma", "Pragma", 6},
+    [104] = {"if-none-match", "If-None-Match", 13},
+    [105] = {"access-control-allow-headers",
+             "Access-Control-Allow-Headers", 28},
+    [109] = {"x-forwarded-host", "X-Forwarded-Host", 16},
+    [110] = {"content-location", "Content-Location", 16},
+    [111] = {"upgrade-insecure-requests", "Upgrade-Insecure-Requests", 25},
+    [114] = {"date", "Date", 4},
+    [115] = {"content-range", "Content-Range", 13},
+    [116] = {"www-authenticate", "WWW-Authenticate", 16},
+    [118] = {"alt-used", "Alt-Used", 8},
+    [121] = {"accept-charset", "Accept-Charset", 14},
+    [122] = {"content-length", "Content-Length", 14},
+    [124] = {"x-requested-with", "X-Requested-With", 16},
+    [126] = {"timing-allow-origin", "Timing-Allow-Origin", 19},
+    [128] = {"accept-patch", "Accept-Patch", 12},
+    [131] = {"from", "From", 4},
+    [133] = {"clear-site-data", "Clear-Site-Data", 15},
+    [134] = {"vary", "Vary", 4},
+    [135] = {"expect", "Expect", 6},
+    [140] = {"access-control-request-headers",
+             "Access-Control-Request-Headers", 30},
+    [141] = {"age", "Age", 3},
+    [142] = {"last-event-id", "Last-Event-ID", 13},
+    [144] = {"content-md5", "Content-MD5", 11},
+    [145] = {"x-forwarded-proto", "X-Forwarded-Proto", 17},
+    [146] = {"retry-after", "Retry-After", 11},
+    [148] = {"x-request-id", "X-Request-ID", 12},
+    [149] = {"want-digest", "Want-Digest", 11},
+    [154] = {"origin", "Origin", 6},
+    [158] = {"access-control-max-age", "Access-Control-Max-Age", 22},
+    [160] = {"accept-ranges", "Accept-Ranges", 13},
+    [164] = {"upgrade", "Upgrade", 7},
+    [166] = {"last-modified", "Last-Modified", 13},
+    [167] = {"access-control-expose-headers",
+             "Access-Control-Expose-Headers", 29},
+    [169] = {"server-timing", "Server-Timing", 13},
+    [170] = {"link", "Link", 4},
+    [171] = {"accept", "Accept", 6},
+    [172] = {"te", "TE", 2},
+    [173] = {"sec-ch-ua-platform", "Sec-CH-UA-Platform", 18},
+    [175] = {"content-type", "Content-Type", 12},
+    [177] = {"allow", "Allow", 5},
+    [179] = {"x-xss-protection", "X-XSS-Protection", 16},
+    [181] = {"refresh", "Refresh", 7},
+    [182] = {"sec-websocket-accept", "Sec-WebSocket-Accept", 20},
+    [191] = {"prefer", "Prefer", 6},
+    [192] = {"accept-encoding", "Accept-Encoding", 15},
+    [194] = {"accept-post", "Accept-Post", 11},
+    [195] = {"range", "Range", 5},
+    [199] = {"set-cookie", "Set-Cookie", 10},
+    [200] = {"x-frame-options", "X-Frame-Options", 15},
+    [204] = {"sec-fetch-site", "Sec-Fetch-Site", 14},
+    [208] = {"access-control-request-method",
+             "Access-Control-Request-Method", 29},
+    [211] = {"sec-fetch-mode", "Sec-Fetch-Mode", 14},
+    [214] = {"http2-settings", "HTTP2-Settings", 14},
+    [216] = {"priority", "Priority", 8},
+    [217] = {"sec-websocket-extensions", "Sec-WebSocket-Extensions", 24},
+    [219] = {"cache-control", "Cache-Control", 13},
+    [221] = {"if-match", "If-Match", 8},
+    [224] = {"early-data", "Early-Data", 10},
+    [226] = {"content-disposition", "Content-Disposition", 19},
+    [230] = {"location", "Location", 8},
+    [232] = {"if-modified-since", "If-Modified-Since", 17},
+    [234] = {"content-encoding", "Content-Encoding", 16},
+    [236] = {"user-agent", "User-Agent", 10},
+    [237] = {"expires", "Expires", 7},
+    [242] = {"sec-websocket-key", "Sec-WebSocket-Key", 17},
+    [244] = {"sec-fetch-dest", "Sec-Fetch-Dest", 14},
+    [245] = {"warning", "Warning", 7},
+    [246] = {"server", "Server", 6},
+    [247] = {"authorization", "Authorization", 13},
+    [252] = {"cross-origin-embedder-policy",
+             "Cross-Origin-Embedder-Policy", 28},
+    [254] = {"referer", "Referer", 7},
+};
+
+static inline unsigned char hkey_lower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+/**
+ * hkey_lookup returns the well-known header field-name that matches the str
+ * case-insensitively, or NULL if not found.
+ */
+static inline hkey_t *hkey_lookup(const unsigned char *str, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    hkey_t *k     = NULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ hkey_lower(str[i])) * 16777619U;
+    }
+    hash ^= HKEY_DISP[hash % HKEY_NBUCKET];
+    k = HKEYS + ((uint32_t)(hash * 2654435761U) >> 24);
+    if (k->name == NULL || k->len != len) {
+        return NULL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (hkey_lower(str[i]) != (unsigned char)k->name[i]) {
+            return NULL;
+        }
+    }
+    return k;
+}
+
+#endif
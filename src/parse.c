@@ -24,9 +24,15 @@
  *  Created by Masatoshi Teruya on 18/06/04.
  */
 
+#include <stdlib.h>
 #include <string.h>
 // lua
 #include <lua_error.h>
+// net.http.buffer
+#include "buffer.h"
+// vectorized scanning
+#include "hkey.h"
+#include "scan.h"
 
 /**
  * return code
@@ -164,6 +170,21 @@ static int error_result_ex(lua_State *L, int err, const char *op, int as_bool)
 #define error_result_as_false(L, err, op) error_result_ex(L, err, op, 1)
 #define error_result_as_nil(L, err, op)   error_result_ex(L, err, op, 0)
 
+/**
+ * checkbytes returns the bytes of the string or the unread bytes of the
+ * net.http.buffer at the specified index. the buffer is scanned in place and
+ * its bytes are not consumed.
+ */
+static unsigned char *checkbytes(lua_State *L, int idx, size_t *len)
+{
+    if (lua_type(L, idx) == LUA_TUSERDATA) {
+        buffer_t *b = luaL_checkudata(L, idx, BUFFER_MT);
+        *len        = buffer_len(b);
+        return buffer_ptr(b);
+    }
+    return (unsigned char *)lauxh_checklstring(L, idx, len);
+}
+
 /* delimiters */
 #define CR        '\r'
 #define LF        '\n'
@@ -613,11 +634,14 @@ CHECK_EOL:
 
 #define DEFAULT_CHUNKSIZE_MAXLEN 4096
 
-static int chunksize_lua(lua_State *L)
+/**
+ * parse_chunksize parses the chunk-size line, and pushes the chunk-extensions
+ * to the table at tblidx.
+ */
+static int parse_chunksize(lua_State *L, unsigned char *str, size_t len,
+                           size_t maxlen, int tblidx, ssize_t *csize,
+                           size_t *consumed)
 {
-    size_t len         = 0;
-    unsigned char *str = (unsigned char *)lauxh_checklstring(L, 1, &len);
-    size_t maxlen   = (size_t)lauxh_optuint16(L, 3, DEFAULT_CHUNKSIZE_MAXLEN);
     ssize_t size    = 0;
     size_t cur      = 0;
     size_t head     = 0;
@@ -626,27 +650,23 @@ static int chunksize_lua(lua_State *L)
     const char *val = NULL;
     size_t vlen     = 0;
 
-    // check container table
-    luaL_checktype(L, 2, LUA_TTABLE);
-    lua_settop(L, 2);
-
     if (!len) {
-        return error_result_as_nil(L, PARSE_EAGAIN, "chunksize");
+        return PARSE_EAGAIN;
     }
 
     // parse chunk-size
     size = hex2size(str, len, &cur);
     if (size < 0) {
-        return error_result_as_nil(L, size, "chunksize");
+        return size;
     }
 
 #define skip_bws()                                                             \
     do {                                                                       \
         if (skip_ws(str, len, &cur, maxlen) != PARSE_OK) {                     \
-            return error_result_as_nil(L, PARSE_ELEN, "chunksize");            \
+            return PARSE_ELEN;                                                 \
         } else if (str[cur] == 0) {                                            \
             /* more bytes need */                                              \
-            return error_result_as_nil(L, PARSE_EAGAIN, "chunksize");          \
+            return PARSE_EAGAIN;                                               \
         }                                                                      \
     } while (0)
 
@@ -656,7 +676,7 @@ CHECK_EOL:
         switch (str[cur + 1]) {
         case 0:
             // more bytes need
-            return error_result_as_nil(L, PARSE_EAGAIN, "chunksize");
+            return PARSE_EAGAIN;
 
         case LF:
             // push extension
@@ -667,24 +687,23 @@ CHECK_EOL:
                 } else {
                     lua_pushliteral(L, "");
                 }
-                lua_rawset(L, 2);
+                lua_rawset(L, tblidx);
             }
-            // return chunksize and number of bytes consumed
-            lua_pushinteger(L, size);
-            lua_pushnil(L);
-            lua_pushinteger(L, cur + 2);
-            return 3;
+            // chunksize and number of bytes consumed
+            *csize    = size;
+            *consumed = cur + 2;
+            return PARSE_OK;
 
         default:
             // invalid end-of-line terminator
-            return error_result_as_nil(L, PARSE_EEOL, "chunksize");
+            return PARSE_EEOL;
         }
     }
 
     // parse semicolon
     skip_bws();
     if (str[cur] != SEMICOLON) {
-        return error_result_as_nil(L, PARSE_EILSEQ, "chunksize");
+        return PARSE_EILSEQ;
     }
     cur++;
 
@@ -715,7 +734,7 @@ CHECK_EXTNAME:
         } else {
             lua_pushliteral(L, "");
         }
-        lua_rawset(L, 2);
+        lua_rawset(L, tblidx);
         klen = 0;
         vlen = 0;
     }
@@ -726,7 +745,7 @@ CHECK_EXTNAME:
     }
     if (cur == head) {
         // disallow empty ext-name
-        return error_result_as_nil(L, PARSE_EEMPTY, "chunksize");
+        return PARSE_EEMPTY;
     }
     key  = (const char *)str + head;
     klen = cur - head;
@@ -749,7 +768,7 @@ CHECK_EXTNAME:
 
     default:
         // illegal byte sequence
-        return error_result_as_nil(L, PARSE_EILSEQ, "chunksize");
+        return PARSE_EILSEQ;
     }
 
     // parse ext-val
@@ -774,7 +793,7 @@ CHECK_EXTNAME:
             // PARSE_EAGAIN
             // PARSE_ELEN
             // PARSE_EILSEQ
-            return error_result_as_nil(L, rv, "chunksize");
+            return rv;
         }
     }
 
@@ -788,7 +807,7 @@ CHECK_EXTNAME:
     switch (str[cur]) {
     case 0:
         // more bytes need
-        return error_result_as_nil(L, PARSE_EAGAIN, "chunksize");
+        return PARSE_EAGAIN;
 
     case CR:
         // found tail
@@ -804,23 +823,52 @@ CHECK_EOB:
 
         default:
             // illegal byte sequence
-            return error_result_as_nil(L, PARSE_EILSEQ, "chunksize");
+            return PARSE_EILSEQ;
         }
     }
 #undef skip_bws
 }
 
+static int chunksize_lua(lua_State *L)
+{
+    size_t len         = 0;
+    unsigned char *str = checkbytes(L, 1, &len);
+    size_t maxlen = (size_t)lauxh_optuint16(L, 3, DEFAULT_CHUNKSIZE_MAXLEN);
+    ssize_t size  = 0;
+    size_t cur    = 0;
+    int rv        = 0;
+
+    // check container table
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+
+    rv = parse_chunksize(L, str, len, maxlen, 2, &size, &cur);
+    if (rv != PARSE_OK) {
+        return error_result_as_nil(L, rv, "chunksize");
+    }
+    // return chunksize and number of bytes consumed
+    lua_pushinteger(L, size);
+    lua_pushnil(L);
+    lua_pushinteger(L, cur);
+    return 3;
+}
+
 static int parse_hval(unsigned char *str, size_t len, size_t *cur,
                       size_t *maxhdrlen)
 {
+    size_t max      = (len > *maxhdrlen) ? *maxhdrlen + 1 : len;
     size_t tail     = 0;
     size_t pos      = 0;
     unsigned char c = 0;
 
     for (; pos < len; pos++) {
+        // skip the field-content bytes at once
+        pos += scan_vchar(str + pos, max - pos);
         // check length
         if (pos > *maxhdrlen) {
             return PARSE_EHDRLEN;
+        } else if (pos == len) {
+            break;
         }
 
         c = str[pos];
@@ -888,6 +936,7 @@ CHECK_AGAIN:
 #define DEFAULT_HDR_MAXLEN 4108
 #define DEFAULT_HDR_MAXNUM UINT8_MAX
 #define DEFAULT_MSG_MAXLEN 2048
+#define DEFAULT_MSG_MAXNUM 32
 
 static int header_value_lua(lua_State *L)
 {
@@ -914,61 +963,44 @@ static int header_value_lua(lua_State *L)
     }
 }
 
-static int parse_hkey(lua_State *L, int *lkey, unsigned char *str, size_t len,
-                      size_t *cur, size_t *maxhdrlen)
+static int parse_hkey(unsigned char *str, size_t len, size_t *cur,
+                      size_t *maxhdrlen)
 {
-    int top       = lua_gettop(L);
-    size_t pos    = 0;
-    luaL_Buffer b = {0};
-
-    if (lkey) {
-        luaL_buffinit(L, &b);
-    }
+    size_t max = (len > *maxhdrlen) ? *maxhdrlen + 1 : len;
+    size_t pos = 0;
 
     for (; pos < len; pos++) {
-        unsigned char c = TCHAR[str[pos]];
-
+        // skip the token bytes at once
+        pos += scan_tchar(str + pos, max - pos);
         if (pos > *maxhdrlen) {
-            lua_settop(L, top);
             return PARSE_EHDRLEN;
+        } else if (pos == len) {
+            break;
         }
 
-        switch (c) {
+        switch (TCHAR[str[pos]]) {
         // illegal byte sequence
         case 0:
-            lua_settop(L, top);
             return PARSE_EHDRNAME;
 
         // found COLON
         case 1:
             // check length
             if (pos == 0) {
-                lua_settop(L, top);
                 return PARSE_EHDRNAME;
             }
 
             *maxhdrlen = pos;
             *cur       = pos + 1;
-            if (lkey) {
-                luaL_pushresult(&b);
-                *lkey = lauxh_ref(L);
-            }
             return PARSE_OK;
-
-        default:
-            if (lkey) {
-                luaL_addchar(&b, c);
-            }
         }
     }
 
     // header-length too large
     if (len > *maxhdrlen) {
-        lua_settop(L, top);
         return PARSE_EHDRLEN;
     }
 
-    lua_settop(L, top);
     return PARSE_EAGAIN;
 }
 
@@ -978,7 +1010,7 @@ static int header_name_lua(lua_State *L)
     const char *str = lauxh_checklstring(L, 1, &len);
     size_t maxlen   = (size_t)lauxh_optuint16(L, 2, DEFAULT_HDR_MAXLEN);
     size_t cur      = 0;
-    int rv = parse_hkey(L, NULL, (unsigned char *)str, len, &cur, &maxlen);
+    int rv          = parse_hkey((unsigned char *)str, len, &cur, &maxlen);
 
     switch (rv) {
     case PARSE_EAGAIN:
@@ -993,22 +1025,159 @@ static int header_name_lua(lua_State *L)
     }
 }
 
+/**
+ * header_t holds the position of the field-name and field-value relative to
+ * the head of the message.
+ */
 typedef struct {
-    int lkey;
-    char *key;
-    char *val;
+    size_t key;
     size_t klen;
+    size_t val;
     size_t vlen;
 } header_t;
 
-static int parse_header(lua_State *L, unsigned char *str, size_t len,
-                        size_t *cur, uint16_t maxhdrlen, uint8_t maxhdrnum)
+static int parse_hline(unsigned char *str, size_t len, size_t *cur,
+                       uint16_t maxhdrlen, header_t *h)
+{
+    size_t pos = 0;
+    size_t eol = 0;
+    int rv     = 0;
+
+    h->key  = 0;
+    h->klen = maxhdrlen;
+    rv      = parse_hkey(str, len, &pos, &h->klen);
+    if (rv != PARSE_OK) {
+        return rv;
+    }
+    // skip OWS
+    while (str[pos] == SP || str[pos] == HT) {
+        pos++;
+    }
+    if (pos > maxhdrlen) {
+        return PARSE_EHDRLEN;
+    }
+
+    h->val  = pos;
+    h->vlen = maxhdrlen - pos;
+    rv      = parse_hval(str + pos, len - pos, &eol, &h->vlen);
+    if (rv != PARSE_OK) {
+        return rv;
+    }
+    *cur = pos + eol;
+    return PARSE_OK;
+}
+
+static void push_lower_hkey(lua_State *L, const char *key, size_t klen)
+{
+    luaL_Buffer b;
+
+    luaL_buffinit(L, &b);
+    for (size_t i = 0; i < klen; i++) {
+        luaL_addchar(&b, TCHAR[(unsigned char)key[i]]);
+    }
+    luaL_pushresult(&b);
+}
+
+/**
+ * push_hkey pushes the lowercase field-name. the pre-created string is pushed
+ * if the field-name is well-known.
+ */
+static inline hkey_t *push_hkey(lua_State *L, const char *key, size_t klen)
+{
+    hkey_t *k = hkey_lookup((const unsigned char *)key, klen);
+
+    if (k) {
+        lauxh_pushref(L, k->lref);
+    } else {
+        push_lower_hkey(L, key, klen);
+    }
+    return k;
+}
+
+static void push_headers(lua_State *L, int tblidx, const char *base,
+                         header_t *hdridx, uint8_t nhdr)
+{
+    for (uint8_t i = 0; i < nhdr; i++) {
+        header_t *h = hdridx + i;
+        hkey_t *k   = NULL;
+
+        // check existing kv table of key
+        k = push_hkey(L, base + h->key, h->klen);
+        lua_pushvalue(L, -1);
+        lua_rawget(L, tblidx);
+        if (lua_type(L, -1) == LUA_TTABLE) {
+            // get kv->val table
+            lua_pushliteral(L, "val");
+            lua_rawget(L, -2);
+            // append to tail
+            lauxh_pushlstr2arr(L, lauxh_rawlen(L, -1) + 1, base + h->val,
+                               h->vlen);
+            lua_pop(L, 3);
+        } else {
+            int idx = lauxh_rawlen(L, tblidx) + 1;
+            lua_pop(L, 1);
+            // create kv table
+            lua_createtable(L, 0, 3);
+            lauxh_pushint2tbl(L, "idx", idx);
+            lua_pushliteral(L, "key");
+            if (k && memcmp(k->canon, base + h->key, h->klen) == 0) {
+                lauxh_pushref(L, k->cref);
+            } else {
+                lua_pushlstring(L, base + h->key, h->klen);
+            }
+            lua_rawset(L, -3);
+            // create kv->val table
+            lua_pushliteral(L, "val");
+            lua_createtable(L, 1, 0);
+            lauxh_pushlstr2arr(L, 1, base + h->val, h->vlen);
+            lua_rawset(L, -3);
+
+            // push kv table to tbl[idx]
+            lua_pushvalue(L, -1);
+            lua_rawseti(L, tblidx, idx);
+            // push kv table to tbl[key]
+            lua_rawset(L, tblidx);
+        }
+    }
+}
+
+static int header_key_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *str = lauxh_checklstring(L, 1, &len);
+    size_t maxlen   = (size_t)lauxh_optuint16(L, 2, DEFAULT_HDR_MAXLEN);
+    size_t cur      = 0;
+    int rv          = parse_hkey((unsigned char *)str, len, &cur, &maxlen);
+    hkey_t *k       = NULL;
+
+    switch (rv) {
+    case PARSE_EAGAIN:
+        // push the lowercase and the canonical-case field-name
+        k = push_hkey(L, str, len);
+        if (!k) {
+            return 1;
+        }
+        lauxh_pushref(L, k->cref);
+        return 2;
+
+    case PARSE_OK:
+        // str must not contains the field separator (COLON)
+        rv = PARSE_EHDRNAME;
+    default:
+        return error_result_as_false(L, rv, "header_key");
+    }
+}
+
+/**
+ * parse_hlines parses the header-fields and the empty line, and stores the
+ * position of them relative to the str to the hdridx.
+ */
+static int parse_hlines(unsigned char *str, size_t len, size_t *cur,
+                        uint16_t maxhdrlen, uint8_t maxhdrnum,
+                        header_t *hdridx, uint8_t *nhdr)
 {
-    int tblidx         = lua_gettop(L);
-    header_t *hdridx   = lua_newuserdata(L, sizeof(header_t) * maxhdrnum);
     unsigned char *top = str;
-    uintptr_t head     = 0;
-    uint8_t nhdr       = 0;
+    uint8_t n          = 0;
     size_t pos         = 0;
     int rv             = 0;
 
@@ -1029,97 +1198,55 @@ RETRY:
         case LF:
             str++;
             // skip LF
-            goto PUSH_HEADERS;
+            goto DONE;
         }
     }
 
     // too many headers
-    if (nhdr >= maxhdrnum) {
+    if (n >= maxhdrnum) {
         return PARSE_EHDRNUM;
     }
 
-    head              = (uintptr_t)str;
-    hdridx[nhdr].lkey = LUA_NOREF;
-    hdridx[nhdr].key  = (char *)str;
-    hdridx[nhdr].klen = maxhdrlen;
-    rv = parse_hkey(L, &hdridx[nhdr].lkey, str, len, &pos, &hdridx[nhdr].klen);
-    if (rv != PARSE_OK) {
-        return rv;
-    }
-    // skip OWS
-    while (str[pos] == SP || str[pos] == HT) {
-        pos++;
-    }
-    str += pos;
-    len -= pos;
-
-    hdridx[nhdr].val  = (char *)str;
-    hdridx[nhdr].vlen = maxhdrlen - ((intptr_t)str - head);
-    rv                = parse_hval(str, len, &pos, &hdridx[nhdr].vlen);
+    rv = parse_hline(str, len, &pos, maxhdrlen, &hdridx[n]);
     if (rv != PARSE_OK) {
         return rv;
     }
+    // set position relative to the top of the headers
+    hdridx[n].key += (uintptr_t)str - (uintptr_t)top;
+    hdridx[n].val += (uintptr_t)str - (uintptr_t)top;
     str += pos;
     len -= pos;
     // set header
-    if (hdridx[nhdr].vlen) {
-        nhdr++;
+    if (hdridx[n].vlen) {
+        n++;
     }
 
     goto RETRY;
 
-PUSH_HEADERS:
-    while (nhdr) {
-        // check existing kv table of key
-        lauxh_pushref(L, hdridx->lkey);
-        lua_rawget(L, tblidx);
-        switch (lua_type(L, -1)) {
-        default: {
-            int idx = lauxh_rawlen(L, tblidx) + 1;
-            lua_pop(L, 1);
-            // create kv table
-            lua_createtable(L, 3, 0);
-            lauxh_pushint2tbl(L, "idx", idx);
-            lauxh_pushlstr2tbl(L, "key", hdridx->key, hdridx->klen);
-            // create kv->val table
-            lua_pushliteral(L, "val");
-            lua_createtable(L, 1, 0);
-            lauxh_pushlstr2arr(L, 1, hdridx->val, hdridx->vlen);
-            lua_rawset(L, -3);
-
-            // push kv table to tbl[key]
-            lauxh_pushref(L, hdridx->lkey);
-            // copy kv table
-            lua_pushvalue(L, -2);
-            lua_rawset(L, tblidx);
+DONE:
+    *nhdr = n;
+    *cur  = (uintptr_t)str - (uintptr_t)top;
+    return PARSE_OK;
+}
 
-            // push kv table to tbl[idx]
-            lua_rawseti(L, tblidx, idx);
-        } break;
+static int parse_header(lua_State *L, unsigned char *str, size_t len,
+                        size_t *cur, uint16_t maxhdrlen, uint8_t maxhdrnum)
+{
+    int tblidx       = lua_gettop(L);
+    header_t *hdridx = lua_newuserdata(L, sizeof(header_t) * maxhdrnum);
+    uint8_t nhdr     = 0;
+    int rv = parse_hlines(str, len, cur, maxhdrlen, maxhdrnum, hdridx, &nhdr);
 
-        case LUA_TTABLE: {
-            // get kv->val table
-            lua_pushliteral(L, "val");
-            lua_rawget(L, -2);
-            // append to tail
-            lauxh_pushlstr2arr(L, lauxh_rawlen(L, -1) + 1, hdridx->val,
-                               hdridx->vlen);
-            lua_pop(L, 2);
-        } break;
-        }
-        lauxh_unref(L, hdridx->lkey);
-        nhdr--;
-        hdridx++;
+    if (rv == PARSE_OK) {
+        push_headers(L, tblidx, (const char *)str, hdridx, nhdr);
     }
-
-    *cur = (uintptr_t)str - (uintptr_t)top;
-    return PARSE_OK;
+    return rv;
 }
 
 static int header_lua(lua_State *L)
 {
     size_t len          = 0;
-    unsigned char *str  = (unsigned char *)lauxh_checklstring(L, 1, &len);
+    unsigned char *str  = checkbytes(L, 1, &len);
     size_t cur          = (size_t)lauxh_optuint64(L, 3, 0);
     uint16_t maxhdrlen  = lauxh_optuint16(L, 4, DEFAULT_HDR_MAXLEN);
     uint8_t maxhdrnum   = lauxh_optuint8(L, 5, DEFAULT_HDR_MAXNUM);
@@ -1288,91 +1415,117 @@ static int parse_method(unsigned char *str, size_t len, size_t *cur,
 #undef METHOD_LEN
 }
 
-static int request_lua(lua_State *L)
+typedef struct {
+    const char *method;
+    size_t mlen;
+    const char *uri;
+    size_t ulen;
+    double ver;
+} reqline_t;
+
+static int parse_reqline(unsigned char *str, size_t len, size_t *cur,
+                         uint16_t maxmsglen, reqline_t *line)
 {
-    size_t len          = 0;
-    unsigned char *str  = (unsigned char *)lauxh_checklstring(L, 1, &len);
-    uint16_t maxmsglen  = lauxh_optuint16(L, 3, DEFAULT_MSG_MAXLEN);
-    uint16_t maxhdrlen  = lauxh_optuint16(L, 4, DEFAULT_HDR_MAXLEN);
-    uint8_t maxhdrnum   = lauxh_optuint8(L, 5, DEFAULT_HDR_MAXNUM);
     unsigned char *head = str;
-    const char *method  = NULL;
-    size_t mlen         = 0;
-    const char *uri     = NULL;
-    size_t ulen         = 0;
-    double ver          = 0;
-    size_t cur          = 0;
+    size_t pos          = 0;
     int rv              = 0;
 
-    // check container table
-    luaL_checktype(L, 2, LUA_TTABLE);
-    lua_settop(L, 2);
-
-SKIP_NEXT_CRLF:
-    switch (*str) {
-    // need more bytes
-    case 0:
-        return error_result_as_nil(L, PARSE_EAGAIN, "request");
-
-    case CR:
-    case LF:
-        str++;
-        len--;
-        goto SKIP_NEXT_CRLF;
-    }
-
-    method = (const char *)str;
-    rv     = parse_method(str, len, &cur, &mlen);
+    line->method = (const char *)str;
+    rv           = parse_method(str, len, &pos, &line->mlen);
     if (rv != PARSE_OK) {
-        return error_result_as_nil(L, rv, "request");
+        return rv;
     }
-    str += cur;
-    len -= cur;
+    str += pos;
+    len -= pos;
 
     // parse-uri (find SP delimiter)
-    uri = (const char *)str;
+    line->uri = (const char *)str;
     if (len > maxmsglen) {
         if (!(str = memchr(str, SP, maxmsglen))) {
-            return error_result_as_nil(L, PARSE_ELEN, "request");
+            return PARSE_ELEN;
         }
     } else if (!(str = memchr(str, SP, len))) {
-        return error_result_as_nil(L, PARSE_EAGAIN, "request");
+        return PARSE_EAGAIN;
     }
-    ulen = str - (unsigned char *)uri;
+    line->ulen = str - (unsigned char *)line->uri;
     str++;
-    len -= ulen + 1;
+    len -= line->ulen + 1;
 
-    rv = parse_version(str, len, &cur, &ver);
+    rv = parse_version(str, len, &pos, &line->ver);
     if (rv != PARSE_OK) {
-        return error_result_as_nil(L, rv, "request");
+        return rv;
     }
-    switch (str[cur]) {
+    switch (str[pos]) {
     case 0:
-        return error_result_as_nil(L, PARSE_EAGAIN, "request");
+        return PARSE_EAGAIN;
 
     case CR:
         // null-terminated
-        if (!str[cur + 1]) {
-            return error_result_as_nil(L, PARSE_EAGAIN, "request");
+        if (!str[pos + 1]) {
+            return PARSE_EAGAIN;
         }
         // invalid end-of-line terminator
-        else if (str[cur + 1] != LF) {
-            return error_result_as_nil(L, PARSE_EEOL, "request");
+        else if (str[pos + 1] != LF) {
+            return PARSE_EEOL;
         }
-        cur++;
+        pos++;
 
     case LF:
-        cur++;
+        pos++;
         break;
 
     default:
-        return error_result_as_nil(L, PARSE_EVERSION, "request");
+        return PARSE_EVERSION;
+    }
+
+    // number of bytes consumed
+    *cur = (uintptr_t)(str + pos) - (uintptr_t)head;
+    return PARSE_OK;
+}
+
+static inline void push_reqline(lua_State *L, reqline_t *line)
+{
+    lauxh_pushlstr2tbl(L, "method", line->method, line->mlen);
+    lauxh_pushlstr2tbl(L, "uri", line->uri, line->ulen);
+    lauxh_pushnum2tbl(L, "version", line->ver);
+}
+
+static int request_lua(lua_State *L)
+{
+    size_t len          = 0;
+    unsigned char *str  = checkbytes(L, 1, &len);
+    uint16_t maxmsglen  = lauxh_optuint16(L, 3, DEFAULT_MSG_MAXLEN);
+    uint16_t maxhdrlen  = lauxh_optuint16(L, 4, DEFAULT_HDR_MAXLEN);
+    uint8_t maxhdrnum   = lauxh_optuint8(L, 5, DEFAULT_HDR_MAXNUM);
+    unsigned char *head = str;
+    reqline_t line      = {0};
+    size_t cur          = 0;
+    int rv              = 0;
+
+    // check container table
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+
+SKIP_NEXT_CRLF:
+    switch (*str) {
+    // need more bytes
+    case 0:
+        return error_result_as_nil(L, PARSE_EAGAIN, "request");
+
+    case CR:
+    case LF:
+        str++;
+        len--;
+        goto SKIP_NEXT_CRLF;
+    }
+
+    rv = parse_reqline(str, len, &cur, maxmsglen, &line);
+    if (rv != PARSE_OK) {
+        return error_result_as_nil(L, rv, "request");
     }
 
     // set result to table
-    lauxh_pushlstr2tbl(L, "method", method, mlen);
-    lauxh_pushlstr2tbl(L, "uri", uri, ulen);
-    lauxh_pushnum2tbl(L, "version", ver);
+    push_reqline(L, &line);
     // number of bytes consumed
     str += cur;
     len -= cur;
@@ -1474,26 +1627,74 @@ static int parse_status(unsigned char *str, size_t len, size_t *cur,
 #undef STATUS_LEN
 }
 
-static int response_lua(lua_State *L)
+typedef struct {
+    double ver;
+    int status;
+    const char *reason;
+    size_t rlen;
+} resline_t;
+
+static int parse_resline(unsigned char *str, size_t len, size_t *cur,
+                         uint16_t maxmsglen, resline_t *line)
 {
-    size_t len          = 0;
-    unsigned char *str  = (unsigned char *)lauxh_checklstring(L, 1, &len);
-    uint16_t maxmsglen  = lauxh_optuint16(L, 3, DEFAULT_MSG_MAXLEN);
-    uint16_t maxhdrlen  = lauxh_optuint16(L, 4, DEFAULT_HDR_MAXLEN);
-    uint8_t maxhdrnum   = lauxh_optuint8(L, 5, DEFAULT_HDR_MAXNUM);
     unsigned char *head = str;
-    size_t cur          = 0;
-    double ver          = 0;
-    int status          = 0;
-    const char *reason  = NULL;
-    size_t rlen         = 0;
+    size_t pos          = 0;
     int rv              = 0;
 
-    // check container table
-    luaL_checktype(L, 2, LUA_TTABLE);
-    lua_settop(L, 2);
-
-SKIP_NEXT_CRLF:
+    rv = parse_version(str, len, &pos, &line->ver);
+    if (rv != PARSE_OK) {
+        return rv;
+    } else if (!str[pos]) {
+        return PARSE_EAGAIN;
+    } else if (str[pos] != SP) {
+        return PARSE_EVERSION;
+    }
+    str += pos + 1;
+    len -= pos + 1;
+
+    rv = parse_status(str, len, &pos, &line->status);
+    if (rv != PARSE_OK) {
+        return rv;
+    }
+    str += pos;
+    len -= pos;
+
+    line->reason = (const char *)str;
+    line->rlen   = maxmsglen;
+    rv           = parse_reason(str, len, &pos, &line->rlen);
+    if (rv != PARSE_OK) {
+        return rv;
+    }
+
+    // number of bytes consumed
+    *cur = (uintptr_t)(str + pos) - (uintptr_t)head;
+    return PARSE_OK;
+}
+
+static inline void push_resline(lua_State *L, resline_t *line)
+{
+    lauxh_pushnum2tbl(L, "version", line->ver);
+    lauxh_pushint2tbl(L, "status", line->status);
+    lauxh_pushlstr2tbl(L, "reason", line->reason, line->rlen);
+}
+
+static int response_lua(lua_State *L)
+{
+    size_t len          = 0;
+    unsigned char *str  = checkbytes(L, 1, &len);
+    uint16_t maxmsglen  = lauxh_optuint16(L, 3, DEFAULT_MSG_MAXLEN);
+    uint16_t maxhdrlen  = lauxh_optuint16(L, 4, DEFAULT_HDR_MAXLEN);
+    uint8_t maxhdrnum   = lauxh_optuint8(L, 5, DEFAULT_HDR_MAXNUM);
+    unsigned char *head = str;
+    resline_t line      = {0};
+    size_t cur          = 0;
+    int rv              = 0;
+
+    // check container table
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+
+SKIP_NEXT_CRLF:
     switch (*str) {
     // need more bytes
     case 0:
@@ -1506,35 +1707,13 @@ SKIP_NEXT_CRLF:
         goto SKIP_NEXT_CRLF;
     }
 
-    rv = parse_version(str, len, &cur, &ver);
-    if (rv != PARSE_OK) {
-        return error_result_as_nil(L, rv, "response");
-    } else if (!str[cur]) {
-        return error_result_as_nil(L, PARSE_EAGAIN, "response");
-    } else if (str[cur] != SP) {
-        return error_result_as_nil(L, PARSE_EVERSION, "response");
-    }
-    str += cur + 1;
-    len -= cur + 1;
-
-    rv = parse_status(str, len, &cur, &status);
-    if (rv != PARSE_OK) {
-        return error_result_as_nil(L, rv, "response");
-    }
-    str += cur;
-    len -= cur;
-
-    reason = (const char *)str;
-    rlen   = maxmsglen;
-    rv     = parse_reason(str, len, &cur, &rlen);
+    rv = parse_resline(str, len, &cur, maxmsglen, &line);
     if (rv != PARSE_OK) {
         return error_result_as_nil(L, rv, "response");
     }
 
     // set result to table
-    lauxh_pushnum2tbl(L, "version", ver);
-    lauxh_pushint2tbl(L, "status", status);
-    lauxh_pushlstr2tbl(L, "reason", reason, rlen);
+    push_resline(L, &line);
     // number of bytes consumed
     str += cur;
     len -= cur;
@@ -1555,13 +1734,963 @@ SKIP_NEXT_CRLF:
     return 1;
 }
 
+static inline int hkey_equal(const char *key, size_t klen, const char *name,
+                             size_t nlen)
+{
+    if (klen != nlen) {
+        return 0;
+    }
+    for (size_t i = 0; i < klen; i++) {
+        if (TCHAR[(unsigned char)key[i]] != (unsigned char)name[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#define BODY_NONE    0  // no message body
+#define BODY_LENGTH  1  // message body length is determined by Content-Length
+#define BODY_UNKNOWN -1 // message body length cannot be determined
+
+/**
+ * body_length determines the length of the message body from the
+ * Content-Length and Transfer-Encoding headers. the length is unknown if the
+ * message is chunked, or the Content-Length is invalid or inconsistent.
+ */
+static int body_length(const char *base, header_t *hdridx, uint8_t nhdr,
+                       size_t *len)
+{
+    int rv = BODY_NONE;
+
+    *len = 0;
+    for (uint8_t i = 0; i < nhdr; i++) {
+        header_t *h     = hdridx + i;
+        const char *val = base + h->val;
+        size_t n        = 0;
+
+        if (hkey_equal(base + h->key, h->klen, "transfer-encoding", 17)) {
+            return BODY_UNKNOWN;
+        } else if (!hkey_equal(base + h->key, h->klen, "content-length", 14)) {
+            continue;
+        } else if (h->vlen > 15) {
+            // too large
+            return BODY_UNKNOWN;
+        }
+
+        for (size_t j = 0; j < h->vlen; j++) {
+            if (val[j] < '0' || val[j] > '9') {
+                return BODY_UNKNOWN;
+            }
+            n = n * 10 + (size_t)(val[j] - '0');
+        }
+        if (rv == BODY_LENGTH && n != *len) {
+            return BODY_UNKNOWN;
+        }
+        rv   = BODY_LENGTH;
+        *len = n;
+    }
+
+    return rv;
+}
+
+/**
+ * parse_messages parses the pipelined messages in the str at once, and
+ * returns an array of message tables and the number of bytes consumed.
+ * the message body is set to the body field if its length is determined by
+ * the Content-Length header and it has been received. otherwise, parsing stops
+ * after the header of that message, and its body is left unconsumed.
+ * the bytes of the net.http.buffer are not consumed.
+ */
+static int parse_messages(lua_State *L, int isreq, const char *op)
+{
+    size_t len          = 0;
+    unsigned char *str  = checkbytes(L, 1, &len);
+    uint8_t max         = lauxh_optuint8(L, 2, DEFAULT_MSG_MAXNUM);
+    uint16_t maxmsglen  = lauxh_optuint16(L, 3, DEFAULT_MSG_MAXLEN);
+    uint16_t maxhdrlen  = lauxh_optuint16(L, 4, DEFAULT_HDR_MAXLEN);
+    uint8_t maxhdrnum   = lauxh_optuint8(L, 5, DEFAULT_HDR_MAXNUM);
+    unsigned char *head = str;
+    header_t *hdridx    = NULL;
+    int nmsg            = 0;
+    int rv              = PARSE_OK;
+
+    luaL_argcheck(L, max > 0, 2, "max must be greater than 0");
+    lua_settop(L, 5);
+    hdridx = lua_newuserdata(L, sizeof(header_t) * maxhdrnum);
+    lua_createtable(L, max, 0);
+
+    while (nmsg < max) {
+        unsigned char *msg = str;
+        size_t mlen        = len;
+        size_t cur         = 0;
+        size_t blen        = 0;
+        uint8_t nhdr       = 0;
+        int nobody         = 0;
+        int body           = BODY_NONE;
+
+        // skip the empty lines before the message
+        while (*msg == CR || *msg == LF) {
+            msg++;
+            mlen--;
+        }
+        if (!*msg) {
+            rv = PARSE_EAGAIN;
+            break;
+        }
+
+        lua_createtable(L, 0, 5);
+        if (isreq) {
+            reqline_t line = {0};
+            rv             = parse_reqline(msg, mlen, &cur, maxmsglen, &line);
+            if (rv != PARSE_OK) {
+                break;
+            }
+            push_reqline(L, &line);
+        } else {
+            resline_t line = {0};
+            rv             = parse_resline(msg, mlen, &cur, maxmsglen, &line);
+            if (rv != PARSE_OK) {
+                break;
+            }
+            push_resline(L, &line);
+            // 1xx, 204 and 304 responses do not have a message body
+            nobody = (line.status >= 100 && line.status < 200) ||
+                     line.status == 204 || line.status == 304;
+        }
+        msg += cur;
+        mlen -= cur;
+
+        rv = parse_hlines(msg, mlen, &cur, maxhdrlen, maxhdrnum, hdridx,
+                          &nhdr);
+        if (rv != PARSE_OK) {
+            break;
+        }
+        lua_pushliteral(L, "header");
+        lua_createtable(L, nhdr, nhdr);
+        push_headers(L, lua_gettop(L), (const char *)msg, hdridx, nhdr);
+        lua_rawset(L, -3);
+
+        if (!nobody) {
+            body = body_length((const char *)msg, hdridx, nhdr, &blen);
+            // the response body without the length is delimited by close
+            if (body == BODY_NONE && !isreq) {
+                body = BODY_UNKNOWN;
+            }
+        }
+        msg += cur;
+        mlen -= cur;
+
+        // consume the message
+        lua_rawseti(L, -2, ++nmsg);
+        str = msg;
+        len = mlen;
+        if (body == BODY_UNKNOWN) {
+            break;
+        } else if (body == BODY_LENGTH) {
+            if (blen > len) {
+                // the body has not been received
+                break;
+            }
+            lua_rawgeti(L, -1, nmsg);
+            lauxh_pushlstr2tbl(L, "body", (const char *)str, blen);
+            lua_pop(L, 1);
+            str += blen;
+            len -= blen;
+        }
+    }
+
+    if (nmsg == 0) {
+        return error_result_as_nil(L, rv, op);
+    }
+    // discard the incomplete message
+    lua_settop(L, 7);
+    lua_pushinteger(L, (uintptr_t)str - (uintptr_t)head);
+    return 2;
+}
+
+static int requests_lua(lua_State *L)
+{
+    return parse_messages(L, 1, "requests");
+}
+
+static int responses_lua(lua_State *L)
+{
+    return parse_messages(L, 0, "responses");
+}
+
+/**
+ * parser
+ *
+ * the parser keeps the received bytes and the position of the line to be
+ * parsed next, so the parsing can be resumed from where it stopped when the
+ * new bytes are fed.
+ * if the net.http.buffer is passed instead of the string, the parser scans the
+ * unread bytes of the buffer in place, and consumes the bytes of the parsed
+ * message from the buffer.
+ */
+#define PARSER_MT "net.http.parse.parser"
+
+// the buffer larger than this size will be released on reset
+#define PARSER_BUFSIZE_KEEP 65536
+
+// maximum number of bytes of the request-line and status-line except the
+// request-target and reason-phrase.
+//
+//  request-line = method(7) SP request-target SP HTTP-version(8) CRLF
+//  status-line  = HTTP-version(8) SP status-code(3) SP reason-phrase CRLF
+#define STARTLINE_EXTRA_LEN 19
+
+enum {
+    PARSER_STARTLINE = 0,
+    PARSER_HEADER,
+    PARSER_DONE,
+};
+
+typedef struct {
+    int phase;
+    uint16_t maxmsglen;
+    uint16_t maxhdrlen;
+    uint8_t maxhdrnum;
+    uint8_t nhdr;
+    // create the header view instead of the header table
+    int lazy;
+    // position of the header section
+    size_t hdrpos;
+    // received bytes
+    buffer_t own;
+    // bytes to be parsed
+    unsigned char *buf;
+    size_t len;
+    // position of the line to be parsed next
+    size_t cur;
+    // position to resume the search of LF
+    size_t scan;
+    // scratch header index that is reused between messages
+    header_t hdridx[];
+} parser_t;
+
+/**
+ * header view
+ *
+ * the view keeps a copy of the header section and the positions of the
+ * field-names and field-values, so the strings of the header fields are
+ * created only when they are looked up.
+ */
+#define HEADERS_MT "net.http.parse.headers"
+
+typedef struct {
+    uint8_t nhdr;
+    size_t len;
+    unsigned char *raw;
+    header_t hdridx[];
+} headers_t;
+
+static inline int headers_match(headers_t *h, header_t *hdr, const char *key,
+                                size_t klen)
+{
+    const unsigned char *name = h->raw + hdr->key;
+
+    if (hdr->klen != klen) {
+        return 0;
+    }
+    // field-names are case-insensitive
+    for (size_t i = 0; i < klen; i++) {
+        if (TCHAR[name[i]] != TCHAR[(unsigned char)key[i]]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int headers_get_lua(lua_State *L)
+{
+    headers_t *h    = luaL_checkudata(L, 1, HEADERS_MT);
+    size_t klen     = 0;
+    const char *key = lauxh_checklstring(L, 2, &klen);
+    int all         = lauxh_optboolean(L, 3, 0);
+    header_t *first = NULL;
+    header_t *last  = NULL;
+    int nval        = 0;
+
+    lua_settop(L, 3);
+    for (uint8_t i = 0; i < h->nhdr; i++) {
+        header_t *hdr = h->hdridx + i;
+
+        if (headers_match(h, hdr, key, klen)) {
+            if (!first) {
+                first = hdr;
+                if (all) {
+                    lua_createtable(L, 1, 0);
+                }
+            }
+            last = hdr;
+            if (all) {
+                lauxh_pushlstr2arr(L, ++nval, (const char *)h->raw + hdr->val,
+                                   hdr->vlen);
+            }
+        }
+    }
+
+    if (!first) {
+        lua_pushnil(L);
+        return 1;
+    } else if (!all) {
+        lua_pushlstring(L, (const char *)h->raw + last->val, last->vlen);
+    }
+    lua_pushlstring(L, (const char *)h->raw + first->key, first->klen);
+    return 2;
+}
+
+static int headers_totable_lua(lua_State *L)
+{
+    headers_t *h = luaL_checkudata(L, 1, HEADERS_MT);
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+    push_headers(L, 2, (const char *)h->raw, h->hdridx, h->nhdr);
+    return 1;
+}
+
+static int headers_len_lua(lua_State *L)
+{
+    headers_t *h = luaL_checkudata(L, 1, HEADERS_MT);
+    lua_pushinteger(L, h->nhdr);
+    return 1;
+}
+
+static int headers_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, HEADERS_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+/**
+ * push_header_view creates the header view of the header section of the
+ * bytes.
+ */
+static void push_header_view(lua_State *L, const unsigned char *str,
+                             size_t len, header_t *hdridx, uint8_t nhdr,
+                             size_t offset)
+{
+    headers_t *h = lua_newuserdata(
+        L, sizeof(headers_t) + sizeof(header_t) * nhdr + len + 1);
+
+    h->nhdr = nhdr;
+    h->len  = len;
+    h->raw  = (unsigned char *)(h->hdridx + nhdr);
+    memcpy(h->raw, str, len);
+    h->raw[len] = 0;
+    for (uint8_t i = 0; i < nhdr; i++) {
+        h->hdridx[i] = (header_t){
+            .key  = hdridx[i].key - offset,
+            .klen = hdridx[i].klen,
+            .val  = hdridx[i].val - offset,
+            .vlen = hdridx[i].vlen,
+        };
+    }
+    lauxh_setmetatable(L, HEADERS_MT);
+}
+
+static inline void parser_restart(parser_t *p)
+{
+    p->phase = PARSER_STARTLINE;
+    p->nhdr  = 0;
+    p->cur   = 0;
+    p->scan  = 0;
+}
+
+static void parser_reset(parser_t *p)
+{
+    buffer_clear(&p->own, PARSER_BUFSIZE_KEEP);
+    p->buf = NULL;
+    p->len = 0;
+    parser_restart(p);
+}
+
+static int parser_append(parser_t *p, const char *str, size_t len)
+{
+    if (p->phase == PARSER_DONE) {
+        // start parsing the next message with the remaining bytes
+        buffer_consume(&p->own, p->cur);
+        parser_restart(p);
+    }
+
+    if (buffer_write(&p->own, str, len) != 0) {
+        return -1;
+    }
+    p->buf = buffer_ptr(&p->own);
+    p->len = buffer_len(&p->own);
+    return 0;
+}
+
+static void parser_attach(parser_t *p, buffer_t *b)
+{
+    if (p->phase == PARSER_DONE) {
+        // the bytes of the previous message have already been consumed
+        parser_restart(p);
+    }
+    p->buf = buffer_ptr(b);
+    p->len = buffer_len(b);
+}
+
+/**
+ * parser_has_line returns 1 if the remaining bytes contain LF. otherwise it
+ * returns 0 and the search will be resumed from the end of the bytes.
+ */
+static inline int parser_has_line(parser_t *p)
+{
+    size_t pos = (p->scan > p->cur) ? p->scan : p->cur;
+
+    if (pos < p->len && memchr(p->buf + pos, LF, p->len - pos)) {
+        return 1;
+    }
+    p->scan = p->len;
+    return 0;
+}
+
+static int parser_startline(lua_State *L, parser_t *p, int isreq)
+{
+    unsigned char *str = p->buf + p->cur;
+    size_t len         = p->len - p->cur;
+    size_t maxlen      = (size_t)p->maxmsglen + STARTLINE_EXTRA_LEN;
+    size_t cur         = 0;
+    int rv             = 0;
+
+    // parse only if the line is complete or too long
+    if (!parser_has_line(p) && len <= maxlen) {
+        return PARSE_EAGAIN;
+    } else if (isreq) {
+        reqline_t line = {0};
+        if ((rv = parse_reqline(str, len, &cur, p->maxmsglen, &line)) ==
+            PARSE_OK) {
+            push_reqline(L, &line);
+        }
+    } else {
+        resline_t line = {0};
+        if ((rv = parse_resline(str, len, &cur, p->maxmsglen, &line)) ==
+            PARSE_OK) {
+            push_resline(L, &line);
+        }
+    }
+
+    if (rv == PARSE_OK) {
+        p->cur += cur;
+    } else if (rv == PARSE_EAGAIN && len > maxlen) {
+        return PARSE_ELEN;
+    }
+    return rv;
+}
+
+static int parser_header(parser_t *p)
+{
+    size_t maxlen = (size_t)p->maxhdrlen + 2;
+
+    while (1) {
+        unsigned char *str = p->buf + p->cur;
+        size_t len         = p->len - p->cur;
+        size_t cur         = 0;
+        header_t *h        = NULL;
+        int rv             = 0;
+
+        if (!len) {
+            return PARSE_EAGAIN;
+        }
+
+        // check header-tail
+        switch (*str) {
+        case CR:
+            if (len < 2) {
+                return PARSE_EAGAIN;
+            } else if (str[1] == LF) {
+                p->cur += 2;
+                return PARSE_OK;
+            }
+            break;
+
+        case LF:
+            p->cur++;
+            return PARSE_OK;
+        }
+
+        // too many headers
+        if (p->nhdr >= p->maxhdrnum) {
+            return PARSE_EHDRNUM;
+        }
+        // parse only if the line is complete or too long
+        else if (!parser_has_line(p) && len <= maxlen) {
+            return PARSE_EAGAIN;
+        }
+
+        h  = p->hdridx + p->nhdr;
+        rv = parse_hline(str, len, &cur, p->maxhdrlen, h);
+        if (rv != PARSE_OK) {
+            if (rv == PARSE_EAGAIN && len > maxlen) {
+                return PARSE_EHDRLEN;
+            }
+            return rv;
+        }
+        // set position relative to the head of the buffer
+        h->key += p->cur;
+        h->val += p->cur;
+        p->cur += cur;
+        // set header
+        if (h->vlen) {
+            p->nhdr++;
+        }
+    }
+}
+
+static int parser_exec(lua_State *L, parser_t *p, int isreq)
+{
+    int tblidx = lua_gettop(L);
+    int rv     = 0;
+
+    switch (p->phase) {
+    case PARSER_STARTLINE:
+        // skip empty lines
+        while (p->cur < p->len &&
+               (p->buf[p->cur] == CR || p->buf[p->cur] == LF)) {
+            p->cur++;
+        }
+        if (p->cur == p->len) {
+            return PARSE_EAGAIN;
+        }
+
+        rv = parser_startline(L, p, isreq);
+        if (rv != PARSE_OK) {
+            return rv;
+        }
+
+        // parse header if exists
+        lua_pushliteral(L, "header");
+        lua_rawget(L, tblidx);
+        if (lua_type(L, -1) != LUA_TTABLE) {
+            lua_settop(L, tblidx);
+            p->phase = PARSER_DONE;
+            return PARSE_OK;
+        }
+        lua_settop(L, tblidx);
+        p->phase  = PARSER_HEADER;
+        p->hdrpos = p->cur;
+
+    case PARSER_HEADER:
+        rv = parser_header(p);
+        if (rv != PARSE_OK) {
+            return rv;
+        }
+        lua_pushliteral(L, "header");
+        if (p->lazy) {
+            // replace the header table with the header view
+            push_header_view(L, p->buf + p->hdrpos, p->cur - p->hdrpos,
+                             p->hdridx, p->nhdr, p->hdrpos);
+            lua_rawset(L, tblidx);
+        } else {
+            lua_rawget(L, tblidx);
+            push_headers(L, lua_gettop(L), (const char *)p->buf, p->hdridx,
+                         p->nhdr);
+        }
+        lua_settop(L, tblidx);
+        p->phase = PARSER_DONE;
+    }
+
+    return PARSE_OK;
+}
+
+static int parser_parse(lua_State *L, int isreq, const char *op)
+{
+    parser_t *p     = luaL_checkudata(L, 1, PARSER_MT);
+    buffer_t *b     = NULL;
+    size_t len      = 0;
+    const char *str = NULL;
+    int rv          = 0;
+
+    if (lua_type(L, 2) == LUA_TUSERDATA) {
+        b = luaL_checkudata(L, 2, BUFFER_MT);
+    } else if (!lua_isnoneornil(L, 2)) {
+        str = lauxh_checklstring(L, 2, &len);
+    }
+    // check container table
+    luaL_checktype(L, 3, LUA_TTABLE);
+    lua_settop(L, 3);
+
+    if (b) {
+        parser_attach(p, b);
+    } else if (parser_append(p, str, len) != 0) {
+        return luaL_error(L, "failed to allocate the parser buffer");
+    }
+
+    rv = parser_exec(L, p, isreq);
+    if (rv != PARSE_OK) {
+        return error_result_as_nil(L, rv, op);
+    }
+    // number of bytes consumed
+    lua_pushinteger(L, p->cur);
+    if (b) {
+        buffer_consume(b, p->cur);
+        p->cur = 0;
+    }
+    return 1;
+}
+
+static int parser_request_lua(lua_State *L)
+{
+    return parser_parse(L, 1, "request");
+}
+
+static int parser_response_lua(lua_State *L)
+{
+    return parser_parse(L, 0, "response");
+}
+
+static int parser_reset_lua(lua_State *L)
+{
+    parser_t *p = luaL_checkudata(L, 1, PARSER_MT);
+
+    lua_settop(L, 1);
+    // push the bytes that are not consumed by the parsed message
+    if (p->phase == PARSER_DONE) {
+        buffer_consume(&p->own, p->cur);
+    }
+    if (buffer_len(&p->own)) {
+        lua_pushlstring(L, (const char *)buffer_ptr(&p->own),
+                        buffer_len(&p->own));
+    } else {
+        lua_pushnil(L);
+    }
+    parser_reset(p);
+    return 1;
+}
+
+static int parser_setlazy_lua(lua_State *L)
+{
+    parser_t *p = luaL_checkudata(L, 1, PARSER_MT);
+
+    p->lazy = lauxh_checkboolean(L, 2);
+    return 0;
+}
+
+static int parser_size_lua(lua_State *L)
+{
+    parser_t *p = luaL_checkudata(L, 1, PARSER_MT);
+    lua_pushinteger(L, buffer_len(&p->own));
+    return 1;
+}
+
+static int parser_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, PARSER_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int parser_gc_lua(lua_State *L)
+{
+    parser_t *p = lua_touserdata(L, 1);
+
+    buffer_clear(&p->own, 0);
+    p->buf = NULL;
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    uint16_t maxmsglen = lauxh_optuint16(L, 1, DEFAULT_MSG_MAXLEN);
+    uint16_t maxhdrlen = lauxh_optuint16(L, 2, DEFAULT_HDR_MAXLEN);
+    uint8_t maxhdrnum  = lauxh_optuint8(L, 3, DEFAULT_HDR_MAXNUM);
+    parser_t *p =
+        lua_newuserdata(L, sizeof(parser_t) + sizeof(header_t) * maxhdrnum);
+
+    *p = (parser_t){
+        .phase     = PARSER_STARTLINE,
+        .maxmsglen = maxmsglen,
+        .maxhdrlen = maxhdrlen,
+        .maxhdrnum = maxhdrnum,
+    };
+    lauxh_setmetatable(L, PARSER_MT);
+    return 1;
+}
+
+/**
+ * chunked decoder
+ *
+ * the decoder consumes the chunked-encoded bytes from the net.http.buffer and
+ * returns the chunk-data as soon as it arrives, so the chunked body can be
+ * read in linear time without keeping a whole chunk in memory.
+ */
+#define CHUNKED_MT "net.http.parse.chunked"
+
+enum {
+    CHUNKED_SIZE = 0,
+    CHUNKED_DATA,
+    CHUNKED_EOL,
+    CHUNKED_TRAILER,
+    CHUNKED_DONE,
+};
+
+typedef struct {
+    int phase;
+    uint16_t maxlen;
+    uint16_t maxhdrlen;
+    uint8_t maxhdrnum;
+    // reference of the chunk-extensions of the current chunk
+    int ext;
+    // number of bytes of the chunk-data that are not read yet
+    size_t remain;
+} chunked_t;
+
+static int chunked_read_lua(lua_State *L)
+{
+    chunked_t *c = luaL_checkudata(L, 1, CHUNKED_MT);
+    buffer_t *b  = luaL_checkudata(L, 2, BUFFER_MT);
+
+    lua_settop(L, 2);
+    while (1) {
+        unsigned char *str = buffer_ptr(b);
+        size_t len         = buffer_len(b);
+        ssize_t size       = 0;
+        size_t cur         = 0;
+        int rv             = 0;
+
+        switch (c->phase) {
+        case CHUNKED_SIZE:
+            // chunk = chunk-size [ chunk-ext ] CRLF
+            lua_createtable(L, 0, 0);
+            rv = parse_chunksize(L, str, len, c->maxlen, 3, &size, &cur);
+            if (rv != PARSE_OK) {
+                return error_result_as_nil(L, rv, "read");
+            }
+            buffer_consume(b, cur);
+            c->ext = lauxh_unref(L, c->ext);
+            c->ext = lauxh_ref(L);
+
+            // last-chunk = 1*("0") [ chunk-ext ] CRLF
+            if (size == 0) {
+                c->phase = CHUNKED_TRAILER;
+                lua_pushnil(L);
+                lua_pushnil(L);
+                lauxh_pushref(L, c->ext);
+                return 3;
+            }
+            c->remain = size;
+            c->phase  = CHUNKED_DATA;
+            str       = buffer_ptr(b);
+            len       = buffer_len(b);
+
+        case CHUNKED_DATA:
+            // chunk-data = 1*OCTET ; a sequence of chunk-size octets
+            if (!len) {
+                return error_result_as_nil(L, PARSE_EAGAIN, "read");
+            } else if (len > c->remain) {
+                len = c->remain;
+            }
+            lua_pushlstring(L, (const char *)str, len);
+            buffer_consume(b, len);
+            c->remain -= len;
+            if (!c->remain) {
+                c->phase = CHUNKED_EOL;
+            }
+            lua_pushnil(L);
+            lauxh_pushref(L, c->ext);
+            return 3;
+
+        case CHUNKED_EOL:
+            // CRLF after the chunk-data
+            if (!len) {
+                return error_result_as_nil(L, PARSE_EAGAIN, "read");
+            } else if (*str == LF) {
+                buffer_consume(b, 1);
+            } else if (*str != CR) {
+                return error_result_as_nil(L, PARSE_EEOL, "read");
+            } else if (len < 2) {
+                return error_result_as_nil(L, PARSE_EAGAIN, "read");
+            } else if (str[1] != LF) {
+                return error_result_as_nil(L, PARSE_EEOL, "read");
+            } else {
+                buffer_consume(b, 2);
+            }
+            c->phase = CHUNKED_SIZE;
+            continue;
+
+        // CHUNKED_TRAILER
+        // CHUNKED_DONE
+        default:
+            // all chunks have been read
+            lua_pushnil(L);
+            return 1;
+        }
+    }
+}
+
+static int chunked_trailer_lua(lua_State *L)
+{
+    chunked_t *c = luaL_checkudata(L, 1, CHUNKED_MT);
+    buffer_t *b  = luaL_checkudata(L, 2, BUFFER_MT);
+    size_t cur   = 0;
+    int rv       = 0;
+
+    // check container table
+    luaL_checktype(L, 3, LUA_TTABLE);
+    lua_settop(L, 3);
+
+    switch (c->phase) {
+    case CHUNKED_TRAILER:
+        // trailer-part = *( header-field CRLF ) CRLF
+        rv = parse_header(L, buffer_ptr(b), buffer_len(b), &cur, c->maxhdrlen,
+                          c->maxhdrnum);
+        if (rv != PARSE_OK) {
+            return error_result_as_nil(L, rv, "trailer");
+        }
+        buffer_consume(b, cur);
+        c->phase = CHUNKED_DONE;
+
+    case CHUNKED_DONE:
+        lua_pushboolean(L, 1);
+        return 1;
+
+    default:
+        return luaL_error(L, "the last-chunk has not been read");
+    }
+}
+
+static int chunked_reset_lua(lua_State *L)
+{
+    chunked_t *c = luaL_checkudata(L, 1, CHUNKED_MT);
+
+    c->ext    = lauxh_unref(L, c->ext);
+    c->phase  = CHUNKED_SIZE;
+    c->remain = 0;
+    return 0;
+}
+
+static int chunked_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, CHUNKED_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int chunked_gc_lua(lua_State *L)
+{
+    chunked_t *c = lua_touserdata(L, 1);
+
+    c->ext = lauxh_unref(L, c->ext);
+    return 0;
+}
+
+static int new_chunked_lua(lua_State *L)
+{
+    uint16_t maxlen    = lauxh_optuint16(L, 1, DEFAULT_CHUNKSIZE_MAXLEN);
+    uint16_t maxhdrlen = lauxh_optuint16(L, 2, DEFAULT_HDR_MAXLEN);
+    uint8_t maxhdrnum  = lauxh_optuint8(L, 3, DEFAULT_HDR_MAXNUM);
+    chunked_t *c       = lua_newuserdata(L, sizeof(chunked_t));
+
+    *c = (chunked_t){
+        .phase     = CHUNKED_SIZE,
+        .maxlen    = maxlen,
+        .maxhdrlen = maxhdrlen,
+        .maxhdrnum = maxhdrnum,
+        .ext       = LUA_NOREF,
+    };
+    lauxh_setmetatable(L, CHUNKED_MT);
+    return 1;
+}
+
+static void init_metatable(lua_State *L, const char *tname,
+                           struct luaL_Reg *mmethods, struct luaL_Reg *methods)
+{
+    struct luaL_Reg *ptr = mmethods;
+
+    luaL_newmetatable(L, tname);
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_pushliteral(L, "__index");
+    lua_newtable(L);
+    ptr = methods;
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+static void init_parser_mt(lua_State *L)
+{
+    struct luaL_Reg mmethods[] = {
+        {"__gc",       parser_gc_lua      },
+        {"__tostring", parser_tostring_lua},
+        {NULL,         NULL               }
+    };
+    struct luaL_Reg methods[] = {
+        {"request",  parser_request_lua },
+        {"response", parser_response_lua},
+        {"reset",    parser_reset_lua   },
+        {"size",     parser_size_lua    },
+        {"setlazy",  parser_setlazy_lua },
+        {NULL,       NULL               }
+    };
+
+    init_metatable(L, PARSER_MT, mmethods, methods);
+}
+
+static void init_headers_mt(lua_State *L)
+{
+    struct luaL_Reg mmethods[] = {
+        {"__len",      headers_len_lua     },
+        {"__tostring", headers_tostring_lua},
+        {NULL,         NULL                }
+    };
+    struct luaL_Reg methods[] = {
+        {"get",     headers_get_lua    },
+        {"totable", headers_totable_lua},
+        {NULL,      NULL               }
+    };
+
+    init_metatable(L, HEADERS_MT, mmethods, methods);
+}
+
+static void init_chunked_mt(lua_State *L)
+{
+    struct luaL_Reg mmethods[] = {
+        {"__gc",       chunked_gc_lua      },
+        {"__tostring", chunked_tostring_lua},
+        {NULL,         NULL                }
+    };
+    struct luaL_Reg methods[] = {
+        {"read",    chunked_read_lua   },
+        {"trailer", chunked_trailer_lua},
+        {"reset",   chunked_reset_lua  },
+        {NULL,      NULL               }
+    };
+
+    init_metatable(L, CHUNKED_MT, mmethods, methods);
+}
+
+static void init_hkeys(lua_State *L)
+{
+    for (size_t i = 0; i < HKEY_NSLOT; i++) {
+        hkey_t *k = HKEYS + i;
+        if (k->name) {
+            lua_pushlstring(L, k->name, k->len);
+            k->lref = lauxh_ref(L);
+            lua_pushlstring(L, k->canon, k->len);
+            k->cref = lauxh_ref(L);
+        }
+    }
+}
+
 LUALIB_API int luaopen_net_http_parse(lua_State *L)
 {
     struct luaL_Reg funcs[] = {
+        {"new",           new_lua          },
+        {"new_chunked",   new_chunked_lua  },
         {"response",      response_lua     },
         {"request",       request_lua      },
+        {"requests",      requests_lua     },
+        {"responses",     responses_lua    },
         {"header",        header_lua       },
         {"header_name",   header_name_lua  },
+        {"header_key",    header_key_lua   },
         {"header_value",  header_value_lua },
         {"chunksize",     chunksize_lua    },
         {"parameters",    parameters_lua   },
@@ -1573,6 +2702,11 @@ LUALIB_API int luaopen_net_http_parse(lua_State *L)
     struct luaL_Reg *ptr = funcs;
 
     init_error_types(L);
+    init_parser_mt(L);
+    init_headers_mt(L);
+    init_chunked_mt(L);
+    init_hkeys(L);
+    init_scan();
 
     lua_createtable(L, 0, sizeof(funcs) / sizeof(struct luaL_Reg) + 12);
     do {
@@ -1609,6 +2743,8 @@ LUALIB_API int luaopen_net_http_parse(lua_State *L)
     lua_setfield(L, -2, "ERANGE");
     lauxh_pushref(L, PARSE_ERR_EEMPTY);
     lua_setfield(L, -2, "EEMPTY");
+    // name of the vectorized scanning implementation
+    lauxh_pushstr2tbl(L, "SIMD", SCAN_IMPL);
 
     return 1;
 }
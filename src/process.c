@@ -0,0 +1,243 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/process.c
+ *  lua-net-http
+ */
+
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+// lua
+#include <lauxhlib.h>
+
+// the signals that are handled by the supervisor process
+static sigset_t SUPERVISOR_SIGSET;
+static sigset_t ORIGINAL_SIGSET;
+// set by the signal handler in the worker process
+static volatile sig_atomic_t TERMINATED = 0;
+
+static int push_errno(lua_State *L, const char *op)
+{
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s: %s", op, strerror(errno));
+    return 2;
+}
+
+/**
+ * fork creates the child process. it returns the pid of the child process in
+ * the parent process, and 0 in the child process.
+ */
+static int fork_lua(lua_State *L)
+{
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        return push_errno(L, "fork");
+    }
+    lua_pushinteger(L, pid);
+    return 1;
+}
+
+static int getpid_lua(lua_State *L)
+{
+    lua_pushinteger(L, getpid());
+    return 1;
+}
+
+static int kill_lua(lua_State *L)
+{
+    pid_t pid = (pid_t)lauxh_checkinteger(L, 1);
+    int signo = (int)lauxh_checkinteger(L, 2);
+
+    if (kill(pid, signo) == -1 && errno != ESRCH) {
+        return push_errno(L, "kill");
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * reap collects the status of the terminated child process without blocking.
+ * it returns the pid, the exit status and the signal number that terminated
+ * the process, or nil if there is no terminated child process.
+ */
+static int reap_lua(lua_State *L)
+{
+    int status = 0;
+    pid_t pid  = 0;
+
+RETRY:
+    pid = waitpid(-1, &status, WNOHANG);
+    if (pid == -1) {
+        if (errno == EINTR) {
+            goto RETRY;
+        } else if (errno == ECHILD) {
+            return 0;
+        }
+        return push_errno(L, "waitpid");
+    } else if (pid == 0) {
+        return 0;
+    }
+
+    lua_pushinteger(L, pid);
+    if (WIFEXITED(status)) {
+        lua_pushinteger(L, WEXITSTATUS(status));
+        lua_pushnil(L);
+    } else {
+        lua_pushnil(L);
+        lua_pushinteger(L, WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    }
+    return 3;
+}
+
+/**
+ * sigblock blocks the signals that are handled by the supervisor process, so
+ * that they are received by sigwait().
+ */
+static int sigblock_lua(lua_State *L)
+{
+    if (sigprocmask(SIG_BLOCK, &SUPERVISOR_SIGSET, &ORIGINAL_SIGSET) == -1) {
+        return push_errno(L, "sigprocmask");
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * sigunblock restores the signal mask that is changed by sigblock().
+ */
+static int sigunblock_lua(lua_State *L)
+{
+    if (sigprocmask(SIG_SETMASK, &ORIGINAL_SIGSET, NULL) == -1) {
+        return push_errno(L, "sigprocmask");
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * sigwait waits for the blocked signal until the msec milliseconds elapse.
+ * it returns the signal number, or nil on timeout.
+ */
+static int sigwait_lua(lua_State *L)
+{
+    lua_Integer msec   = lauxh_optinteger(L, 1, -1);
+    struct timespec ts = {0};
+    int signo          = 0;
+
+    if (msec < 0) {
+        signo = sigwaitinfo(&SUPERVISOR_SIGSET, NULL);
+    } else {
+        ts.tv_sec  = msec / 1000;
+        ts.tv_nsec = (msec % 1000) * 1000000;
+        signo      = sigtimedwait(&SUPERVISOR_SIGSET, NULL, &ts);
+    }
+
+    if (signo == -1) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return 0;
+        }
+        return push_errno(L, "sigwait");
+    }
+    lua_pushinteger(L, signo);
+    return 1;
+}
+
+static void on_terminate(int signo)
+{
+    (void)signo;
+    TERMINATED = 1;
+}
+
+/**
+ * watch_terminate restores the signal mask of the worker process, and sets the
+ * handler of SIGTERM and SIGINT that marks the process as terminated. the
+ * handler is installed without SA_RESTART, so that the blocking system call is
+ * interrupted.
+ */
+static int watch_terminate_lua(lua_State *L)
+{
+    struct sigaction sa = {0};
+
+    sa.sa_handler = on_terminate;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGTERM, &sa, NULL) == -1 ||
+        sigaction(SIGINT, &sa, NULL) == -1 ||
+        sigprocmask(SIG_SETMASK, &ORIGINAL_SIGSET, NULL) == -1) {
+        return push_errno(L, "sigaction");
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int is_terminated_lua(lua_State *L)
+{
+    lua_pushboolean(L, TERMINATED);
+    return 1;
+}
+
+static int ncpu_lua(lua_State *L)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    lua_pushinteger(L, n > 0 ? n : 1);
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_process(lua_State *L)
+{
+    struct luaL_Reg funcs[] = {
+        {"fork",            fork_lua           },
+        {"getpid",          getpid_lua         },
+        {"kill",            kill_lua           },
+        {"reap",            reap_lua           },
+        {"sigblock",        sigblock_lua       },
+        {"sigunblock",      sigunblock_lua     },
+        {"sigwait",         sigwait_lua        },
+        {"watch_terminate", watch_terminate_lua},
+        {"is_terminated",   is_terminated_lua  },
+        {"ncpu",            ncpu_lua           },
+        {NULL,              NULL               }
+    };
+
+    sigemptyset(&SUPERVISOR_SIGSET);
+    sigaddset(&SUPERVISOR_SIGSET, SIGCHLD);
+    sigaddset(&SUPERVISOR_SIGSET, SIGHUP);
+    sigaddset(&SUPERVISOR_SIGSET, SIGINT);
+    sigaddset(&SUPERVISOR_SIGSET, SIGTERM);
+    sigemptyset(&ORIGINAL_SIGSET);
+
+    lua_createtable(L, 0, 14);
+    for (struct luaL_Reg *ptr = funcs; ptr->name; ptr++) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+    }
+    lauxh_pushint2tbl(L, "SIGCHLD", SIGCHLD);
+    lauxh_pushint2tbl(L, "SIGHUP", SIGHUP);
+    lauxh_pushint2tbl(L, "SIGINT", SIGINT);
+    lauxh_pushint2tbl(L, "SIGKILL", SIGKILL);
+    lauxh_pushint2tbl(L, "SIGTERM", SIGTERM);
+    return 1;
+}
@@ -0,0 +1,240 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/scan.h
+ *  lua-net-http
+ */
+
+#ifndef lua_net_http_scan_h
+#define lua_net_http_scan_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * the scan functions return the number of leading bytes that are known to be
+ * valid, 16 or 32 bytes at a time. the returned position points to the byte
+ * that must be checked by the table-driven loop of the caller, or to the
+ * trailing bytes that are shorter than the vector size.
+ *
+ * scan_vchar skips the field-content bytes (SP and VCHAR).
+ * scan_tchar skips the common token bytes (ALPHA, DIGIT, "-" and "_").
+ *
+ * the vectorized path can be disabled by defining NET_HTTP_NO_SIMD.
+ */
+typedef size_t (*scan_fn)(const unsigned char *str, size_t len);
+
+static size_t scan_none(const unsigned char *str, size_t len)
+{
+    (void)str;
+    (void)len;
+    return 0;
+}
+
+static scan_fn scan_vchar    = scan_none;
+static scan_fn scan_tchar    = scan_none;
+static const char *SCAN_IMPL = "none";
+
+#if !defined(NET_HTTP_NO_SIMD) && defined(__x86_64__) &&                       \
+    (defined(__GNUC__) || defined(__clang__))
+# include <immintrin.h>
+
+// SSE2 is always available on x86-64
+static inline __m128i sse2_inrange(__m128i v, char lo, char n)
+{
+    __m128i x = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(n - 1)), x);
+}
+
+static size_t scan_vchar_sse2(const unsigned char *str, size_t len)
+{
+    const __m128i sp  = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    size_t pos        = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(str + pos));
+        // bytes greater than 0x7F are negative in the signed comparison
+        __m128i m = _mm_or_si128(_mm_cmplt_epi8(v, sp), _mm_cmpeq_epi8(v, del));
+        int bits  = _mm_movemask_epi8(m);
+        if (bits) {
+            return pos + __builtin_ctz(bits);
+        }
+    }
+    return pos;
+}
+
+static size_t scan_tchar_sse2(const unsigned char *str, size_t len)
+{
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i dash  = _mm_set1_epi8('-');
+    const __m128i uscr  = _mm_set1_epi8('_');
+    size_t pos          = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(str + pos));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(sse2_inrange(_mm_or_si128(v, lower), 'a', 26),
+                         sse2_inrange(v, '0', 10)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, dash), _mm_cmpeq_epi8(v, uscr)));
+        int bits = ~_mm_movemask_epi8(m) & 0xFFFF;
+        if (bits) {
+            return pos + __builtin_ctz(bits);
+        }
+    }
+    return pos;
+}
+
+// AVX2 is selected at runtime
+# define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static inline __m256i avx2_inrange(__m256i v, char lo, char n)
+{
+    __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(n - 1)), x);
+}
+
+AVX2_TARGET static size_t scan_vchar_avx2(const unsigned char *str,
+                                          size_t len)
+{
+    const __m256i sp  = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    size_t pos        = 0;
+
+    for (; pos + 32 <= len; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(str + pos));
+        __m256i m = _mm256_or_si256(_mm256_cmpgt_epi8(sp, v),
+                                    _mm256_cmpeq_epi8(v, del));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(m);
+        if (bits) {
+            return pos + __builtin_ctz(bits);
+        }
+    }
+    return pos + scan_vchar_sse2(str + pos, len - pos);
+}
+
+AVX2_TARGET static size_t scan_tchar_avx2(const unsigned char *str,
+                                          size_t len)
+{
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i dash  = _mm256_set1_epi8('-');
+    const __m256i uscr  = _mm256_set1_epi8('_');
+    size_t pos          = 0;
+
+    for (; pos + 32 <= len; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(str + pos));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(avx2_inrange(_mm256_or_si256(v, lower), 'a', 26),
+                            avx2_inrange(v, '0', 10)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, dash),
+                            _mm256_cmpeq_epi8(v, uscr)));
+        uint32_t bits = ~(uint32_t)_mm256_movemask_epi8(m);
+        if (bits) {
+            return pos + __builtin_ctz(bits);
+        }
+    }
+    return pos + scan_tchar_sse2(str + pos, len - pos);
+}
+
+static void init_scan(void)
+{
+    scan_vchar = scan_vchar_sse2;
+    scan_tchar = scan_tchar_sse2;
+    SCAN_IMPL  = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_vchar = scan_vchar_avx2;
+        scan_tchar = scan_tchar_avx2;
+        SCAN_IMPL  = "avx2";
+    }
+}
+
+#elif !defined(NET_HTTP_NO_SIMD) && defined(__aarch64__) &&                    \
+    defined(__ARM_NEON)
+# include <arm_neon.h>
+
+// NEON is always available on arm64
+static inline size_t neon_first(uint8x16_t m)
+{
+    // narrow each byte of the mask to 4 bits
+    uint64_t bits = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    return __builtin_ctzll(bits) >> 2;
+}
+
+static size_t scan_vchar_neon(const unsigned char *str, size_t len)
+{
+    const uint8x16_t sp  = vdupq_n_u8(0x20);
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+    size_t pos           = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        uint8x16_t v = vld1q_u8(str + pos);
+        uint8x16_t m = vorrq_u8(vcltq_u8(v, sp), vcgeq_u8(v, del));
+        if (vmaxvq_u8(m)) {
+            return pos + neon_first(m);
+        }
+    }
+    return pos;
+}
+
+static size_t scan_tchar_neon(const unsigned char *str, size_t len)
+{
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    const uint8x16_t a     = vdupq_n_u8('a');
+    const uint8x16_t n26   = vdupq_n_u8(26);
+    const uint8x16_t d0    = vdupq_n_u8('0');
+    const uint8x16_t n10   = vdupq_n_u8(10);
+    const uint8x16_t dash  = vdupq_n_u8('-');
+    const uint8x16_t uscr  = vdupq_n_u8('_');
+    size_t pos             = 0;
+
+    for (; pos + 16 <= len; pos += 16) {
+        uint8x16_t v = vld1q_u8(str + pos);
+        uint8x16_t m = vorrq_u8(
+            vorrq_u8(vcltq_u8(vsubq_u8(vorrq_u8(v, lower), a), n26),
+                     vcltq_u8(vsubq_u8(v, d0), n10)),
+            vorrq_u8(vceqq_u8(v, dash), vceqq_u8(v, uscr)));
+        m = vmvnq_u8(m);
+        if (vmaxvq_u8(m)) {
+            return pos + neon_first(m);
+        }
+    }
+    return pos;
+}
+
+static void init_scan(void)
+{
+    scan_vchar = scan_vchar_neon;
+    scan_tchar = scan_tchar_neon;
+    SCAN_IMPL  = "neon";
+}
+
+#else
+
+static void init_scan(void)
+{
+    // use the lookup tables only
+}
+
+#endif
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/serialize.c
+ *  lua-net-http
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+// lua
+#include <lauxhlib.h>
+
+/**
+ * header_fields calls the fn for each field-name and field-value pair of the
+ * net.http.header dict at the index, and returns the number of bytes of the
+ * header-fields.
+ *
+ *  header-field = field-name ":" OWS field-value OWS CRLF
+ */
+typedef void (*field_fn)(void *ctx, const char *key, size_t klen,
+                         const char *val, size_t vlen);
+
+static size_t header_fields(lua_State *L, int idx, field_fn fn, void *ctx)
+{
+    size_t total = 0;
+    size_t nitem = lauxh_rawlen(L, idx);
+
+    for (size_t i = 1; i <= nitem; i++) {
+        const char *key = NULL;
+        size_t klen     = 0;
+        size_t nval     = 0;
+
+        // item = { idx = <integer>, key = <string>, val = { <string>, ... } }
+        lua_rawgeti(L, idx, i);
+        if (lua_type(L, -1) != LUA_TTABLE) {
+            luaL_error(L, "invalid header item#%d", (int)i);
+        }
+        lua_pushliteral(L, "key");
+        lua_rawget(L, -2);
+        lua_pushliteral(L, "val");
+        lua_rawget(L, -3);
+        if (lua_type(L, -2) != LUA_TSTRING || lua_type(L, -1) != LUA_TTABLE) {
+            luaL_error(L, "invalid header item#%d", (int)i);
+        }
+        key  = lua_tolstring(L, -2, &klen);
+        nval = lauxh_rawlen(L, -1);
+        for (size_t j = 1; j <= nval; j++) {
+            const char *val = NULL;
+            size_t vlen     = 0;
+
+            lua_rawgeti(L, -1, j);
+            if (lua_type(L, -1) != LUA_TSTRING) {
+                luaL_error(L, "invalid header item#%d value#%d", (int)i, (int)j);
+            }
+            val = lua_tolstring(L, -1, &vlen);
+            if (fn) {
+                fn(ctx, key, klen, val, vlen);
+            }
+            // field-name ": " field-value CRLF
+            total += klen + vlen + 4;
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 3);
+    }
+
+    return total;
+}
+
+static void copy_field(void *ctx, const char *key, size_t klen,
+                       const char *val, size_t vlen)
+{
+    char **ptr = (char **)ctx;
+    char *p    = *ptr;
+
+    memcpy(p, key, klen);
+    p += klen;
+    *p++ = ':';
+    *p++ = ' ';
+    memcpy(p, val, vlen);
+    p += vlen;
+    *p++ = '\r';
+    *p++ = '\n';
+    *ptr = p;
+}
+
+#define SCRATCH_MT "net.http.serialize.scratch"
+
+// initial capacity of the scratch buffer
+#define SCRATCH_MINSIZE 1024
+
+/**
+ * scratch_t is the buffer that the header is built in. it is held as an
+ * upvalue of the header function and grows to the largest header, so that
+ * serializing a header does not allocate except for the resulting string.
+ */
+typedef struct {
+    char *mem;
+    size_t cap;
+} scratch_t;
+
+static char *scratch_reserve(lua_State *L, scratch_t *s, size_t n)
+{
+    if (n > s->cap) {
+        size_t cap = s->cap ? s->cap : SCRATCH_MINSIZE;
+        char *mem  = NULL;
+
+        while (cap < n) {
+            cap *= 2;
+        }
+        mem = realloc(s->mem, cap);
+        if (!mem) {
+            luaL_error(L, "failed to allocate %d bytes", (int)cap);
+        }
+        s->mem = mem;
+        s->cap = cap;
+    }
+    return s->mem;
+}
+
+static int scratch_gc(lua_State *L)
+{
+    scratch_t *s = lua_touserdata(L, 1);
+
+    free(s->mem);
+    s->mem = NULL;
+    s->cap = 0;
+    return 0;
+}
+
+/**
+ * header serializes the first-line, the pre-serialized header-fields block and
+ * the header-fields of the net.http.header dict into a string. the size of the
+ * string is calculated first, and the string is built in the scratch buffer
+ * without reallocation.
+ */
+static int header_lua(lua_State *L)
+{
+    scratch_t *s      = lua_touserdata(L, lua_upvalueindex(1));
+    size_t len        = 0;
+    const char *line  = NULL;
+    size_t blen       = 0;
+    const char *block = NULL;
+    size_t total      = 0;
+    char *buf         = NULL;
+    char *ptr         = NULL;
+
+    lauxh_checktable(L, 1);
+    line  = lauxh_optlstring(L, 2, "", &len);
+    block = lauxh_optlstring(L, 3, "", &blen);
+    lua_settop(L, 3);
+
+    // first-line + block + header-fields + CRLF
+    total = len + blen + header_fields(L, 1, NULL, NULL) + 2;
+    buf   = scratch_reserve(L, s, total);
+    ptr   = buf;
+    memcpy(ptr, line, len);
+    ptr += len;
+    memcpy(ptr, block, blen);
+    ptr += blen;
+    header_fields(L, 1, copy_field, &ptr);
+    *ptr++ = '\r';
+    *ptr++ = '\n';
+    lua_pushlstring(L, buf, total);
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_serialize(lua_State *L)
+{
+    scratch_t *s = NULL;
+
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "header");
+    s = lua_newuserdata(L, sizeof(scratch_t));
+    memset(s, 0, sizeof(scratch_t));
+    if (luaL_newmetatable(L, SCRATCH_MT)) {
+        lauxh_pushfn2tbl(L, "__gc", scratch_gc);
+    }
+    lua_setmetatable(L, -2);
+    lua_pushcclosure(L, header_lua, 1);
+    lua_rawset(L, -3);
+    return 1;
+}
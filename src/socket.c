@@ -0,0 +1,140 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/socket.c
+ *  lua-net-http
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+// lua
+#include <lauxhlib.h>
+
+/**
+ * is_alive returns true if the idle socket can be reused. the socket cannot be
+ * reused if the peer has closed the connection, an error has occurred, or
+ * unexpected bytes have been received.
+ */
+static int is_alive_lua(lua_State *L)
+{
+    int fd     = (int)lauxh_checkinteger(L, 1);
+    char c     = 0;
+    ssize_t rv = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    if (rv == -1) {
+        // no bytes received
+        lua_pushboolean(L, errno == EAGAIN || errno == EWOULDBLOCK);
+        return 1;
+    }
+    // closed by peer (0) or unexpected bytes
+    lua_pushboolean(L, 0);
+    return 1;
+}
+
+/**
+ * poll waits until one of the sockets becomes readable, or the msec
+ * milliseconds elapse. the socket that has been closed or has an error is
+ * also returned as readable, so that the caller can read the error.
+ * it returns an array of the ready sockets, that is empty on timeout.
+ */
+static int poll_lua(lua_State *L)
+{
+    size_t nfd         = 0;
+    int msec           = 0;
+    struct pollfd *fds = NULL;
+    int rv             = 0;
+
+    lauxh_checktable(L, 1);
+    msec = (int)lauxh_optinteger(L, 2, -1);
+    nfd  = lauxh_rawlen(L, 1);
+    fds  = lua_newuserdata(L, sizeof(struct pollfd) * (nfd ? nfd : 1));
+    for (size_t i = 0; i < nfd; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        fds[i] = (struct pollfd){
+            .fd     = (int)lauxh_checkinteger(L, -1),
+            .events = POLLIN,
+        };
+        lua_pop(L, 1);
+    }
+
+    rv = poll(fds, nfd, msec);
+    if (rv == -1 && errno != EINTR) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+
+    lua_createtable(L, rv > 0 ? rv : 0, 0);
+    for (size_t i = 0, n = 1; rv > 0 && i < nfd; i++) {
+        if (fds[i].revents) {
+            lauxh_pushint2arr(L, n++, fds[i].fd);
+        }
+    }
+    return 1;
+}
+
+/**
+ * clock returns the milliseconds of the monotonic clock.
+ */
+static int clock_lua(lua_State *L)
+{
+    struct timespec ts = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    lua_pushinteger(L, (lua_Integer)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    return 1;
+}
+
+/**
+ * hrtime returns the nanoseconds of the monotonic clock.
+ */
+static int hrtime_lua(lua_State *L)
+{
+    struct timespec ts = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    lua_pushinteger(L, (lua_Integer)ts.tv_sec * 1000000000 + ts.tv_nsec);
+    return 1;
+}
+
+/**
+ * getpid returns the process id of the calling process.
+ */
+static int getpid_lua(lua_State *L)
+{
+    lua_pushinteger(L, getpid());
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_socket(lua_State *L)
+{
+    lua_createtable(L, 0, 5);
+    lauxh_pushfn2tbl(L, "is_alive", is_alive_lua);
+    lauxh_pushfn2tbl(L, "poll", poll_lua);
+    lauxh_pushfn2tbl(L, "clock", clock_lua);
+    lauxh_pushfn2tbl(L, "hrtime", hrtime_lua);
+    lauxh_pushfn2tbl(L, "getpid", getpid_lua);
+    return 1;
+}
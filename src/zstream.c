@@ -0,0 +1,206 @@
+/**
+ *  Copyright (C) 2022 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ *
+ *  src/zstream.c
+ *  lua-net-http
+ */
+
+
+#include <string.h>
+#include <zlib.h>
+// lua
+#include <lauxhlib.h>
+
+#define ZSTREAM_MT "net.http.zstream"
+
+typedef struct {
+    z_stream strm;
+    int active;
+} zstream_t;
+
+static inline zstream_t *checkzstream(lua_State *L)
+{
+    zstream_t *z = luaL_checkudata(L, 1, ZSTREAM_MT);
+    if (!z->active) {
+        luaL_error(L, "attempt to use a finished zstream");
+    }
+    return z;
+}
+
+/**
+ * deflate_lua compresses the input of the stream into the buffer of lua, and
+ * pushes the compressed bytes. the output is produced in the blocks of
+ * LUAL_BUFFERSIZE bytes, so that the working memory is bounded regardless of
+ * the size of the input.
+ */
+static int deflate_lua(lua_State *L, zstream_t *z, int flush)
+{
+    z_stream *strm = &z->strm;
+    luaL_Buffer b;
+    int rc = Z_OK;
+
+    luaL_buffinit(L, &b);
+    do {
+        strm->next_out  = (Bytef *)luaL_prepbuffer(&b);
+        strm->avail_out = LUAL_BUFFERSIZE;
+        rc              = deflate(strm, flush);
+        if (rc == Z_STREAM_ERROR) {
+            lua_pushnil(L);
+            lua_pushfstring(L, "deflate: %s",
+                            strm->msg ? strm->msg : "stream error");
+            return 2;
+        }
+        luaL_addsize(&b, LUAL_BUFFERSIZE - strm->avail_out);
+    } while (strm->avail_out == 0 ||
+             (flush == Z_FINISH && rc != Z_STREAM_END));
+    luaL_pushresult(&b);
+    return 1;
+}
+
+/**
+ * update compresses the data, and returns the compressed bytes that are
+ * available so far. it may return an empty string.
+ */
+static int update_lua(lua_State *L)
+{
+    zstream_t *z    = checkzstream(L);
+    size_t len      = 0;
+    const char *str = lauxh_checklstring(L, 2, &len);
+
+    z->strm.next_in  = (Bytef *)str;
+    z->strm.avail_in = (uInt)len;
+    return deflate_lua(L, z, Z_NO_FLUSH);
+}
+
+/**
+ * flush returns the pending compressed bytes, so that the receiver can
+ * decompress all the data passed so far.
+ */
+static int flush_lua(lua_State *L)
+{
+    zstream_t *z = checkzstream(L);
+
+    z->strm.next_in  = NULL;
+    z->strm.avail_in = 0;
+    return deflate_lua(L, z, Z_SYNC_FLUSH);
+}
+
+/**
+ * finish returns the rest of the compressed bytes with the trailer of the
+ * format, and releases the stream.
+ */
+static int finish_lua(lua_State *L)
+{
+    zstream_t *z = checkzstream(L);
+    int rv       = 0;
+
+    z->strm.next_in  = NULL;
+    z->strm.avail_in = 0;
+    rv               = deflate_lua(L, z, Z_FINISH);
+    deflateEnd(&z->strm);
+    z->active = 0;
+    return rv;
+}
+
+static int close_lua(lua_State *L)
+{
+    zstream_t *z = luaL_checkudata(L, 1, ZSTREAM_MT);
+
+    if (z->active) {
+        deflateEnd(&z->strm);
+        z->active = 0;
+    }
+    return 0;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, ZSTREAM_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+/**
+ * new creates the stream that compresses the data into the format of the
+ * content-coding. the gzip format has the gzip header, and the deflate format
+ * is the zlib format as defined in RFC 9110 section 8.4.1.
+ */
+static int new_lua(lua_State *L)
+{
+    static const char *const encodings[] = {"gzip", "deflate", NULL};
+    int encoding                         = luaL_checkoption(L, 1, NULL,
+                                                            encodings);
+    int level    = (int)lauxh_optinteger(L, 2, Z_DEFAULT_COMPRESSION);
+    zstream_t *z = NULL;
+
+    if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) {
+        return lauxh_argerror(L, 2, "level must be integer between -1 and 9");
+    }
+
+    z = lua_newuserdata(L, sizeof(zstream_t));
+    memset(z, 0, sizeof(zstream_t));
+    if (deflateInit2(&z->strm, level, Z_DEFLATED,
+                     encoding == 0 ? MAX_WBITS + 16 : MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "deflateInit2: %s",
+                        z->strm.msg ? z->strm.msg : "failed to initialize");
+        return 2;
+    }
+    z->active = 1;
+    lauxh_setmetatable(L, ZSTREAM_MT);
+    return 1;
+}
+
+LUALIB_API int luaopen_net_http_zstream(lua_State *L)
+{
+    struct luaL_Reg mmethods[] = {
+        {"__gc",       close_lua   },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg methods[] = {
+        {"update", update_lua},
+        {"flush",  flush_lua },
+        {"finish", finish_lua},
+        {"close",  close_lua },
+        {NULL,     NULL      }
+    };
+    struct luaL_Reg *ptr = mmethods;
+
+    luaL_newmetatable(L, ZSTREAM_MT);
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_pushliteral(L, "__index");
+    lua_newtable(L);
+    ptr = methods;
+    while (ptr->name) {
+        lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        ptr++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 1);
+    lauxh_pushfn2tbl(L, "new", new_lua);
+    return 1;
+}
@@ -0,0 +1,46 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local alloc = require('net.http.alloc')
+
+function testcase.after_each()
+    alloc.stop()
+end
+
+function testcase.start_stop()
+    -- test that install the counting allocator
+    assert.is_true(alloc.start())
+
+    -- test that returns false if already installed
+    assert.is_false(alloc.start())
+
+    -- test that restore the original allocator
+    assert.is_true(alloc.stop())
+    assert.is_false(alloc.stop())
+end
+
+function testcase.count()
+    assert(alloc.start())
+    collectgarbage('stop')
+
+    -- test that count the allocations
+    alloc.reset()
+    local list = {}
+    for i = 1, 10 do
+        list[i] = {}
+    end
+    local nalloc, nbytes = alloc.count()
+    assert.greater_or_equal(nalloc, 10)
+    assert.greater_or_equal(nbytes, 10)
+
+    -- test that the counters are not updated after stop
+    assert(alloc.stop())
+    alloc.reset()
+    for i = 1, 10 do
+        list[i] = {}
+    end
+    collectgarbage('restart')
+    nalloc, nbytes = alloc.count()
+    assert.equal(nalloc, 0)
+    assert.equal(nbytes, 0)
+end
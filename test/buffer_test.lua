@@ -0,0 +1,119 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local new_buffer = require('net.http.buffer').new
+
+function testcase.new()
+    -- test that create new buffer
+    local b = new_buffer()
+    assert.match(tostring(b), '^net.http.buffer: ', false)
+    assert.equal(b:size(), 0)
+    assert.equal(#b, 0)
+
+    -- test that create new buffer with initial capacity
+    b = new_buffer(8192)
+    assert.equal(b:size(), 0)
+end
+
+function testcase.write()
+    local b = new_buffer()
+
+    -- test that append data and returns the number of unread bytes
+    assert.equal(b:write('hello'), 5)
+    assert.equal(b:write(' world'), 11)
+    assert.equal(b:peek(), 'hello world')
+
+    -- test that extend the buffer
+    local data = string.rep('x', 10000)
+    assert.equal(b:write(data), 10011)
+    assert.equal(b:peek(), 'hello world' .. data)
+end
+
+function testcase.prepend()
+    local b = new_buffer()
+    b:write('world')
+
+    -- test that prepend data
+    assert.equal(b:prepend('hello '), 11)
+    assert.equal(b:peek(), 'hello world')
+
+    -- test that prepend data into the consumed space
+    b:consume(6)
+    assert.equal(b:prepend('HELLO '), 11)
+    assert.equal(b:peek(), 'HELLO world')
+end
+
+function testcase.peek()
+    local b = new_buffer()
+    b:write('hello world')
+
+    -- test that returns the unread bytes without consuming
+    assert.equal(b:peek(5), 'hello')
+    assert.equal(b:peek(5, 6), 'world')
+    assert.equal(b:peek(100, 6), 'world')
+    assert.equal(b:size(), 11)
+
+    -- test that returns nil if no bytes in the range
+    assert.is_nil(b:peek(5, 11))
+    assert.is_nil(new_buffer():peek())
+end
+
+function testcase.read()
+    local b = new_buffer()
+    b:write('hello world')
+
+    -- test that returns the unread bytes and consumes them
+    assert.equal(b:read(6), 'hello ')
+    assert.equal(b:size(), 5)
+    assert.equal(b:read(), 'world')
+    assert.equal(b:size(), 0)
+
+    -- test that returns nil if buffer is empty
+    assert.is_nil(b:read())
+end
+
+function testcase.consume()
+    local b = new_buffer()
+    b:write('hello world')
+
+    -- test that consume the unread bytes
+    assert.equal(b:consume(6), 6)
+    assert.equal(b:peek(), 'world')
+
+    -- test that consume the remaining bytes
+    assert.equal(b:consume(100), 5)
+    assert.equal(b:size(), 0)
+end
+
+function testcase.find()
+    local b = new_buffer()
+    b:write('foo\r\nbar\r\n')
+
+    -- test that find the position of the bytes
+    assert.equal({
+        b:find('\r\n'),
+    }, {
+        4,
+        5,
+    })
+    assert.equal({
+        b:find('\r\n', 5),
+    }, {
+        9,
+        10,
+    })
+
+    -- test that returns nil if not found
+    assert.is_nil(b:find('baz'))
+    assert.is_nil(b:find('\r\n', 10))
+end
+
+function testcase.reset()
+    local b = new_buffer()
+    b:write('hello world')
+
+    -- test that discard the unread bytes
+    b:reset()
+    assert.equal(b:size(), 0)
+    assert.is_nil(b:peek())
+end
@@ -0,0 +1,164 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local compress = require('net.http.compress')
+local new_reader = require('net.http.reader').new
+local new_content = require('net.http.content').new
+
+function testcase.negotiate()
+    -- test that select the acceptable content-coding
+    for _, v in ipairs({
+        {
+            val = 'gzip, deflate, br',
+            exp = 'gzip',
+        },
+        {
+            val = 'deflate',
+            exp = 'deflate',
+        },
+        {
+            val = 'gzip;q=0.5, deflate;q=0.8',
+            exp = 'deflate',
+        },
+        {
+            val = 'x-gzip',
+            exp = 'gzip',
+        },
+        {
+            val = '*',
+            exp = 'gzip',
+        },
+        {
+            val = 'gzip;q=0, *',
+            exp = 'deflate',
+        },
+        {
+            val = {
+                'br',
+                'GZIP',
+            },
+            exp = 'gzip',
+        },
+        {
+            val = 'identity, br',
+        },
+        {
+            val = 'gzip;q=0, deflate;q=0',
+        },
+        {},
+    }) do
+        assert.equal(compress.negotiate(v.val), v.exp)
+    end
+
+    -- test that select from the candidates
+    assert.is_nil(compress.negotiate('deflate', {
+        'gzip',
+    }))
+end
+
+function testcase.is_compressible()
+    -- test that return true if the content type is compressible
+    for _, v in ipairs({
+        'text/html',
+        'text/plain; charset=utf-8',
+        'application/json',
+        'application/problem+json',
+        'image/svg+xml',
+    }) do
+        assert.is_true(compress.is_compressible(v))
+    end
+
+    -- test that return false if the content type is already compressed
+    for _, v in ipairs({
+        'image/png',
+        'application/gzip',
+        'application/octet-stream',
+        'text/event-stream',
+        '',
+    }) do
+        assert.is_false(compress.is_compressible(v))
+    end
+    assert.is_false(compress.is_compressible())
+end
+
+function testcase.compress()
+    local data = string.rep('hello world! ', 100)
+
+    -- test that compress data into gzip format
+    local s = assert(compress.compress('gzip', data))
+    assert.equal(s:sub(1, 2), '\31\139')
+    assert.less(#s, #data)
+
+    -- test that compress data into zlib format
+    s = assert(compress.compress('deflate', data, 9))
+    assert.equal(s:byte(1), 0x78)
+    assert.less(#s, #data)
+
+    -- test that throws an error if encoding is not supported
+    local err = assert.throws(compress.compress, 'br', data)
+    assert.match(err, 'invalid option')
+end
+
+function testcase.write_chunk()
+    local data = string.rep('hello world! ', 1000)
+    local rctx = {
+        msg = data,
+        read = function(self, n)
+            if #self.msg > 0 then
+                local s = string.sub(self.msg, 1, n)
+                self.msg = string.sub(self.msg, n + 1)
+                return s
+            end
+        end,
+    }
+    local chunks = {}
+    local w = {
+        write = function(_, s)
+            chunks[#chunks + 1] = s
+            return #s
+        end,
+    }
+
+    -- test that write content as compressed chunks
+    local c = new_content(new_reader(rctx), #data)
+    local h = assert(compress.new('gzip'))
+    assert.equal(c:write(w, 1024, h), #data)
+    assert.match(chunks[1], '^%x+\r\n\31\139', false)
+    assert.equal(chunks[#chunks - 1], '0\r\n')
+    assert.equal(chunks[#chunks], '\r\n')
+
+    -- test that the compressed chunks are smaller than the content
+    local size = 0
+    for i = 1, #chunks - 2 do
+        local len, body = chunks[i]:match('^(%x+)\r\n(.*)\r\n$')
+        assert.equal(tonumber(len, 16), #body)
+        size = size + #body
+    end
+    assert.less(size, #data)
+end
+
+function testcase.without_zstream()
+    -- test that no content-coding is negotiated without net.http.zstream
+    package.loaded['net.http.compress'] = nil
+    local zstream = package.loaded['net.http.zstream']
+    package.loaded['net.http.zstream'] = nil
+    package.preload['net.http.zstream'] = function()
+        assert(false, 'module not found')
+    end
+    local ok, m = pcall(require, 'net.http.compress')
+    package.preload['net.http.zstream'] = nil
+    package.loaded['net.http.zstream'] = zstream
+    package.loaded['net.http.compress'] = compress
+    assert(ok, m)
+    assert.is_nil(m.negotiate('gzip, deflate'))
+
+    -- test that the explicit candidates are still negotiated
+    assert.equal(m.negotiate('gzip', {
+        'gzip',
+    }), 'gzip')
+
+    -- test that compress() returns an error
+    local data, err = m.compress('gzip', 'hello')
+    assert.is_nil(data)
+    assert.match(tostring(err), 'net.http.zstream is not installed')
+end
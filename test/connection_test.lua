@@ -78,6 +78,59 @@ function testcase.flush()
     assert.match(err, 'write error')
 end
 
+function testcase.sendfile()
+    local f = assert(io.tmpfile())
+    f:write(string.rep('x', 1024 * 16))
+    local sent = {}
+    local c = new_connection({
+        read = function()
+        end,
+        write = function(_, s)
+            return #s
+        end,
+        sendfile = function(_, _, len, offset)
+            -- send 4096 bytes, then timeout after sending 100 bytes
+            if #sent == 1 then
+                sent[2] = offset
+                return 100, nil, true
+            end
+            sent[1] = offset
+            return len < 4096 and len or 4096
+        end,
+    })
+
+    -- test that returns the bytes already sent with the timeout
+    local n, err, timeout = c:sendfile(f, 1024 * 16, 10)
+    assert.equal(n, 4196)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert.equal(sent, {
+        10,
+        4106,
+    })
+
+    -- test that returns the bytes written before the timeout without sendfile
+    local nwrite = 0
+    c = new_connection({
+        read = function()
+        end,
+        write = function(_, s)
+            nwrite = nwrite + 1
+            if nwrite > 1 then
+                return nil, nil, true
+            end
+            return #s
+        end,
+    })
+    c.writer:setbufsize(0)
+    f:write(string.rep('x', 1024 * 64))
+    n, err, timeout = c:sendfile(f, 1024 * 70, 10)
+    -- the file is read in 64 KiB and the second write is timed out
+    assert.equal(n, 1024 * 64)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+end
+
 function testcase.read_request()
     local data = table.concat({
         'POST /foo/bar/baz HTTP/1.1',
@@ -309,6 +362,350 @@ function testcase.read_request()
     assert(error.is(err, parse.EMETHOD))
 end
 
+function testcase.read_request_discard()
+    local data = table.concat({
+        'POST /foo/bar/baz HTTP/1.1',
+        'Host: www.example.com',
+        'Content-Type: application/x-www-form-urlencoded',
+        'Content-Length: 4',
+        '',
+        'q=42',
+        '',
+        '',
+        'GET /hello/world HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        '',
+    }, '\r\n')
+    local c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function()
+        end,
+    })
+
+    -- test that the previous content is discarded before the next request
+    -- on the keep-alive connection
+    local msg, err = c:read_request()
+    assert(msg ~= nil, 'msg is nil')
+    assert.is_nil(err)
+    assert(msg.content ~= nil, 'content is nil')
+    assert.is_true(c:is_keepalive())
+    local content = msg.content
+    msg, err = c:read_request()
+    assert.is_nil(err)
+    assert.is_true(content.is_consumed)
+    assert.contains(msg, {
+        method = 'GET',
+        uri = '/hello/world',
+    })
+end
+
+function testcase.has_pipelined()
+    local data = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'GET /bar HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'GET /baz HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        '',
+    }, '\r\n')
+    local writes = {}
+    local c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function(_, s)
+            writes[#writes + 1] = s
+            return #s
+        end,
+        writev = function(_, ...)
+            local s = table.concat({
+                ...,
+            })
+            writes[#writes + 1] = s
+            return #s
+        end,
+    })
+    local new_responder = require('net.http.responder').new
+
+    -- test that the responses of the pipelined requests are flushed at once
+    local paths = {}
+    repeat
+        local req = assert(c:read_request())
+        paths[#paths + 1] = req.uri
+        local res = new_responder(c)
+        assert(res:reply(200, 'hello ' .. req.uri))
+        if not c:has_pipelined() then
+            assert(res:flush())
+        end
+    until #paths == 3 or #writes > 0
+    assert.equal(paths, {
+        '/foo',
+        '/bar',
+        '/baz',
+    })
+    assert.equal(#writes, 1)
+    local _, nres = string.gsub(writes[1], 'HTTP/1.1 200 OK\r\n', '')
+    assert.equal(nres, 3)
+    assert.match(writes[1], 'hello /baz$', false)
+end
+
+function testcase.keepalive()
+    local data = table.concat({
+        'POST /foo HTTP/1.1',
+        'Host: www.example.com',
+        'Content-Length: 4',
+        '',
+        'q=42',
+        'GET /bar HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        '',
+        'GET /baz HTTP/1.0',
+        'Host: www.example.com',
+        'Connection: Keep-Alive',
+        '',
+        '',
+        'GET /qux HTTP/1.1',
+        'Host: www.example.com',
+        'Connection: foo, close',
+        '',
+        '',
+    }, '\r\n')
+    local c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function()
+        end,
+    })
+    local header = require('net.http.header')
+
+    -- test that HTTP/1.1 connection persists by default
+    local msg = assert(c:read_request())
+    assert.equal(msg.uri, '/foo')
+    assert.is_true(c:is_keepalive())
+
+    -- test that the pipelined request is detected after the content
+    assert.is_true(c:has_pipelined())
+    assert.equal(msg.content:read(), 'q=42')
+    assert.is_true(c:has_pipelined())
+
+    -- test that HTTP/1.0 connection persists with the keep-alive option
+    msg = assert(c:read_request())
+    assert.equal(msg.uri, '/bar')
+    msg = assert(c:read_request())
+    assert.equal(msg.uri, '/baz')
+    assert.is_true(c:is_keepalive())
+    local h = header.new()
+    c:set_connection_header(h)
+    assert.equal(h:get('Connection'), 'keep-alive')
+
+    -- test that the connection does not persist with the close option
+    msg = assert(c:read_request())
+    assert.equal(msg.uri, '/qux')
+    assert.is_false(c:is_keepalive())
+    assert.is_false(c:has_pipelined())
+    h = header.new()
+    c:set_connection_header(h)
+    assert.equal(h:get('Connection'), 'close')
+
+    -- test that the connection does not persist after the max requests
+    data = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'GET /bar HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        '',
+    }, '\r\n')
+    c = new_connection(c.sock)
+    c:set_max_requests(2)
+    assert(c:read_request())
+    assert.is_true(c:is_keepalive())
+    assert(c:read_request())
+    assert.is_false(c:is_keepalive())
+
+    -- test that wait for the next request with the idle timeout
+    local timeouts = {}
+    data = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        '',
+    }, '\r\n')
+    c = new_connection({
+        read = c.sock.read,
+        write = c.sock.write,
+        rcvtimeo = function(_, sec)
+            timeouts[#timeouts + 1] = sec
+            return 0
+        end,
+    })
+    c:set_idle_timeout(1.5)
+    assert(c:read_request())
+    local _, err, timeout = c:read_request()
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(timeouts, {
+        1.5,
+        0,
+    })
+
+    -- test that throws an error if argument is invalid
+    err = assert.throws(c.set_max_requests, c, 0)
+    assert.match(err, 'n must be integer greater than 0')
+    err = assert.throws(c.set_idle_timeout, c, -1)
+    assert.match(err, 'sec must be finite-number greater than 0')
+end
+
+function testcase.read_requests()
+    local data = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'POST /bar HTTP/1.1',
+        'Content-Length: 4',
+        '',
+        'q=42GET /baz HTTP/1.1',
+        'Content-Length: 5',
+        '',
+        'hello',
+    }, '\r\n')
+    local c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+
+            -- the last 3 bytes are received later
+            n = math.min(n, 131)
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function()
+        end,
+    })
+
+    -- test that read the pipelined requests at once
+    local reqs = assert(c:read_requests())
+    assert.equal(#reqs, 3)
+    assert.equal(reqs[1].path, '/foo')
+    assert.equal(reqs[1].header:get('host'), 'www.example.com')
+    assert.equal(reqs[2].path, '/bar')
+    assert.equal(reqs[2].content:read(), 'q=42')
+    -- the content that has not been received is read from the connection
+    assert.equal(reqs[3].path, '/baz')
+    assert.equal(reqs[3].content:readall(), 'hello')
+    assert.is_false(c:has_pipelined())
+
+    -- test that the invalid request is returned as an error by the next
+    -- read_request()
+    data = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'GET /bar HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'GET /ba<z HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        'GET /qux HTTP/1.1',
+        'Host: www.example.com',
+        '',
+        '',
+    }, '\r\n')
+    c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function()
+        end,
+    })
+    reqs = assert(c:read_requests())
+    assert.equal(#reqs, 2)
+    assert.equal(reqs[2].path, '/bar')
+    assert.is_true(c:is_keepalive())
+    assert.is_true(c:has_pipelined())
+    local req, err = c:read_request()
+    assert.is_nil(req)
+    assert(error.is(err, parse.EMSG))
+    -- the following request is not consumed
+    assert.match(c.reader.buf:peek(), '^GET /qux HTTP/1.1', false)
+
+    -- test that throws an error if max is invalid
+    err = assert.throws(c.read_requests, c, 0)
+    assert.match(err, 'max must be integer greater than 0')
+end
+
+function testcase.set_lazy_header()
+    local data = table.concat({
+        'POST /foo HTTP/1.1',
+        'Host: www.example.com',
+        'Content-Length: 4',
+        '',
+        'q=42',
+    }, '\r\n')
+    local c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function()
+        end,
+    })
+
+    -- test that the header of the received message is backed by the view
+    c:set_lazy_header(true)
+    local msg = assert(c:read_request())
+    assert.match(tostring(msg.header), '^net.http.header: ', false)
+    assert.match(tostring(msg.header.view), '^net.http.parse.headers: ', false)
+    assert.equal(msg.header:get('host'), 'www.example.com')
+    assert.equal(msg.content:read(), 'q=42')
+
+    -- test that throws an error if argument is not boolean
+    local err = assert.throws(c.set_lazy_header, c, 'true')
+    assert.match(err, 'enabled must be boolean')
+end
+
 function testcase.read_response()
     local data = table.concat({
         'HTTP/1.1 200 OK',
@@ -445,3 +842,40 @@ function testcase.read_response()
     assert(error.is(err, parse.EMSG))
 end
 
+function testcase.read_response_framing()
+    local data
+    local c = new_connection({
+        read = function()
+            local s = data
+            data = nil
+            return s
+        end,
+        write = function()
+        end,
+    })
+
+    -- test that the response to the HEAD request has no content
+    data = 'HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n'
+    local msg = assert(c:read_response('HEAD'))
+    assert.is_nil(msg.content)
+    assert.is_true(c:is_keepalive())
+
+    -- test that the 204 and 304 responses have no content
+    for _, code in ipairs({
+        204,
+        304,
+    }) do
+        data = 'HTTP/1.1 ' .. code .. ' X\r\nContent-Length: 5\r\n\r\n'
+        msg = assert(c:read_response())
+        assert.is_nil(msg.content)
+        assert.is_true(c:is_keepalive())
+    end
+
+    -- test that the connection does not persist if the content is delimited
+    -- by closing the connection
+    data = 'HTTP/1.1 200 OK\r\n\r\nhello'
+    msg = assert(c:read_response())
+    assert.is_nil(msg.content)
+    assert.is_false(c:is_keepalive())
+end
+
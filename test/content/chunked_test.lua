@@ -4,6 +4,7 @@ local assert = require('assert')
 local new_reader = require('net.http.reader').new
 local new_writer = require('net.http.writer').new
 local new_chunked_content = require('net.http.content.chunked').new
+local new_chunk_handler = require('net.http.content.chunked').new_handler
 
 function testcase.copy()
     local rctx = {
@@ -369,6 +370,52 @@ function testcase.write()
         '\r\n',
     }, '\r\n'))
 
+    -- test that write chunk-data without joining if writer supports writev
+    resetctx('hello world!')
+    local iov = {}
+    wctx.writev = function(self, ...)
+        iov[#iov + 1] = {
+            ...,
+        }
+        return self:write(table.concat({
+            ...,
+        }))
+    end
+    n, err = c:write(w)
+    wctx.writev = nil
+    assert.equal(n, 12)
+    assert.is_nil(err)
+    assert.equal(iov, {
+        {
+            'c\r\n',
+            'hello world!',
+            '\r\n',
+        },
+    })
+    assert.equal(wctx.msg, 'c\r\nhello world!\r\n0\r\n\r\n')
+
+    -- test that coalesce the small pieces into a chunk of chunksize
+    resetctx('hello world!')
+    local read = rctx.read
+    rctx.read = function(self)
+        return read(self, 1)
+    end
+    c:setcoalesce(true)
+    n, err = c:write(w, 5)
+    rctx.read = read
+    assert.equal(n, 12)
+    assert.is_nil(err)
+    assert.equal(wctx.msg, table.concat({
+        '5',
+        'hello',
+        '5',
+        ' worl',
+        '2',
+        'd!',
+        '0',
+        '\r\n',
+    }, '\r\n'))
+
     -- test that write with handler
     resetctx('hello world!')
     local h = {
@@ -442,5 +489,41 @@ function testcase.write()
     -- test that throws an error if chunksize is not greater than 0
     err = assert.throws(c.write, c, w, 0)
     assert.match(err, 'chunksize must be uint greater than 0')
+
+    -- test that throws an error if coalesce flag is not boolean
+    err = assert.throws(c.setcoalesce, c, 1)
+    assert.match(err, 'enabled must be boolean')
 end
 
+
+function testcase.write_chunk()
+    local wctx = {
+        msg = '',
+        write = function(self, s)
+            self.msg = self.msg .. s
+            return #s
+        end,
+        writev = function(self, ...)
+            self.msg = self.msg .. table.concat({
+                ...,
+            })
+            return #self.msg
+        end,
+    }
+    local w = new_writer(wctx)
+    w:setbufsize(0)
+    local h = new_chunk_handler()
+
+    -- test that write a chunk by writev
+    assert.equal(h:write_chunk(w, 'hello'), 10)
+    assert.equal(wctx.msg, '5\r\nhello\r\n')
+
+    -- test that returns the number of bytes written before the timeout
+    wctx.writev = function()
+        return 4, nil, true
+    end
+    local n, err, timeout = h:write_chunk(w, 'hello')
+    assert.equal(n, 4)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+end
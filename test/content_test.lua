@@ -219,3 +219,39 @@ function testcase.write()
     assert.is_nil(err)
 end
 
+
+function testcase.onconsumed()
+    local rctx = {
+        msg = 'hello world!',
+        read = function(self, n)
+            if #self.msg > 0 then
+                local s = string.sub(self.msg, 1, n)
+                self.msg = string.sub(self.msg, n + 1)
+                return s
+            end
+        end,
+    }
+    local r = new_reader(rctx)
+    local c = new_content(r, #rctx.msg)
+    local ncall = 0
+    local fn = function()
+        ncall = ncall + 1
+    end
+
+    -- test that function is called once when the content has been consumed
+    c:onconsumed(fn)
+    assert.equal(c:read(5), 'hello')
+    assert.equal(ncall, 0)
+    assert.equal(c:read(), ' world!')
+    assert.equal(ncall, 1)
+    assert.is_nil(c:read())
+    assert.equal(ncall, 1)
+
+    -- test that function is called immediately if already consumed
+    c:onconsumed(fn)
+    assert.equal(ncall, 2)
+
+    -- test that throws an error if fn is not function
+    local err = assert.throws(c.onconsumed, c, true)
+    assert.match(err, 'fn must be function')
+end
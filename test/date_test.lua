@@ -7,10 +7,13 @@ local date = require('net.http.date')
 function testcase.now()
     -- test that now() returns a date string
     local d = assert.is_string(date.now())
+    assert.match(d, '^%a%a%a, %d%d %a%a%a %d%d%d%d %d%d:%d%d:%d%d GMT$', false)
 
-    -- test that now() return same string
+    assert.equal(date.format(date.parse(d)), d)
+
+    -- test that now() refreshes a cached date string
     sleep(1.2)
-    assert.equal(date.now(), d)
+    assert.not_equal(date.now(), d)
 end
 
 function testcase.update()
@@ -28,3 +31,32 @@ function testcase.update()
     assert.equal(update, now2)
 end
 
+function testcase.format()
+    -- test that format() returns IMF-fixdate
+    assert.equal(date.format(0), 'Thu, 01 Jan 1970 00:00:00 GMT')
+    assert.equal(date.format(784111777), 'Sun, 06 Nov 1994 08:49:37 GMT')
+end
+
+function testcase.parse()
+    -- test that parse() returns the seconds since the epoch
+    for _, v in ipairs({
+        'Sun, 06 Nov 1994 08:49:37 GMT',
+        'Sunday, 06-Nov-94 08:49:37 GMT',
+        'Sun Nov  6 08:49:37 1994',
+    }) do
+        assert.equal(date.parse(v), 784111777)
+    end
+    assert.equal(date.parse('Sat, 29 Feb 2020 23:59:59 GMT'), 1583020799)
+
+    -- test that parse() returns nil if invalid format
+    for _, v in ipairs({
+        '',
+        'Sun, 06 Nov 1994 08:49:37 UTC',
+        'Sun, 6 Nov 1994 08:49:37 GMT',
+        'Sun, 06 Foo 1994 08:49:37 GMT',
+        'Sun Nov 6 08:49:37 1994',
+        'Sun, 06 Nov 1994 25:49:37 GMT',
+    }) do
+        assert.is_nil(date.parse(v))
+    end
+end
@@ -0,0 +1,232 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local fork = require('testcase.fork')
+local sleep = require('testcase.timer').sleep
+local new_inet_server = require('net.stream.inet').server.new
+local new_connection = require('net.http.connection').new
+local new_response = require('net.http.message.response').new
+local new_pool = require('net.http.pool').new
+local new_batch = require('net.http.fetch.batch').new
+
+--- create_server creates the server that responds the request-uri after the
+--- delay seconds.
+--- @param delay number
+--- @return string host
+local function create_server(delay)
+    local hostname = '127.0.0.1'
+    local server = assert(new_inet_server(hostname, 0, {
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(server:listen())
+    local port = assert(server:getsockname()):port()
+
+    local p = assert(fork())
+    if p:is_child() then
+        while true do
+            local peer = assert(server:accept())
+            local c = new_connection(peer)
+            local req = c:read_request()
+            while req do
+                sleep(delay)
+                local res = new_response()
+                assert(res:write(c, req.uri))
+                assert(c:flush())
+                req = c:read_request()
+            end
+            c:close()
+        end
+    end
+    server:close()
+    return hostname .. ':' .. port
+end
+
+function testcase.next()
+    local slow = create_server(0.2)
+    local fast = create_server(0)
+    local b = new_batch()
+
+    -- test that returns the responses in the order of arrival
+    local id1 = b:add('http://' .. slow .. '/slow')
+    local id2 = b:add('http://' .. fast .. '/fast')
+    assert.equal(b:size(), 2)
+
+    local id, res, err, timeout = b:next()
+    assert.equal(id, id2)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(res.status, 200)
+    assert.equal(res.content:read(), '/fast')
+
+    id, res, err, timeout = b:next()
+    assert.equal(id, id1)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(res.content:read(), '/slow')
+
+    -- test that returns nil if all the results have been returned
+    assert.equal(b:size(), 0)
+    assert.is_nil(b:next())
+end
+
+function testcase.deadline()
+    local slow = create_server(0.5)
+    local fast = create_server(0)
+    local b = new_batch()
+
+    -- test that the request that exceeds the deadline is timed out
+    local id1 = b:add('http://' .. slow .. '/slow', {
+        deadline = 100,
+    })
+    local id2 = b:add('http://' .. fast .. '/fast', {
+        deadline = 1000,
+    })
+    local results = {}
+    for _ = 1, 2 do
+        local id, res, err, timeout = b:next()
+        results[id] = {
+            res = res,
+            err = err,
+            timeout = timeout,
+        }
+    end
+    assert.is_nil(results[id1].res)
+    assert.is_nil(results[id1].err)
+    assert.is_true(results[id1].timeout)
+    assert.equal(results[id2].res.content:read(), '/fast')
+end
+
+function testcase.maxactive()
+    local host = create_server(0)
+    local pool = new_pool({
+        maxactive = 1,
+    })
+    local b = new_batch()
+
+    -- test that the request waits for the active connection to be released
+    local paths = {}
+    for _, path in ipairs({
+        '/foo',
+        '/bar',
+        '/baz',
+    }) do
+        paths[b:add('http://' .. host .. path, {
+            pool = pool,
+        })] = path
+    end
+    for _ = 1, 3 do
+        local id, res, err = b:next()
+        assert.is_nil(err)
+        assert.equal(res.content:read(), paths[id])
+    end
+    assert.is_nil(b:next())
+    pool:close()
+end
+
+function testcase.add()
+    local b = new_batch()
+
+    -- test that the invalid request is returned as the result
+    local id = b:add('http://127.0.0.1 /')
+    local rid, res, err, timeout = b:next()
+    assert.equal(rid, id)
+    assert.is_nil(res)
+    assert.is_nil(timeout)
+    assert.match(err, 'invalid uri character')
+
+    -- test that throws an error if uri is not string
+    err = assert.throws(b.add, b, true)
+    assert.match(err, 'uri must be string')
+
+    -- test that throws an error if opts.pool is invalid
+    err = assert.throws(b.add, b, 'http://127.0.0.1', {
+        pool = true,
+    })
+    assert.match(err, 'opts.pool must be net.http.pool or false')
+end
+
+function testcase.retry()
+    local hostname = '127.0.0.1'
+    local server = assert(new_inet_server(hostname, 0, {
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(server:listen())
+    local port = assert(server:getsockname()):port()
+    local host = hostname .. ':' .. port
+
+    -- create server that closes the connection when the path that starts
+    -- with /close arrives at the first time, as if the idle connection had
+    -- been timed out
+    local p = assert(fork())
+    if p:is_child() then
+        local nconn = 0
+        local seen = {}
+        while true do
+            local peer = assert(server:accept())
+            local c = new_connection(peer)
+            local nreq = 0
+            nconn = nconn + 1
+            local req = c:read_request()
+            while req do
+                nreq = nreq + 1
+                local body = req.content and req.content:read() or ''
+                if string.find(req.path, '^/close') and not seen[req.path] then
+                    seen[req.path] = true
+                    break
+                end
+                local res = new_response()
+                assert(res:write(c, table.concat({
+                    nconn,
+                    nreq,
+                    req.uri,
+                    body,
+                }, ':')))
+                assert(c:flush())
+                req = c:read_request()
+            end
+            c:close()
+        end
+    end
+    server:close()
+
+    local pool = new_pool()
+    local b = new_batch()
+    b:add('http://' .. host .. '/foo', {
+        pool = pool,
+        method = 'PUT',
+        content = 'foo',
+    })
+    local _, res = assert(b:next())
+    assert.equal(res.content:read(), '1:1:/foo:foo')
+
+    -- test that the idempotent request is sent again with the header on a
+    -- new connection if the pooled connection is closed by the peer
+    local id = b:add('http://' .. host .. '/close1', {
+        pool = pool,
+        method = 'PUT',
+        content = 'bar',
+    })
+    local rid, err, timeout
+    rid, res, err, timeout = b:next()
+    assert.equal(rid, id)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(res.content:read(), '2:1:/close1:bar')
+    assert.equal(pool:nactive('http|127.0.0.1|' .. port .. '|||'), 0)
+
+    -- test that the non-idempotent request is not sent again
+    id = b:add('http://' .. host .. '/close2', {
+        pool = pool,
+        method = 'POST',
+        content = 'baz',
+    })
+    rid, res, err, timeout = b:next()
+    assert.equal(rid, id)
+    assert.is_nil(res)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(pool:size('http|127.0.0.1|' .. port .. '|||'), 0)
+    pool:close()
+end
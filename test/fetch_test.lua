@@ -10,6 +10,8 @@ local new_inet_server = require('net.stream.inet').server.new
 local new_unix_server = require('net.stream.unix').server.new
 local new_response = require('net.http.message.response').new
 local new_content = require('net.http.content').new
+local new_connection = require('net.http.connection').new
+local new_pool = require('net.http.pool').new
 local now = require('net.http.date').now
 local fetch = require('net.http.fetch')
 
@@ -517,3 +519,253 @@ function testcase.fetch_via_sockfile()
     assert.match(err, 'opts.sockfile must be string')
 end
 
+
+function testcase.fetch_with_pool()
+    local hostname = '127.0.0.1'
+    local server = assert(new_inet_server(hostname, 0, {
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(server:listen())
+    local port = assert(server:getsockname()):port()
+    local host = hostname .. ':' .. port
+
+    -- create server that responds the number of accepted connections and
+    -- the number of requests on the connection
+    local p = assert(fork())
+    if p:is_child() then
+        local nconn = 0
+        while true do
+            local peer = assert(server:accept())
+            local c = new_connection(peer)
+            local nreq = 0
+            nconn = nconn + 1
+            while c:read_request() do
+                nreq = nreq + 1
+                local res = new_response()
+                assert(res:write(c, nconn .. ':' .. nreq))
+                assert(c:flush())
+            end
+            c:close()
+        end
+    end
+
+    -- test that the idle connection is reused
+    local pool = new_pool()
+    for i = 1, 3 do
+        local res = assert(fetch('http://' .. host, {
+            pool = pool,
+        }))
+        assert.equal(res.content:read(), '1:' .. i)
+        assert.equal(pool:size('http|127.0.0.1|' .. port .. '|||'), 1)
+    end
+
+    -- test that the connection is not reused if pool is false
+    local res = assert(fetch('http://' .. host, {
+        pool = false,
+    }))
+    assert.equal(res.content:read(), '2:1')
+
+    -- test that the connection is not reused if request has connection:close
+    res = assert(fetch('http://' .. host, {
+        pool = pool,
+        header = {
+            connection = 'close',
+        },
+    }))
+    assert.equal(res.content:read(), '1:4')
+    assert.equal(pool:size('http|127.0.0.1|' .. port .. '|||'), 0)
+
+    -- test that throws an error if opts.pool is invalid
+    local err = assert.throws(fetch, 'http://' .. host, {
+        pool = {},
+    })
+    assert.match(err, 'opts.pool must be net.http.pool or false')
+    pool:close()
+
+    -- test that return EBUSY if the active connections reach maxactive
+    pool = new_pool({
+        maxactive = 1,
+    })
+    res = assert(fetch('http://' .. host, {
+        pool = pool,
+    }))
+    local _, timeout
+    _, err, timeout = fetch('http://' .. host, {
+        pool = pool,
+    })
+    assert(error.is(err, errno.EBUSY))
+    assert.is_nil(timeout)
+
+    -- test that the slot is released when the content is consumed
+    assert.equal(res.content:read(), '3:1')
+    assert.equal(pool:nactive('http|127.0.0.1|' .. port .. '|||'), 0)
+    res = assert(fetch('http://' .. host, {
+        pool = pool,
+    }))
+    assert.equal(res.content:read(), '3:2')
+    pool:close()
+end
+
+function testcase.fetch_retry()
+    local hostname = '127.0.0.1'
+    local server = assert(new_inet_server(hostname, 0, {
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(server:listen())
+    local port = assert(server:getsockname()):port()
+    local host = hostname .. ':' .. port
+
+    -- create server that closes the connection when the path that starts
+    -- with /close arrives at the first time, as if the idle connection had
+    -- been timed out, and sends the malformed response to /bad
+    local p = assert(fork())
+    if p:is_child() then
+        local nconn = 0
+        local seen = {}
+        while true do
+            local peer = assert(server:accept())
+            local c = new_connection(peer)
+            local nreq = 0
+            nconn = nconn + 1
+            local req = c:read_request()
+            while req do
+                nreq = nreq + 1
+                local body = req.content and req.content:read() or ''
+                if string.find(req.path, '^/close') and not seen[req.path] then
+                    seen[req.path] = true
+                    break
+                elseif req.path == '/bad' then
+                    assert(peer:write('HTTP/1.1 2000 bad\r\n\r\n'))
+                    break
+                end
+                local res = new_response()
+                assert(res:write(c, nconn .. ':' .. nreq .. ':' .. body))
+                assert(c:flush())
+                req = c:read_request()
+            end
+            c:close()
+        end
+    end
+
+    local pool = new_pool()
+    local key = 'http|127.0.0.1|' .. port .. '|||'
+    local res = assert(fetch('http://' .. host, {
+        pool = pool,
+        method = 'PUT',
+        content = 'foo',
+    }))
+    assert.equal(res.content:read(), '1:1:foo')
+    assert.equal(pool:size(key), 1)
+
+    -- test that the idempotent request is sent again with the header on a
+    -- new connection if the pooled connection is closed by the peer
+    res = assert(fetch('http://' .. host .. '/close1', {
+        pool = pool,
+        method = 'PUT',
+        content = 'bar',
+    }))
+    assert.equal(res.content:read(), '2:1:bar')
+    assert.equal(pool:size(key), 1)
+
+    -- test that the non-idempotent request is not sent again
+    local err, timeout
+    res, err, timeout = fetch('http://' .. host .. '/close2', {
+        pool = pool,
+        method = 'POST',
+        content = 'baz',
+    })
+    assert.is_nil(res)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.equal(pool:size(key), 0)
+
+    -- test that the non-idempotent request is sent again if opts.retry is
+    -- true
+    res = assert(fetch('http://' .. host, {
+        pool = pool,
+        method = 'POST',
+        content = 'qux',
+    }))
+    assert.equal(res.content:read(), '3:1:qux')
+    res = assert(fetch('http://' .. host .. '/close3', {
+        pool = pool,
+        method = 'POST',
+        content = 'quux',
+        retry = true,
+    }))
+    assert.equal(res.content:read(), '4:1:quux')
+
+    -- test that the request is not sent again if the response is malformed
+    res, err = fetch('http://' .. host .. '/bad', {
+        pool = pool,
+    })
+    assert.is_nil(res)
+    assert.match(tostring(err), 'failed to fetch')
+    res = assert(fetch('http://' .. host, {
+        pool = pool,
+    }))
+    assert.equal(res.content:read(), '5:1:')
+    pool:close()
+
+    -- test that throws an error if opts.retry is not boolean
+    err = assert.throws(fetch, 'http://' .. host, {
+        retry = 'yes',
+    })
+    assert.match(err, 'opts.retry must be boolean')
+end
+
+function testcase.fetch_close_delimited()
+    local hostname = '127.0.0.1'
+    local server = assert(new_inet_server(hostname, 0, {
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(server:listen())
+    local port = assert(server:getsockname()):port()
+    local host = hostname .. ':' .. port
+
+    -- create server that sends the response without the content length on
+    -- the first connection, and the bytes that look like the next response
+    -- after a while
+    local p = assert(fork())
+    if p:is_child() then
+        local nconn = 0
+        while true do
+            local peer = assert(server:accept())
+            local c = new_connection(peer)
+            nconn = nconn + 1
+            local req = c:read_request()
+            if req and nconn == 1 then
+                assert(peer:write('HTTP/1.1 200 OK\r\n\r\n'))
+                sleep(0.2)
+                assert(peer:write('HTTP/1.1 200 OK\r\n' ..
+                                      'Content-Length: 3\r\n\r\nbad'))
+                sleep(0.5)
+            elseif req then
+                local res = new_response()
+                assert(res:write(c, nconn .. ':' .. req.method))
+                assert(c:flush())
+            end
+            c:close()
+        end
+    end
+
+    local pool = new_pool()
+    local key = 'http|127.0.0.1|' .. port .. '|||'
+    local res = assert(fetch('http://' .. host, {
+        pool = pool,
+    }))
+    assert.equal(res.status, 200)
+    assert.is_nil(res.content)
+
+    -- test that the connection of the close-delimited response is not pooled
+    assert.equal(pool:size(key), 0)
+    sleep(0.3)
+    res = assert(fetch('http://' .. host, {
+        pool = pool,
+    }))
+    assert.equal(res.content:read(), '2:GET')
+    pool:close()
+end
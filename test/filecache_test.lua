@@ -0,0 +1,179 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local filecache = require('net.http.filecache')
+local new_filecache = filecache.new
+
+local TMPFILES = {}
+
+--- create_tempfile creates a temporary file with the given data.
+--- @param data string file content
+--- @return string pathname
+local function create_tempfile(data)
+    local pathname = os.tmpname()
+    local f = assert(io.open(pathname, 'w'))
+    f:write(data)
+    f:close()
+    TMPFILES[#TMPFILES + 1] = pathname
+    return pathname
+end
+
+function testcase.after_each()
+    for _, pathname in ipairs(TMPFILES) do
+        os.remove(pathname)
+    end
+    TMPFILES = {}
+end
+
+function testcase.new()
+    -- test that create new instance of net.http.filecache
+    local c = assert(new_filecache())
+    assert.match(tostring(c), '^net.http.filecache: ', false)
+    assert.equal(c.maxfiles, 128)
+    assert.equal(c.revalidate, 1000)
+
+    -- test that throws an error if opts is invalid
+    local err = assert.throws(new_filecache, true)
+    assert.match(err, 'opts must be table')
+    err = assert.throws(new_filecache, {
+        maxfiles = 0,
+    })
+    assert.match(err, 'opts.maxfiles must be integer greater than 0')
+    err = assert.throws(new_filecache, {
+        revalidate = -1,
+    })
+    assert.match(err, 'opts.revalidate must be finite-number')
+end
+
+function testcase.open()
+    local pathname = create_tempfile('hello')
+
+    -- test that open the file with its validators
+    local entry = assert(filecache.open(pathname))
+    assert.equal(entry.size, 5)
+    assert.equal(entry.file:read('*a'), 'hello')
+    assert.match(entry.etag, '^"%x+-5"$', false)
+    assert.match(entry.last_modified, ' GMT$', false)
+    entry.file:close()
+
+    -- test that returns an error if the file does not exist
+    local err
+    entry, err = filecache.open(pathname .. '.nonexistent')
+    assert.is_nil(entry)
+    assert(err)
+end
+
+function testcase.get()
+    local c = new_filecache()
+    local pathname = create_tempfile('hello')
+
+    -- test that returns the cached entry
+    local entry = assert(c:get(pathname))
+    assert.equal(c:get(pathname), entry)
+    assert.equal(entry.nref, 2)
+    assert.equal(c:size(), 1)
+
+    -- test that cache the error apart from the open files
+    local _, err = c:get(pathname .. '.nonexistent')
+    assert(err)
+    assert.equal(c:size(), 1)
+    assert.equal(c.nerr, 1)
+
+    -- test that remove the entry
+    assert.is_true(c:remove(pathname))
+    assert.is_false(c:remove(pathname))
+    assert.not_equal(c:get(pathname), entry)
+
+    -- test that clear the entries
+    c:clear()
+    assert.equal(c:size(), 0)
+end
+
+function testcase.revalidate()
+    local c = new_filecache({
+        revalidate = 0,
+    })
+    local pathname = create_tempfile('hello')
+
+    -- test that returns the same entry if the file is not modified
+    local entry = assert(c:get(pathname))
+    assert.equal(c:get(pathname), entry)
+
+    -- test that reopen the file if modified
+    local f = assert(io.open(pathname, 'a'))
+    f:write(' world')
+    f:close()
+    local newentry = assert(c:get(pathname))
+    assert.not_equal(newentry, entry)
+    assert.equal(newentry.size, 11)
+
+    -- test that reopen the file if replaced
+    os.remove(pathname)
+    f = assert(io.open(pathname, 'w'))
+    f:write('hello world')
+    f:close()
+    assert.not_equal(c:get(pathname), newentry)
+    assert.equal(c:size(), 1)
+end
+
+function testcase.evict()
+    local c = new_filecache({
+        maxfiles = 2,
+    })
+    local a = create_tempfile('a')
+    local b = create_tempfile('b')
+
+    -- test that evict the least recently used entry
+    local entry = assert(c:get(a))
+    c:release(entry)
+    assert(c:get(b))
+    entry.used = entry.used - 1
+    assert(c:get(create_tempfile('c')))
+    assert.equal(c:size(), 2)
+    assert.is_false(c:remove(a))
+    assert.is_true(c:remove(b))
+
+    -- test that the evicted file is closed if no one uses it
+    assert.is_true(entry.detached)
+    assert.equal(io.type(entry.file), 'closed file')
+
+    -- test that the errors do not evict the open files
+    for i = 1, 3 do
+        assert(c:get(a .. '.nonexistent' .. i) == nil)
+    end
+    assert.equal(c:size(), 1)
+    assert.equal(c.nerr, 2)
+end
+
+function testcase.release()
+    local c = new_filecache({
+        revalidate = 0,
+    })
+    local pathname = create_tempfile('hello')
+
+    -- test that the removed file is not closed while it is used
+    local entry = assert(c:get(pathname))
+    assert.is_true(c:remove(pathname))
+    assert.equal(io.type(entry.file), 'file')
+
+    -- test that the removed file is closed when the last user releases it
+    c:release(entry)
+    assert.equal(io.type(entry.file), 'closed file')
+
+    -- test that the stale file is closed when the last user releases it
+    entry = assert(c:get(pathname))
+    local f = assert(io.open(pathname, 'a'))
+    f:write(' world')
+    f:close()
+    local newentry = assert(c:get(pathname))
+    assert.not_equal(newentry, entry)
+    assert.equal(io.type(entry.file), 'file')
+    c:release(entry)
+    assert.equal(io.type(entry.file), 'closed file')
+
+    -- test that clear closes the files that are not used
+    c:release(newentry)
+    c:clear()
+    assert.equal(io.type(newentry.file), 'closed file')
+    assert.equal(c:size(), 0)
+end
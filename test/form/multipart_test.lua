@@ -0,0 +1,186 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local errno = require('errno')
+local new_reader = require('net.http.reader').new
+local new_content = require('net.http.content').new
+local new_multipart = require('net.http.form.multipart').new
+local new_handler = require('net.http.form.multipart').new_handler
+
+local BODY = table.concat({
+    'preamble',
+    '--test_boundary',
+    'Content-Disposition: form-data; name="foo"',
+    '',
+    'bar',
+    '--test_boundary  ',
+    'Content-Disposition: form-data; name="file"; filename="a.txt"',
+    'Content-Type: text/plain',
+    '',
+    'hello\r\n-- world',
+    '--test_boundary--',
+    'epilogue',
+}, '\r\n')
+
+--- new_body_content returns the content that reads at most n bytes at once.
+--- if timeout is true, every other read returns the timeout.
+local function new_body_content(data, n, timeout)
+    local len = #data
+    local wait = false
+    return new_content(new_reader({
+        read = function()
+            if timeout then
+                wait = not wait
+                if wait then
+                    return nil, nil, true
+                end
+            end
+            if #data > 0 then
+                local s = string.sub(data, 1, n)
+                data = string.sub(data, n + 1)
+                return s
+            end
+        end,
+    }), len)
+end
+
+--- new_recorder returns the handler that records the parts.
+local function new_recorder()
+    local parts = {}
+    return {
+        parts = parts,
+        read_part = function(_, part)
+            parts[#parts + 1] = {
+                name = part.name,
+                filename = part.filename,
+                ctype = part.header:get('content-type'),
+                data = '',
+            }
+        end,
+        read_data = function(_, part, s)
+            local v = parts[#parts]
+            assert.equal(v.name, part.name)
+            assert.is_nil(v.done)
+            v.data = v.data .. s
+        end,
+        read_end = function(_, part)
+            local v = parts[#parts]
+            assert.equal(v.name, part.name)
+            v.done = true
+        end,
+    }
+end
+
+local PARTS = {
+    {
+        name = 'foo',
+        data = 'bar',
+        done = true,
+    },
+    {
+        name = 'file',
+        filename = 'a.txt',
+        ctype = 'text/plain',
+        data = 'hello\r\n-- world',
+        done = true,
+    },
+}
+
+function testcase.decode()
+    -- test that the parts are passed to the handler in any slice size
+    for _, n in ipairs({
+        1,
+        2,
+        7,
+        #BODY,
+    }) do
+        local c = new_body_content(BODY, n)
+        local h = new_recorder()
+        assert(new_multipart(c, 'test_boundary'):decode(h, 3))
+        assert.equal(h.parts, PARTS)
+        -- test that the epilogue is discarded
+        assert.is_true(c.is_consumed)
+    end
+
+    -- test that the decoding can be resumed after the timeout
+    local dec = new_multipart(new_body_content(BODY, 5, true), 'test_boundary')
+    local h = new_recorder()
+    local ok, err, timeout = dec:decode(h)
+    while not ok do
+        assert.is_nil(err)
+        assert.is_true(timeout)
+        ok, err, timeout = dec:decode(h)
+    end
+    assert.equal(h.parts, PARTS)
+
+    -- test that the default handler discards the parts
+    dec = new_multipart(new_body_content(BODY, 5), 'test_boundary')
+    assert(dec:decode(new_handler()))
+end
+
+function testcase.decode_abort()
+    -- test that the handler error aborts the decoding
+    local c = new_body_content(BODY, 4)
+    local handler = new_recorder()
+    handler.read_data = function(_, part)
+        if part.filename then
+            return 'too large'
+        end
+    end
+    local ok, err = new_multipart(c, 'test_boundary'):decode(handler)
+    assert.is_false(ok)
+    assert.match(err, 'too large')
+    assert.equal(#handler.parts, 2)
+    assert.is_false(c.is_consumed)
+end
+
+function testcase.decode_error()
+    -- test that returns an error if the close-delimiter is not found
+    local body = string.gsub(BODY, '%-%-test_boundary%-%-.+$', '')
+    local ok, err = new_multipart(new_body_content(body, 4), 'test_boundary')
+                        :decode(new_handler())
+    assert.is_false(ok)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'unexpected end')
+
+    -- test that returns an error if the delimiter is invalid
+    body = table.concat({
+        '--test_boundary',
+        'Content-Disposition: form-data; name="foo"',
+        '',
+        'foo',
+        '--test_boundary_x',
+        '',
+    }, '\r\n')
+    ok, err = new_multipart(new_body_content(body, 4), 'test_boundary')
+                  :decode(new_handler())
+    assert.is_false(ok)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'invalid multipart delimiter')
+
+    -- test that returns an error if the part has no name
+    body = '--test_boundary\r\nContent-Disposition: form-data\r\n\r\n'
+    ok, err = new_multipart(new_body_content(body, 4), 'test_boundary')
+                  :decode(new_handler())
+    assert.is_false(ok)
+    assert.equal(err.type, errno.EILSEQ)
+    assert.match(err, 'invalid Content-Disposition header')
+
+    -- test that returns an error if the header is too large
+    body = '--test_boundary\r\nFoo: ' .. string.rep('x', 1024 * 9)
+    ok, err = new_multipart(new_body_content(body, 1024), 'test_boundary')
+                  :decode(new_handler())
+    assert.is_false(ok)
+    assert.is_not_nil(err)
+
+    -- test that throws an error if arguments are invalid
+    err = assert.throws(new_multipart, {}, 'test_boundary')
+    assert.match(err, 'content must be net.http.content')
+    err = assert.throws(new_multipart, new_body_content(BODY, 4), 'a b ')
+    assert.match(err, 'boundary must be valid-boundary string')
+    local dec = new_multipart(new_body_content(BODY, 4), 'test_boundary')
+    err = assert.throws(dec.decode, dec, {})
+    assert.match(err, 'handler.read_part must be function')
+    err = assert.throws(dec.decode, dec, new_handler(), 0)
+    assert.match(err, 'chunksize must be uint greater than 0')
+end
@@ -65,6 +65,24 @@ function testcase.set()
     assert.equal(h:size(), 0)
     assert.is_nil(h:get('field-name'))
 
+    -- test that the well-known field-name is stored in the canonical-case
+    assert(h:set('etag', '"foo"'))
+    assert(h:set('x-field-name', 'bar'))
+    assert.equal({
+        h:get('ETAG'),
+    }, {
+        '"foo"',
+        'ETag',
+    })
+    assert.equal({
+        h:get('x-field-name'),
+    }, {
+        'bar',
+        'X-Field-Name',
+    })
+    assert(h:set('etag'))
+    assert(h:set('x-field-name'))
+
     -- test that return an error with invalid field-name
     local err = assert.throws(function()
         h:set('field name', 1)
@@ -153,6 +171,45 @@ function testcase.get()
     assert.match(err, 'key must be string')
 end
 
+function testcase.setview()
+    local p = require('net.http.parse').new()
+    local msg = table.concat({
+        'GET / HTTP/1.1',
+        'Host: example.com',
+        'Content-Length: 10',
+        '',
+        '',
+    }, '\r\n')
+    local req = {
+        header = {},
+    }
+    p:setlazy(true)
+    assert.equal(p:request(msg, req), #msg)
+
+    -- test that lookup the header-fields in the view
+    local h = header.new()
+    h:setview(req.header)
+    assert.equal(h:size(), 2)
+    assert.equal(h:get('host'), 'example.com')
+    assert.equal(h:content_length(), 10)
+    assert.equal(h.dict, {})
+
+    -- test that the view is converted into the dict when modified
+    assert(h:set('foo', 'bar'))
+    assert.is_nil(h.view)
+    assert.equal(h:size(), 3)
+    assert.equal(h:get('host', true), {
+        'example.com',
+    })
+    assert.equal(h:serialize(), table.concat({
+        'Host: example.com',
+        'Content-Length: 10',
+        'Foo: bar',
+        '',
+        '',
+    }, '\r\n'))
+end
+
 function testcase.is_transfer_encoding_chunked()
     local h = header.new()
 
@@ -247,6 +304,47 @@ function testcase.pairs()
     })
 end
 
+function testcase.serialize()
+    local h = header.new()
+    assert(h:set('field-foo', {
+        'foo',
+        'bar',
+    }))
+    assert(h:set('field-qux', 'quux'))
+
+    -- test that serialize header-fields
+    assert.equal(h:serialize(), table.concat({
+        'Field-Foo: foo\r\n',
+        'Field-Foo: bar\r\n',
+        'Field-Qux: quux\r\n',
+        '\r\n',
+    }))
+
+    -- test that serialize first-line and header-fields
+    assert.equal(h:serialize('HTTP/1.1 200 OK\r\n'), table.concat({
+        'HTTP/1.1 200 OK\r\n',
+        'Field-Foo: foo\r\n',
+        'Field-Foo: bar\r\n',
+        'Field-Qux: quux\r\n',
+        '\r\n',
+    }))
+
+    -- test that serialize the header larger than the scratch buffer
+    local val = string.rep('x', 4096)
+    assert(h:set('field-large', val))
+    assert.equal(h:serialize(), table.concat({
+        'Field-Foo: foo\r\n',
+        'Field-Foo: bar\r\n',
+        'Field-Qux: quux\r\n',
+        'Field-Large: ' .. val .. '\r\n',
+        '\r\n',
+    }))
+
+    -- test that serialize empty header
+    h = header.new()
+    assert.equal(h:serialize(), '\r\n')
+end
+
 function testcase.write()
     local h = header.new()
     assert(h:set('field-foo', {
@@ -280,6 +378,20 @@ function testcase.write()
         '\r\n',
     }))
 
+    -- test that send first-line and headers
+    recvd = ''
+    len, err = h:write(w, 'GET / HTTP/1.1\r\n')
+    assert.equal(len, #recvd)
+    assert.is_nil(err)
+    assert.equal(recvd, table.concat({
+        'GET / HTTP/1.1\r\n',
+        'Field-Foo: foo\r\n',
+        'Field-Foo: bar\r\n',
+        'Field-Foo: baz\r\n',
+        'Field-Qux: quux\r\n',
+        '\r\n',
+    }))
+
     -- test that return error
     wctx.write = function()
         return 0, 'write-error'
@@ -404,6 +404,89 @@ function testcase.read_form_multipart()
     assert.match(err, 'form-multipart decode error')
 end
 
+function testcase.read_multipart()
+    local data
+    local rctx = {
+        read = function(_, n)
+            if #data > 0 then
+                local s = string.sub(data, 1, n)
+                data = string.sub(data, n + 1)
+                return s
+            end
+        end,
+    }
+    local m
+    local resetctx = function(ctype, msg)
+        data = msg
+        m = assert(new_message())
+        m.content = new_content(new_reader(rctx), #msg)
+        m.header:set('Content-Type', ctype)
+    end
+    local parts = {}
+    local handler = {
+        read_part = function(_, part)
+            parts[#parts + 1] = {
+                name = part.name,
+                filename = part.filename,
+                data = {},
+            }
+        end,
+        read_data = function(_, _, s)
+            local list = parts[#parts].data
+            list[#list + 1] = s
+        end,
+        read_end = function(_, part)
+            parts[#parts].data = table.concat(parts[#parts].data)
+        end,
+    }
+
+    -- test that the parts are passed to the handler as they arrive
+    resetctx('multipart/form-data; boundary=test_boundary', table.concat({
+        '--test_boundary',
+        'Content-Disposition: form-data; name="foo"; filename="bar.txt"',
+        '',
+        string.rep('bar file', 1024),
+        '--test_boundary',
+        'Content-Disposition: form-data; name="qux"',
+        '',
+        'qux',
+        '--test_boundary--',
+        '',
+    }, '\r\n'))
+    assert(m:read_multipart(handler, 1024))
+    assert.equal(parts, {
+        {
+            name = 'foo',
+            filename = 'bar.txt',
+            data = string.rep('bar file', 1024),
+        },
+        {
+            name = 'qux',
+            data = 'qux',
+        },
+    })
+    assert.is_true(m.content.is_consumed)
+
+    -- test that the decoded content is not read again
+    parts = {}
+    assert(m:read_multipart(handler))
+    assert.equal(parts, {})
+
+    -- test that return EINVAL if the content is not multipart/form-data
+    resetctx('application/x-www-form-urlencoded', 'foo=bar')
+    local ok, err = m:read_multipart(handler)
+    assert.is_false(ok)
+    assert(error.is(err, errno.EINVAL))
+    assert.match(err, 'multipart/form-data required')
+
+    -- test that return EINVAL if the boundary is not defined
+    resetctx('multipart/form-data', 'foo=bar')
+    ok, err = m:read_multipart(handler)
+    assert.is_false(ok)
+    assert(error.is(err, errno.EINVAL))
+    assert.match(err, 'boundary not defined')
+end
+
 function testcase.write_form_urlencoded()
     local data = ''
     local wctx = {
@@ -182,9 +182,72 @@ function testcase.write_file()
     }, '\r\n'))
     assert.equal(f:seek('cur'), #filedata)
 
+    -- test that send file content with sendfile if connection supports it
+    local sent = {}
+    wctx.msg = ''
+    wctx.sendfile = function(self, file, len, offset)
+        -- send at most 4096 bytes at once
+        if len > 4096 then
+            len = 4096
+        end
+        sent[#sent + 1] = {
+            len = len,
+            offset = offset,
+        }
+        file:seek('set', offset)
+        return self:write(file:read(len))
+    end
+    m = assert(new_message())
+    f:seek('set', 4000)
+    assert(m:write_file(w, f))
+    wctx.sendfile = nil
+    assert.equal(wctx.msg, table.concat({
+        'Content-Length: ' .. tostring(#filedata - 4000),
+        'Content-Type: application/octet-stream',
+        '',
+        string.sub(filedata, 4001),
+    }, '\r\n'))
+    assert.equal(sent, {
+        {
+            len = 4096,
+            offset = 4000,
+        },
+        {
+            len = 4096,
+            offset = 8096,
+        },
+        {
+            len = 4096,
+            offset = 12192,
+        },
+        {
+            len = #filedata - 16288,
+            offset = 16288,
+        },
+    })
+
+    -- test that write the size bytes of file content from the offset
+    wctx.msg = ''
+    m = assert(new_message())
+    f:seek('set')
+    assert(m:write_file(w, f, 5, 6))
+    assert.equal(wctx.msg, table.concat({
+        'Content-Length: 5',
+        'Content-Type: application/octet-stream',
+        '',
+        'world',
+    }, '\r\n'))
+    assert.equal(f:seek('cur'), 0)
+
     -- test that throws an error if file is not file*
     local err = assert.throws(m.write_file, m, w, true)
     assert.match(err, 'file must be file*')
+
+    -- test that throws an error if size or offset is invalid
+    err = assert.throws(m.write_file, m, w, f, -1)
+    assert.match(err, 'size must be uint')
+    err = assert.throws(m.write_file, m, w, f, 1, -1)
+    assert.match(err, 'offset must be uint')
 end
 
 function testcase.write()
@@ -246,8 +309,64 @@ function testcase.write()
         '',
     }, '\r\n'))
 
+    -- test that the small data is written to the buffer with the header
+    local iov = {}
+    wctx.msg = ''
+    wctx.writev = function(self, ...)
+        iov[#iov + 1] = select('#', ...)
+        return self:write(table.concat({
+            ...,
+        }))
+    end
+    w = new_writer(wctx)
+    m = assert(new_message())
+    assert(m:write(w, 'foobar'))
+    assert.equal(iov, {})
+    assert(w:flush())
+    assert.equal(wctx.msg, table.concat({
+        'Content-Length: 6',
+        'Content-Type: application/octet-stream',
+        '',
+        'foobar',
+    }, '\r\n'))
+
+    -- test that the large data is written with the header by writev
+    local data = string.rep('x', 1024 * 4)
+    wctx.msg = ''
+    m = assert(new_message())
+    assert(m:write(w, data))
+    wctx.writev = nil
+    assert.equal(iov, {
+        2,
+    })
+    assert.equal(wctx.msg, table.concat({
+        'Content-Length: ' .. #data,
+        'Content-Type: application/octet-stream',
+        '',
+        data,
+    }, '\r\n'))
+
+    -- test that returns the number of bytes written before the timeout
+    wctx.msg = ''
+    wctx.writev = function(self, ...)
+        local s = table.concat({
+            ...,
+        })
+        self:write(string.sub(s, 1, 10))
+        return 10, nil, true
+    end
+    w = new_writer(wctx)
+    m = assert(new_message())
+    local n, err, timeout = m:write(w, data)
+    wctx.writev = nil
+    assert.equal(n, 10)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert.equal(#wctx.msg, 10)
+    assert.equal(m.header_sent, 10)
+
     -- test that throws an error if data is not string
-    local err = assert.throws(m.write, m, w, true)
+    err = assert.throws(m.write, m, w, true)
     assert.match(err, 'data must be string')
 end
 
@@ -0,0 +1,127 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local metrics = require('net.http.metrics')
+local parse = require('net.http.parse')
+local new_connection = require('net.http.connection').new
+
+function testcase.after_each()
+    metrics.disable()
+end
+
+function testcase.enable()
+    -- test that metrics are disabled by default
+    assert.is_nil(metrics.recorder)
+    assert.is_nil(metrics.snapshot())
+    assert.is_nil(metrics.export())
+
+    -- test that enable returns the same recorder
+    local rec = assert(metrics.enable())
+    assert.equal(metrics.enable(), rec)
+    assert.equal(metrics.recorder, rec)
+
+    -- test that reset discards the recorded metrics
+    rec:incr('foo')
+    metrics.reset()
+    assert.not_equal(metrics.recorder, rec)
+    assert.equal(metrics.snapshot().counters, {})
+
+    -- test that disable stops recording
+    metrics.disable()
+    assert.is_nil(metrics.recorder)
+    metrics.reset()
+    assert.is_nil(metrics.recorder)
+end
+
+function testcase.recorder()
+    local rec = metrics.enable()
+
+    -- test that incr increments the counter
+    rec:incr('foo')
+    rec:incr('foo', 2)
+
+    -- test that observe records the value into log2 buckets
+    for _, v in ipairs({
+        0.5,
+        1,
+        3,
+        3,
+        1000,
+    }) do
+        rec:observe('bar', v)
+    end
+
+    local snapshot = metrics.snapshot()
+    assert.is_int(snapshot.pid)
+    assert.equal(snapshot.counters, {
+        foo = 3,
+    })
+    local h = snapshot.histograms.bar
+    assert.contains(h, {
+        count = 5,
+        sum = 1007.5,
+        max = 1000,
+        p50 = 4,
+    })
+    assert.equal(h.buckets[1], 1)
+    assert.equal(h.buckets[2], 1)
+    assert.equal(h.buckets[3], 2)
+    assert.equal(h.buckets[11], 1)
+    assert.equal(snapshot.bounds[11], 1024)
+
+    -- test that elapsed records the microseconds since now()
+    metrics.elapsed('baz', metrics.now())
+    assert.equal(metrics.snapshot().histograms.baz.count, 1)
+
+    -- test that export returns the snapshot as JSON
+    assert.match(metrics.export(), '"foo":3')
+end
+
+function testcase.read_message()
+    local data = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: www.example.com',
+        'Content-Length: 4',
+        '',
+        'q=42',
+        'GET /bar HTTP/1.1',
+        'Host www.example.com',
+        '',
+        '',
+    }, '\r\n')
+    local c = new_connection({
+        read = function(_, n)
+            if #data == 0 then
+                return nil
+            end
+            local s = string.sub(data, 1, n)
+            data = string.sub(data, n + 1)
+            return s
+        end,
+        write = function(_, s)
+            return #s
+        end,
+    })
+
+    -- test that nothing is recorded while disabled
+    local msg = assert(c:read_request())
+    assert.is_nil(metrics.snapshot())
+
+    -- test that the phases and counters of the message are recorded
+    metrics.enable()
+    assert.equal(msg.content:copy({
+        write = function(_, s)
+            return #s
+        end,
+    }), 4)
+    local _, err = c:read_request()
+    assert.equal(err.type, parse.EHDRNAME)
+    local snapshot = metrics.snapshot()
+    assert.contains(snapshot.counters, {
+        bytes_copied = 4,
+        ['parse_error.net.http.parse.EHDRNAME'] = 1,
+    })
+    assert.is_nil(snapshot.counters.messages)
+    assert.equal(snapshot.histograms.copy.count, 1)
+    assert.equal(snapshot.histograms.parse.count, 1)
+end
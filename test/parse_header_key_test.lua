@@ -0,0 +1,56 @@
+local testcase = require('testcase')
+local assert = require('assert')
+local parse = require('net.http.parse')
+local parse_header_key = parse.header_key
+
+function testcase.parse_header_key()
+    -- test that return the lowercase and canonical-case well-known key
+    for _, v in ipairs({
+        {
+            'content-type',
+            'Content-Type',
+        },
+        {
+            'ETAG',
+            'ETag',
+        },
+        {
+            'www-Authenticate',
+            'WWW-Authenticate',
+        },
+        {
+            'Sec-WebSocket-Key',
+            'Sec-WebSocket-Key',
+        },
+    }) do
+        assert.equal({
+            parse_header_key(v[1]),
+        }, {
+            string.lower(v[2]),
+            v[2],
+        })
+    end
+
+    -- test that return only the lowercase key if it is not well-known
+    assert.equal({
+        parse_header_key('X-Foo-Bar'),
+    }, {
+        'x-foo-bar',
+    })
+    assert.equal({
+        parse_header_key('Content-Types'),
+    }, {
+        'content-types',
+    })
+
+    -- test that limit the maximum length of header-name
+    local ok, err = parse_header_key('FooBarBaz', 4)
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRLEN)
+
+    -- test that cannot parse invalid header-name
+    ok, err = parse_header_key('Host:')
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRNAME)
+end
+
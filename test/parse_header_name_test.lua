@@ -16,5 +16,20 @@ function testcase.parse_header_name()
     ok, err = parse_header_name('Foo:')
     assert.is_false(ok)
     assert.equal(err.type, parse.EHDRNAME)
+
+    -- test that parse header-name longer than the vector size
+    assert(parse_header_name('X-' .. string.rep('Foo_Bar-Baz', 6) ..
+                                 "!#$%&'*+.^`|~"))
+
+    -- test that cannot parse invalid byte after the vector size
+    ok, err = parse_header_name(string.rep('a', 40) .. '(' ..
+                                    string.rep('a', 40))
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRNAME)
+
+    -- test that limit the maximum length of long header-name
+    ok, err = parse_header_name(string.rep('a', 100), 70)
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRLEN)
 end
 
@@ -16,5 +16,25 @@ function testcase.parse_header_value()
     ok, err = parse_header_value('Foo\n')
     assert.is_false(ok)
     assert.equal(err.type, parse.EHDRVAL)
+
+    -- test that parse header-value longer than the vector size
+    local ua = 'Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) ' ..
+                   'AppleWebKit/537.36 (KHTML, like Gecko) ' ..
+                   'Chrome/100.0.4896.75\tSafari/537.36'
+    assert(parse_header_value(ua))
+
+    -- test that cannot parse invalid byte after the vector size
+    ok, err = parse_header_value(string.rep('a', 70) .. '\0' .. 'a')
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRVAL)
+    ok, err = parse_header_value(string.rep('a', 40) .. '\x7f' ..
+                                     string.rep('a', 40))
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRVAL)
+
+    -- test that limit the maximum length of long header-value
+    ok, err = parse_header_value(string.rep('a', 100), 70)
+    assert.is_false(ok)
+    assert.equal(err.type, parse.EHDRLEN)
 end
 
@@ -0,0 +1,122 @@
+local testcase = require('testcase')
+local assert = require('assert')
+local parse = require('net.http.parse')
+local new_chunked = parse.new_chunked
+local new_buffer = require('net.http.buffer').new
+
+function testcase.new_chunked()
+    -- test that create new chunked decoder
+    local dec = new_chunked()
+    assert.match(tostring(dec), '^net.http.parse.chunked: ', false)
+end
+
+function testcase.read()
+    local dec = new_chunked()
+    local buf = new_buffer()
+    local msg = table.concat({
+        '6; ext-name=ext-value; ext-name2',
+        'hello ',
+        '6',
+        'world!',
+        '0; last-ext',
+        'Trailer-Name: Trailer-Value',
+        '\r\nfoo',
+    }, '\r\n')
+
+    -- test that return EAGAIN if buffer is empty
+    local s, err, ext = dec:read(buf)
+    assert.is_nil(s)
+    assert.equal(err.type, parse.EAGAIN)
+    assert.is_nil(ext)
+
+    -- test that return the chunk-data as it arrives
+    buf:write(string.sub(msg, 1, 37))
+    s, err, ext = dec:read(buf)
+    assert.equal(s, 'hel')
+    assert.is_nil(err)
+    assert.equal(ext, {
+        ['ext-name'] = 'ext-value',
+        ['ext-name2'] = '',
+    })
+    assert.equal(buf:size(), 0)
+    buf:write(string.sub(msg, 38))
+    s, err, ext = dec:read(buf)
+    assert.equal(s, 'lo ')
+    assert.is_nil(err)
+    assert.equal(ext, {
+        ['ext-name'] = 'ext-value',
+        ['ext-name2'] = '',
+    })
+
+    -- test that return the next chunk-data
+    s, err, ext = dec:read(buf)
+    assert.equal(s, 'world!')
+    assert.is_nil(err)
+    assert.equal(ext, {})
+
+    -- test that return the chunk-extensions of the last-chunk
+    s, err, ext = dec:read(buf)
+    assert.is_nil(s)
+    assert.is_nil(err)
+    assert.equal(ext, {
+        ['last-ext'] = '',
+    })
+
+    -- test that return nil after the last-chunk
+    s, err, ext = dec:read(buf)
+    assert.is_nil(s)
+    assert.is_nil(err)
+    assert.is_nil(ext)
+
+    -- test that parse the trailer-part
+    local trailer = {}
+    assert.is_true(dec:trailer(buf, trailer))
+    assert.equal(trailer, {
+        {
+            idx = 1,
+            key = 'Trailer-Name',
+            val = {
+                'Trailer-Value',
+            },
+        },
+        ['trailer-name'] = {
+            idx = 1,
+            key = 'Trailer-Name',
+            val = {
+                'Trailer-Value',
+            },
+        },
+    })
+    assert.equal(buf:peek(), 'foo')
+
+    -- test that decode the next body after reset
+    dec:reset()
+    buf:reset()
+    buf:write('3\r\nfoo\r\n')
+    assert.equal(dec:read(buf), 'foo')
+end
+
+function testcase.read_error()
+    local dec = new_chunked()
+    local buf = new_buffer()
+
+    -- test that return EILSEQ if invalid chunk-size
+    buf:write('5x\r\nhello\r\n0\r\n')
+    local s, err = dec:read(buf)
+    assert.is_nil(s)
+    assert.equal(err.type, parse.EILSEQ)
+
+    -- test that return EEOL if invalid end-of-line terminator of chunk-data
+    dec:reset()
+    buf:reset()
+    buf:write('5\r\nhelloX\r\n0\r\n')
+    assert.equal(dec:read(buf), 'hello')
+    s, err = dec:read(buf)
+    assert.is_nil(s)
+    assert.equal(err.type, parse.EEOL)
+
+    -- test that throws an error if trailer is read before the last-chunk
+    dec:reset()
+    err = assert.throws(dec.trailer, dec, buf, {})
+    assert.match(err, 'the last-chunk has not been read')
+end
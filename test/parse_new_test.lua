@@ -0,0 +1,272 @@
+local testcase = require('testcase')
+local assert = require('assert')
+local parse = require('net.http.parse')
+local new_parser = parse.new
+local new_buffer = require('net.http.buffer').new
+local CRLF = '\r\n'
+
+function testcase.new()
+    -- test that create new parser
+    local p = new_parser()
+    assert.match(tostring(p), '^net.http.parse.parser: ', false)
+    assert.equal(p:size(), 0)
+end
+
+function testcase.request()
+    local p = new_parser()
+    local msg = table.concat({
+        'GET /foo/bar/baz/qux HTTP/1.1',
+        'Host: example1.com',
+        'Host: example2.com',
+        'Content-Type: text/plain',
+        CRLF,
+    }, CRLF)
+    local kv_host = {
+        idx = 1,
+        key = 'Host',
+        val = {
+            'example1.com',
+            'example2.com',
+        },
+    }
+    local kv_ctype = {
+        idx = 2,
+        key = 'Content-Type',
+        val = {
+            'text/plain',
+        },
+    }
+
+    -- test that parse request message fed byte by byte
+    local req = {
+        header = {},
+    }
+    for i = 1, #msg - 1 do
+        local pos, err = p:request(string.sub(msg, i, i), req)
+        assert.is_nil(pos)
+        assert.equal(err.type, parse.EAGAIN)
+    end
+    assert.equal(p:request(string.sub(msg, #msg), req), #msg)
+    assert.equal(req, {
+        method = 'GET',
+        uri = '/foo/bar/baz/qux',
+        version = 1.1,
+        header = {
+            kv_host,
+            kv_ctype,
+            host = kv_host,
+            ['content-type'] = kv_ctype,
+        },
+    })
+    assert.is_nil(p:reset())
+    assert.equal(p:size(), 0)
+
+    -- test that returns the bytes following the parsed message
+    req = {
+        header = {},
+    }
+    assert.equal(p:request(msg .. 'hello', req), #msg)
+    assert.equal(p:reset(), 'hello')
+
+    -- test that parse pipelined messages
+    local reqs = {
+        {
+            header = {},
+        },
+        {
+            header = {},
+        },
+    }
+    assert.equal(p:request(msg .. msg, reqs[1]), #msg)
+    assert.equal(p:request(nil, reqs[2]), #msg)
+    assert.equal(reqs[1], reqs[2])
+    assert.is_nil(p:reset())
+
+    -- test that parse the bytes of buffer in place
+    local b = new_buffer()
+    req = {
+        header = {},
+    }
+    for i = 1, #msg - 1 do
+        b:write(string.sub(msg, i, i))
+        local pos, err = p:request(b, req)
+        assert.is_nil(pos)
+        assert.equal(err.type, parse.EAGAIN)
+        assert.equal(b:size(), i)
+    end
+    b:write(string.sub(msg, #msg) .. msg)
+    assert.equal(p:request(b, req), #msg)
+    assert.equal(req, reqs[1])
+    assert.equal(p:size(), 0)
+
+    -- test that consume the bytes of parsed message from buffer
+    assert.equal(b:size(), #msg)
+    req = {
+        header = {},
+    }
+    assert.equal(p:request(b, req), #msg)
+    assert.equal(req, reqs[1])
+    assert.equal(b:size(), 0)
+
+    -- test that only request-line is parsed if header table does not exists
+    local line = 'GET /foo/bar/baz/qux HTTP/1.0\n'
+    req = {}
+    assert.equal(p:request(line .. 'Host: example.com\n\n', req), #line)
+    assert.equal(req, {
+        method = 'GET',
+        uri = '/foo/bar/baz/qux',
+        version = 1.0,
+    })
+    assert.equal(p:reset(), 'Host: example.com\n\n')
+
+    -- test that return EMETHOD
+    local pos, err = p:request('FOO / HTTP/1.1\r\n', {})
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.EMETHOD)
+    p:reset()
+
+    -- test that return ELEN if request-line is too long without LF
+    p = new_parser(10)
+    pos, err = p:request('GET /' .. string.rep('a', 40), {})
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.ELEN)
+
+    -- test that return EHDRLEN if header line is too long without LF
+    p = new_parser(nil, 10)
+    pos, err = p:request('GET / HTTP/1.1\r\nFoo: ' .. string.rep('a', 20), {
+        header = {},
+    })
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.EHDRLEN)
+
+    -- test that return EHDRNUM
+    p = new_parser(nil, nil, 1)
+    pos, err = p:request(msg, {
+        header = {},
+    })
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.EHDRNUM)
+end
+
+function testcase.setlazy()
+    local p = new_parser()
+    local msg = table.concat({
+        'GET / HTTP/1.1',
+        'Host: example1.com',
+        'X-Foo:  a  ',
+        'host: example2.com',
+        CRLF,
+    }, CRLF)
+
+    -- test that the header is returned as the view of the received bytes
+    p:setlazy(true)
+    local req = {
+        header = {},
+    }
+    assert.equal(p:request(msg .. 'hello', req), #msg)
+    local view = req.header
+    assert.match(tostring(view), '^net.http.parse.headers: ', false)
+    assert.equal(#view, 3)
+
+    -- test that lookup the last value and the first key case-insensitively
+    assert.equal({
+        view:get('HOST'),
+    }, {
+        'example2.com',
+        'Host',
+    })
+    assert.equal({
+        view:get('host', true),
+    }, {
+        {
+            'example1.com',
+            'example2.com',
+        },
+        'Host',
+    })
+    assert.equal(view:get('x-foo'), 'a')
+    assert.is_nil(view:get('unknown'))
+
+    -- test that convert the view into the header table
+    local kv_host = {
+        idx = 1,
+        key = 'Host',
+        val = {
+            'example1.com',
+            'example2.com',
+        },
+    }
+    local kv_foo = {
+        idx = 2,
+        key = 'X-Foo',
+        val = {
+            'a',
+        },
+    }
+    assert.equal(view:totable({}), {
+        kv_host,
+        kv_foo,
+        host = kv_host,
+        ['x-foo'] = kv_foo,
+    })
+
+    -- test that the header is converted into the table if disabled
+    p:setlazy(false)
+    req = {
+        header = {},
+    }
+    assert.equal(p:request(msg, req), #msg)
+    assert.equal(req.header, {
+        kv_host,
+        kv_foo,
+        host = kv_host,
+        ['x-foo'] = kv_foo,
+    })
+
+    -- test that throws an error if argument is not boolean
+    local err = assert.throws(p.setlazy, p, 'true')
+    assert.match(err, 'boolean expected')
+end
+
+function testcase.response()
+    local p = new_parser()
+    local msg = table.concat({
+        'HTTP/1.1 200 OK',
+        'Server: example-server',
+        CRLF,
+    }, CRLF)
+    local kv_server = {
+        idx = 1,
+        key = 'Server',
+        val = {
+            'example-server',
+        },
+    }
+
+    -- test that parse response message fed in pieces
+    local res = {
+        header = {},
+    }
+    local pos, err = p:response(string.sub(msg, 1, 10), res)
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.EAGAIN)
+    pos, err = p:response(string.sub(msg, 11, 30), res)
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.EAGAIN)
+    assert.equal(p:response(string.sub(msg, 31), res), #msg)
+    assert.equal(res, {
+        status = 200,
+        reason = 'OK',
+        version = 1.1,
+        header = {
+            kv_server,
+            server = kv_server,
+        },
+    })
+    assert.is_nil(p:reset())
+
+    -- test that return ESTATUS
+    pos, err = p:response('HTTP/1.1 2000 OK\r\n', {})
+    assert.is_nil(pos)
+    assert.equal(err.type, parse.ESTATUS)
+end
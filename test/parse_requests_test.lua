@@ -0,0 +1,124 @@
+local testcase = require('testcase')
+local assert = require('assert')
+local parse = require('net.http.parse')
+local parse_requests = parse.requests
+local new_buffer = require('net.http.buffer').new
+local CRLF = '\r\n'
+
+function testcase.parse_requests()
+    local kv_host = {
+        idx = 1,
+        key = 'Host',
+        val = {
+            'example.com',
+        },
+    }
+    local kv_clen = {
+        idx = 1,
+        key = 'Content-Length',
+        val = {
+            '3',
+        },
+    }
+    local msg = table.concat({
+        'GET /foo HTTP/1.1',
+        'Host: example.com',
+        '',
+        'POST /bar HTTP/1.1',
+        'Content-Length: 3',
+        '',
+        'abc',
+        'GET /baz HTTP/1.0',
+        '',
+        '',
+    }, CRLF)
+
+    -- test that parse the pipelined requests at once
+    local reqs, cur = parse_requests(msg)
+    assert.equal(cur, #msg)
+    assert.equal(reqs, {
+        {
+            method = 'GET',
+            uri = '/foo',
+            version = 1.1,
+            header = {
+                kv_host,
+                host = kv_host,
+            },
+        },
+        {
+            method = 'POST',
+            uri = '/bar',
+            version = 1.1,
+            header = {
+                kv_clen,
+                ['content-length'] = kv_clen,
+            },
+            body = 'abc',
+        },
+        {
+            method = 'GET',
+            uri = '/baz',
+            version = 1.0,
+            header = {},
+        },
+    })
+
+    -- test that parse the pipelined requests in the buffer up to max
+    local b = new_buffer()
+    b:write(msg)
+    reqs, cur = parse_requests(b, 2)
+    assert.equal(#reqs, 2)
+    assert.equal(reqs[2].body, 'abc')
+    assert.equal(cur, #msg - #'\r\nGET /baz HTTP/1.0\r\n\r\n')
+    -- the bytes of the buffer are not consumed
+    assert.equal(b:size(), #msg)
+
+    -- test that stop parsing before the incomplete request
+    reqs, cur = parse_requests(string.sub(msg, 1, -3))
+    assert.equal(#reqs, 2)
+    assert.equal(cur, #msg - #'\r\nGET /baz HTTP/1.0\r\n\r\n')
+
+    -- test that stop parsing after the header of the request if its body
+    -- has not been received
+    reqs, cur = parse_requests(string.sub(msg, 1, 82))
+    assert.equal(#reqs, 2)
+    assert.is_nil(reqs[2].body)
+    assert.equal(cur, #'GET /foo HTTP/1.1\r\nHost: example.com\r\n\r\n' ..
+                     'POST /bar HTTP/1.1\r\nContent-Length: 3\r\n\r\n')
+
+    -- test that stop parsing after the header of the chunked request
+    reqs, cur = parse_requests(table.concat({
+        'POST /foo HTTP/1.1',
+        'Transfer-Encoding: chunked',
+        '',
+        '0',
+        '',
+        'GET /bar HTTP/1.1',
+        '',
+        '',
+    }, CRLF))
+    assert.equal(#reqs, 1)
+    assert.is_nil(reqs[1].body)
+    assert.equal(cur, #'POST /foo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n')
+
+    -- test that return the parsed requests before the invalid request
+    reqs, cur = parse_requests('GET /foo HTTP/1.1\r\n\r\nFOO /bar HTTP/1.1\r\n\r\n')
+    assert.equal(#reqs, 1)
+    assert.equal(cur, 21)
+
+    -- test that return an error if the first request is invalid
+    local err
+    reqs, err = parse_requests('FOO /bar HTTP/1.1\r\n\r\n')
+    assert.is_nil(reqs)
+    assert.equal(err.type, parse.EMETHOD)
+
+    -- test that return EAGAIN if the first request is incomplete
+    reqs, err = parse_requests('GET /foo HTTP/1.1\r\n')
+    assert.is_nil(reqs)
+    assert.equal(err.type, parse.EAGAIN)
+
+    -- test that throws an error if max is 0
+    err = assert.throws(parse_requests, msg, 0)
+    assert.match(err, 'max must be greater than 0')
+end
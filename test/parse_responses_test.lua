@@ -0,0 +1,68 @@
+local testcase = require('testcase')
+local assert = require('assert')
+local parse = require('net.http.parse')
+local parse_responses = parse.responses
+local CRLF = '\r\n'
+
+function testcase.parse_responses()
+    local kv_clen = {
+        idx = 1,
+        key = 'Content-Length',
+        val = {
+            '2',
+        },
+    }
+    local msg = table.concat({
+        'HTTP/1.1 100 Continue',
+        '',
+        'HTTP/1.1 200 OK',
+        'Content-Length: 2',
+        '',
+        'okHTTP/1.1 304 Not Modified',
+        '',
+        'HTTP/1.1 200 OK',
+        '',
+        'hello',
+    }, CRLF)
+
+    -- test that parse the pipelined responses at once
+    local res, cur = parse_responses(msg)
+    assert.equal(res, {
+        {
+            version = 1.1,
+            status = 100,
+            reason = 'Continue',
+            header = {},
+        },
+        {
+            version = 1.1,
+            status = 200,
+            reason = 'OK',
+            header = {
+                kv_clen,
+                ['content-length'] = kv_clen,
+            },
+            body = 'ok',
+        },
+        {
+            version = 1.1,
+            status = 304,
+            reason = 'Not Modified',
+            header = {},
+        },
+        {
+            version = 1.1,
+            status = 200,
+            reason = 'OK',
+            header = {},
+        },
+    })
+    -- the body delimited by the connection close is not consumed
+    assert.equal(cur, #msg - #'hello')
+
+    -- test that return an error if the first response is invalid
+    local err
+    res, err = parse_responses('HTTP/1.5 200 OK\r\n\r\n')
+    assert.is_nil(res)
+    assert.equal(err.type, parse.EVERSION)
+end
@@ -0,0 +1,186 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local errno = require('errno')
+local new_pool = require('net.http.pool').new
+
+local function new_conn(alive)
+    return {
+        alive = alive ~= false,
+        closed = false,
+        is_alive = function(self)
+            return self.alive and not self.closed
+        end,
+        close = function(self)
+            self.closed = true
+        end,
+    }
+end
+
+function testcase.new()
+    -- test that create new instance of net.http.pool
+    local p = assert(new_pool())
+    assert.match(tostring(p), '^net.http.pool: ', false)
+    assert.equal(p.maxidle, 8)
+    assert.equal(p.idle_timeout, 30)
+
+    -- test that create new instance with options
+    p = assert(new_pool({
+        maxidle = 2,
+        idle_timeout = 1.5,
+    }))
+    assert.equal(p.maxidle, 2)
+    assert.equal(p.idle_timeout, 1.5)
+
+    -- test that throws an error if opts is not table
+    local err = assert.throws(new_pool, true)
+    assert.match(err, 'opts must be table')
+
+    -- test that throws an error if opts.maxidle is invalid
+    err = assert.throws(new_pool, {
+        maxidle = 0,
+    })
+    assert.match(err, 'opts.maxidle must be integer greater than 0')
+
+    -- test that throws an error if opts.maxactive is invalid
+    err = assert.throws(new_pool, {
+        maxactive = 0,
+    })
+    assert.match(err, 'opts.maxactive must be integer greater than 0')
+
+    -- test that throws an error if opts.idle_timeout is invalid
+    err = assert.throws(new_pool, {
+        idle_timeout = 0,
+    })
+    assert.match(err, 'opts.idle_timeout must be finite-number greater than 0')
+end
+
+function testcase.put_get()
+    local p = assert(new_pool({
+        maxidle = 2,
+    }))
+    local c1 = new_conn()
+    local c2 = new_conn()
+    local c3 = new_conn()
+
+    -- test that returns nil if no idle connection
+    assert.is_nil(p:get('foo'))
+
+    -- test that put connections up to maxidle
+    assert.is_true(p:put('foo', c1))
+    assert.is_true(p:put('foo', c2))
+    assert.is_false(p:put('foo', c3))
+    assert.is_true(c3.closed)
+    assert.equal(p:size('foo'), 2)
+    assert.equal(p:size('bar'), 0)
+
+    -- test that get the most recently returned connection
+    assert.equal(p:get('foo'), c2)
+    assert.equal(p:get('foo'), c1)
+    assert.is_nil(p:get('foo'))
+    assert.equal(p:size('foo'), 0)
+
+    -- test that the connection that cannot be reused is not pooled
+    assert.is_false(p:put('foo', new_conn(false)))
+
+    -- test that the connection that is closed by peer is discarded
+    assert.is_true(p:put('foo', c1))
+    assert.is_true(p:put('foo', c2))
+    c2.alive = false
+    assert.equal(p:get('foo'), c1)
+    assert.is_true(c2.closed)
+    assert.equal(p:size('foo'), 0)
+
+    -- test that throws an error if key is not string
+    local err = assert.throws(p.get, p, 1)
+    assert.match(err, 'key must be string')
+    err = assert.throws(p.put, p, 1, c1)
+    assert.match(err, 'key must be string')
+end
+
+function testcase.acquire()
+    local p = assert(new_pool({
+        maxactive = 2,
+    }))
+    local c1 = new_conn()
+
+    -- test that acquire the slots up to maxactive
+    assert.is_true(p:acquire('foo'))
+    assert.is_true(p:acquire('foo'))
+    local ok, err = p:acquire('foo')
+    assert.is_false(ok)
+    assert.equal(err.type, errno.EBUSY)
+    assert.equal(p:nactive('foo'), 2)
+
+    -- test that the slots are counted for each key
+    assert.is_true(p:acquire('bar'))
+    assert.equal(p:nactive('bar'), 1)
+
+    -- test that put releases the slot of the returned connection
+    assert.is_true(p:put('foo', c1))
+    assert.equal(p:nactive('foo'), 1)
+    assert.is_true(p:acquire('foo'))
+    assert.equal(p:get('foo'), c1)
+
+    -- test that release releases the slot of the closed connection
+    p:release('foo')
+    p:release('foo')
+    assert.equal(p:nactive('foo'), 0)
+    p:release('foo')
+    assert.equal(p:nactive('foo'), 0)
+
+    -- test that no limit without maxactive
+    p = assert(new_pool())
+    for _ = 1, 100 do
+        assert.is_true(p:acquire('foo'))
+    end
+    assert.equal(p:nactive('foo'), 100)
+
+    -- test that throws an error if key is not string
+    err = assert.throws(p.acquire, p, 1)
+    assert.match(err, 'key must be string')
+    err = assert.throws(p.release, p, 1)
+    assert.match(err, 'key must be string')
+end
+
+function testcase.evict()
+    local p = assert(new_pool({
+        idle_timeout = 1,
+    }))
+    local c1 = new_conn()
+    local c2 = new_conn()
+    assert(p:put('foo', c1))
+    assert(p:put('bar', c2))
+
+    -- test that the idle connections are kept until the idle timeout
+    p:evict()
+    assert.equal(p:size('foo'), 1)
+    assert.equal(p:size('bar'), 1)
+
+    -- test that close the idle connections that exceed the idle timeout
+    p.hosts.foo[1].time = os.time() - 2
+    p:evict()
+    assert.equal(p:size('foo'), 0)
+    assert.is_true(c1.closed)
+    assert.equal(p:size('bar'), 1)
+
+    -- test that get discards the expired connections
+    p.hosts.bar[1].time = os.time() - 2
+    assert.is_nil(p:get('bar'))
+    assert.is_true(c2.closed)
+end
+
+function testcase.close()
+    local p = assert(new_pool())
+    local c1 = new_conn()
+    local c2 = new_conn()
+    assert(p:put('foo', c1))
+    assert(p:put('bar', c2))
+
+    -- test that close all the idle connections
+    p:close()
+    assert.is_true(c1.closed)
+    assert.is_true(c2.closed)
+    assert.equal(p:size('foo'), 0)
+    assert.equal(p:size('bar'), 0)
+end
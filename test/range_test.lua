@@ -0,0 +1,105 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local parse = require('net.http.range').parse
+
+function testcase.parse()
+    -- test that parse the satisfiable ranges
+    for _, v in ipairs({
+        {
+            val = 'bytes=0-99',
+            exp = {
+                {
+                    0,
+                    99,
+                },
+            },
+        },
+        {
+            val = 'bytes=900-',
+            exp = {
+                {
+                    900,
+                    999,
+                },
+            },
+        },
+        {
+            val = 'bytes=-100',
+            exp = {
+                {
+                    900,
+                    999,
+                },
+            },
+        },
+        {
+            val = 'bytes=-5000',
+            exp = {
+                {
+                    0,
+                    999,
+                },
+            },
+        },
+        {
+            val = 'bytes=990-2000',
+            exp = {
+                {
+                    990,
+                    999,
+                },
+            },
+        },
+        {
+            val = 'Bytes = 500-599, 0-99 ,, 2000-3000',
+            exp = {
+                {
+                    0,
+                    99,
+                },
+                {
+                    500,
+                    599,
+                },
+            },
+        },
+        {
+            -- coalesce the overlapping and adjacent ranges
+            val = 'bytes=0-99,50-149,150-199,-100',
+            exp = {
+                {
+                    0,
+                    199,
+                },
+                {
+                    900,
+                    999,
+                },
+            },
+        },
+    }) do
+        assert.equal(parse(v.val, 1000), v.exp)
+    end
+
+    -- test that returns false if no range is satisfiable
+    assert.is_false(parse('bytes=1000-', 1000))
+    assert.is_false(parse('bytes=-0', 1000))
+    assert.is_false(parse('bytes=0-', 0))
+
+    -- test that returns nil if the value is invalid
+    for _, v in ipairs({
+        'bytes=',
+        'bytes=,',
+        'bytes=-',
+        'bytes=100-50',
+        'bytes=a-b',
+        'items=0-99',
+        '0-99',
+    }) do
+        assert.is_nil(parse(v, 1000))
+    end
+
+    -- test that returns nil if too many ranges
+    assert.is_nil(parse('bytes=0-0,2-2,4-4', 1000, 2))
+end
@@ -5,6 +5,11 @@ local new_responder = require('net.http.responder').new
 local new_response = require('net.http.message.response').new
 local parse_response = require('net.http.parse').response
 local code2reason = require('net.http.status').code2reason
+local template = require('net.http.template')
+local new_request = require('net.http.message.request').new
+local new_filecache = require('net.http.filecache').new
+local new_content = require('net.http.content').new
+local new_reader = require('net.http.reader').new
 
 --- create_response creates a response object from the given string.
 --- @param str string
@@ -420,6 +425,224 @@ function testcase.reply_file()
     assert.is_nil(timeout)
 end
 
+function testcase.reply_file_conditional()
+    local data = ''
+    local writer = {
+        write = function(_, v)
+            data = data .. v
+            return #v
+        end,
+        flush = function()
+        end,
+    }
+    local cache = new_filecache()
+    local pathname = create_tempfile('.txt', 'foo')
+    local req = new_request()
+
+    -- test that set the validators
+    local res = new_responder(writer)
+    res:set_filecache(cache)
+    res:set_request(req)
+    assert(res:reply_file(200, pathname))
+    local msg = create_response(data)
+    data = ''
+    assert.equal(msg.content, 'foo')
+    local etag = msg.header:get('ETag')
+    local last_modified = msg.header:get('Last-Modified')
+    assert.match(etag, '^"%x+-3"$', false)
+    assert.match(last_modified, ' GMT$', false)
+    -- test that the entry of the file cache is released after reply
+    assert.equal(cache.entries[pathname].nref, 0)
+
+    -- test that reply 304 to the matched conditional request
+    for _, v in ipairs({
+        {
+            key = 'If-None-Match',
+            val = '"foo", ' .. etag,
+        },
+        {
+            key = 'If-None-Match',
+            val = 'W/' .. etag,
+        },
+        {
+            key = 'If-None-Match',
+            val = '*',
+        },
+        {
+            key = 'If-Modified-Since',
+            val = last_modified,
+        },
+    }) do
+        req = new_request()
+        req.header:set(v.key, v.val)
+        res = new_responder(writer)
+        res:set_filecache(cache)
+        res:set_request(req)
+        assert(res:reply_file(200, pathname))
+        msg = create_response(data)
+        data = ''
+        assert.equal(msg.status, 304)
+        assert.equal(msg.content, '')
+        assert.is_nil(msg.header:get('Content-Length'))
+        assert.equal(msg.header:get('ETag'), etag)
+    end
+
+    -- test that reply 200 to the unmatched conditional request
+    for _, v in ipairs({
+        {
+            key = 'If-None-Match',
+            val = '"foo"',
+        },
+        {
+            key = 'If-Modified-Since',
+            val = 'Sun, 06 Nov 1994 08:49:37 GMT',
+        },
+    }) do
+        req = new_request()
+        req.header:set(v.key, v.val)
+        res = new_responder(writer)
+        res:set_request(req)
+        assert(res:reply_file(200, pathname))
+        msg = create_response(data)
+        data = ''
+        assert.equal(msg.status, 200)
+        assert.equal(msg.content, 'foo')
+    end
+
+    -- test that ignore the conditional headers of non-GET request
+    req = new_request()
+    req:set_method('POST')
+    req.header:set('If-None-Match', '*')
+    res = new_responder(writer)
+    res:set_request(req)
+    assert(res:reply_file(200, pathname))
+    msg = create_response(data)
+    data = ''
+    assert.equal(msg.status, 200)
+
+    -- test that throws an error if arguments are invalid
+    local err = assert.throws(res.set_request, res, {})
+    assert.match(err, 'req must be net.http.message.request')
+    err = assert.throws(res.set_filecache, res, {})
+    assert.match(err, 'cache must be net.http.filecache')
+end
+
+function testcase.reply_file_range()
+    local data = ''
+    local writer = {
+        write = function(_, v)
+            data = data .. v
+            return #v
+        end,
+        flush = function()
+        end,
+    }
+    local body = 'hello world!'
+    local pathname = create_tempfile('.txt', body)
+
+    --- reply_range replies the file to the request with the header fields.
+    --- @param header table
+    --- @return net.http.message.response msg
+    local function reply_range(header)
+        local req = new_request()
+        for k, v in pairs(header) do
+            req.header:set(k, v)
+        end
+        local res = new_responder(writer)
+        res:set_request(req)
+        assert(res:reply_file(200, pathname))
+        local msg = create_response(data)
+        data = ''
+        return msg
+    end
+
+    -- test that reply the full content with Accept-Ranges header
+    local msg = reply_range({})
+    assert.equal(msg.status, 200)
+    assert.equal(msg.content, body)
+    assert.equal(msg.header:get('Accept-Ranges'), 'bytes')
+    local etag = msg.header:get('ETag')
+    local last_modified = msg.header:get('Last-Modified')
+
+    -- test that reply a single range
+    msg = reply_range({
+        Range = 'bytes=6-10',
+    })
+    assert.equal(msg.status, 206)
+    assert.equal(msg.content, 'world')
+    assert.equal(msg.header:get('Content-Length'), '5')
+    assert.equal(msg.header:get('Content-Range'), 'bytes 6-10/12')
+
+    -- test that reply multiple ranges as multipart/byteranges
+    msg = reply_range({
+        Range = 'bytes=0-4,-1',
+    })
+    assert.equal(msg.status, 206)
+    local boundary = msg.header:get('Content-Type'):match(
+                         '^multipart/byteranges; boundary=(%x+)$')
+    assert(boundary)
+    assert.equal(msg.content, table.concat({
+        '',
+        '--' .. boundary,
+        'Content-Type: text/plain',
+        'Content-Range: bytes 0-4/12',
+        '',
+        'hello',
+        '--' .. boundary,
+        'Content-Type: text/plain',
+        'Content-Range: bytes 11-11/12',
+        '',
+        '!',
+        '--' .. boundary .. '--',
+        '',
+    }, '\r\n'))
+    assert.equal(msg.header:get('Content-Length'), tostring(#msg.content))
+
+    -- test that reply 416 if no range is satisfiable
+    msg = reply_range({
+        Range = 'bytes=100-',
+    })
+    assert.equal(msg.status, 416)
+    assert.equal(msg.content, '')
+    assert.equal(msg.header:get('Content-Range'), 'bytes */12')
+
+    -- test that apply the range if If-Range matches
+    for _, v in ipairs({
+        etag,
+        last_modified,
+    }) do
+        msg = reply_range({
+            Range = 'bytes=0-4',
+            ['If-Range'] = v,
+        })
+        assert.equal(msg.status, 206)
+        assert.equal(msg.content, 'hello')
+    end
+
+    -- test that ignore the range if If-Range does not match or is invalid
+    for _, v in ipairs({
+        {
+            Range = 'bytes=0-4',
+            ['If-Range'] = '"foo"',
+        },
+        {
+            Range = 'bytes=0-4',
+            ['If-Range'] = 'W/' .. etag,
+        },
+        {
+            Range = 'bytes=0-4',
+            ['If-Range'] = 'Sun, 06 Nov 1994 08:49:37 GMT',
+        },
+        {
+            Range = 'bytes=4-0',
+        },
+    }) do
+        msg = reply_range(v)
+        assert.equal(msg.status, 200)
+        assert.equal(msg.content, body)
+    end
+end
+
 function testcase.reply()
     local data = ''
     local writer = {
@@ -596,6 +819,298 @@ function testcase.reply()
     })
 end
 
+function testcase.set_compression()
+    local data = ''
+    local writer = {
+        write = function(_, v)
+            data = data .. v
+            return #v
+        end,
+        flush = function()
+        end,
+    }
+    local body = string.rep('hello world! ', 100)
+
+    -- test that reply compressed content
+    local res = new_responder(writer)
+    assert.equal(res:set_compression('deflate, gzip;q=0.9'), 'deflate')
+    res.header:set('Content-Type', 'text/plain')
+    res.header:set('ETag', '"foo"')
+    assert(res:reply(200, body))
+    local msg = create_response(data)
+    data = ''
+    assert.equal(msg.content:byte(1), 0x78)
+    assert.less(#msg.content, #body)
+    assert.equal(msg.header:get('Content-Length'), tostring(#msg.content))
+    assert.equal(msg.header:get('Content-Encoding'), 'deflate')
+    assert.equal(msg.header:get('Vary'), 'Accept-Encoding')
+    assert.equal(msg.header:get('ETag'), 'W/"foo"')
+
+    -- test that reply uncompressed content with Vary header
+    res = new_responder(writer)
+    assert.is_nil(res:set_compression('br'))
+    res.header:set('Vary', 'Origin')
+    assert(res:reply(200, {
+        message = body,
+    }, true))
+    msg = create_response(data)
+    data = ''
+    assert.is_nil(msg.header:get('Content-Encoding'))
+    assert.equal(msg.header:get('Vary', true), {
+        'Origin',
+        'Accept-Encoding',
+    })
+
+    -- test that not compress the small or incompressible content
+    for _, v in ipairs({
+        {
+            ctype = 'text/plain',
+            body = 'hello',
+        },
+        {
+            ctype = 'image/png',
+            body = body,
+        },
+    }) do
+        res = new_responder(writer)
+        res:set_compression('gzip', {
+            minsize = 16,
+        })
+        res.header:set('Content-Type', v.ctype)
+        assert(res:reply(200, v.body))
+        msg = create_response(data)
+        data = ''
+        assert.equal(msg.content, v.body)
+        assert.is_nil(msg.header:get('Content-Encoding'))
+        assert.is_nil(msg.header:get('Vary'))
+    end
+
+    -- test that serve the precompressed sidecar file
+    local pathname = create_tempfile('.html', body)
+    local f = assert(io.open(pathname .. '.gz', 'w'))
+    f:write('gzipped')
+    f:close()
+    TMPFILES[#TMPFILES + 1] = pathname .. '.gz'
+    res = new_responder(writer)
+    res:set_compression('gzip')
+    assert(res:reply_file(200, pathname))
+    msg = create_response(data)
+    data = ''
+    assert.equal(msg.content, 'gzipped')
+    assert.equal(msg.header:get('Content-Encoding'), 'gzip')
+    assert.equal(msg.header:get('Content-Type'), 'text/html')
+    assert.equal(msg.header:get('Vary'), 'Accept-Encoding')
+
+    -- test that serve the original file if gzip is not acceptable
+    res = new_responder(writer)
+    res:set_compression('deflate')
+    assert(res:reply_file(200, pathname))
+    msg = create_response(data)
+    data = ''
+    assert.equal(msg.content, body)
+    assert.is_nil(msg.header:get('Content-Encoding'))
+    assert.equal(msg.header:get('Vary'), 'Accept-Encoding')
+
+    -- test that write the content compressed in the chunked transfer coding
+    local function new_body_content()
+        local rest = body
+        return new_content(new_reader({
+            read = function(_, n)
+                local s = string.sub(rest, 1, n)
+                rest = string.sub(rest, n + 1)
+                return #s > 0 and s or nil
+            end,
+        }), #body)
+    end
+    res = new_responder(writer)
+    res:set_compression('gzip')
+    res.header:set('Content-Type', 'text/plain')
+    assert(res:write_content(new_body_content()))
+    assert.match(data, 'Transfer-Encoding: chunked\r\n', false)
+    assert.match(data, 'Content-Encoding: gzip\r\n', false)
+    data = ''
+
+    -- test that not compress the content of HTTP/1.0 response without the
+    -- chunked transfer coding
+    for _, setver in ipairs({
+        function(r)
+            r.message:set_version(1.0)
+        end,
+        function(r)
+            local req = new_request()
+            req:set_version(1.0)
+            r:set_request(req)
+        end,
+    }) do
+        res = new_responder(writer)
+        setver(res)
+        res:set_compression('gzip')
+        res.header:set('Content-Type', 'text/plain')
+        assert(res:write_content(new_body_content()))
+        msg = create_response(data)
+        data = ''
+        assert.equal(msg.content, body)
+        assert.equal(msg.header:get('Content-Length'), tostring(#body))
+        assert.is_nil(msg.header:get('Transfer-Encoding'))
+        assert.is_nil(msg.header:get('Content-Encoding'))
+        assert.equal(msg.header:get('Vary'), 'Accept-Encoding')
+    end
+
+    -- test that throws an error if opts is invalid
+    local err = assert.throws(res.set_compression, res, 'gzip', {
+        level = 10,
+    })
+    assert.match(err, 'opts.level must be integer between -1 and 9')
+    err = assert.throws(res.set_compression, res, 'gzip', {
+        minsize = -1,
+    })
+    assert.match(err, 'opts.minsize must be uint')
+end
+
+function testcase.set_template()
+    local data = ''
+    local writer = {
+        write = function(_, v)
+            data = data .. v
+            return #v
+        end,
+        flush = function()
+        end,
+    }
+    local res = new_responder(writer)
+    local tmpl = template.new({
+        ['Server'] = 'example-server',
+        ['Content-Type'] = 'text/html',
+    }, 200)
+
+    -- test that reply() method writes the header fields of the template
+    res:set_template(tmpl)
+    local ok, err, timeout = res:reply(200, 'foo')
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.is_true(ok)
+    local msg = create_response(data)
+    data = ''
+    assert.contains(msg, {
+        reason = 'OK',
+        status = 200,
+        version = 1.1,
+        content = 'foo',
+        header = {
+            dict = {
+                ['content-length'] = {
+                    val = {
+                        '3',
+                    },
+                },
+                ['content-type'] = {
+                    val = {
+                        'text/html',
+                    },
+                },
+                ['server'] = {
+                    val = {
+                        'example-server',
+                    },
+                },
+            },
+        },
+    })
+    assert.equal(#msg.header.dict, 4)
+
+    -- test that the header fields of the template can be overridden
+    res = new_responder(writer)
+    res:set_template(tmpl)
+    res.header:set('Content-Type', 'text/css')
+    ok, err, timeout = res:reply(404, 'foo')
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.is_true(ok)
+    msg = create_response(data)
+    data = ''
+    assert.contains(msg, {
+        reason = 'Not Found',
+        status = 404,
+        header = {
+            dict = {
+                ['content-type'] = {
+                    val = {
+                        'text/css',
+                    },
+                },
+                ['server'] = {
+                    val = {
+                        'example-server',
+                    },
+                },
+            },
+        },
+    })
+
+    -- test that throws an error if tmpl is not net.http.template
+    err = assert.throws(res.set_template, res, {})
+    assert.match(err, 'tmpl must be net.http.template')
+end
+
+function testcase.reply_canned()
+    local data = ''
+    local writer = {
+        write = function(_, v)
+            data = data .. v
+            return #v
+        end,
+        flush = function()
+        end,
+    }
+    local res = new_responder(writer)
+
+    -- test that reply_canned() method writes the canned response
+    res.header:set('Server', 'example-server')
+    local ok, err, timeout = res:reply_canned(431)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.is_true(ok)
+    local msg = create_response(data)
+    assert.contains(msg, {
+        reason = 'Request Header Fields Too Large',
+        status = 431,
+        version = 1.1,
+        content = '431 Request Header Fields Too Large',
+        header = {
+            dict = {
+                ['connection'] = {
+                    val = {
+                        'close',
+                    },
+                },
+                ['content-type'] = {
+                    val = {
+                        'text/plain',
+                    },
+                },
+            },
+        },
+    })
+    assert.is_nil(msg.header:get('Server'))
+    assert.is_string(msg.header:get('Date'))
+
+    -- test that reply_canned() method cannot be called twice
+    ok, err, timeout = res:reply_canned(431)
+    assert.is_false(ok)
+    assert.match(err, 'cannot send a response message twice')
+    assert.is_nil(timeout)
+
+    -- test that reply_canned() method does not send the content to HEAD
+    data = ''
+    local req = new_request()
+    assert(req:set_method('HEAD'))
+    res = new_responder(writer)
+    res:set_request(req)
+    assert(res:reply_canned(400))
+    assert.match(data, 'Content-Length: 15\r\n', false)
+    assert.match(data, 'Connection: close\r\n\r\n$', false)
+end
+
 function testcase.reply1XX_2xx()
     local data = ''
     local writer = {
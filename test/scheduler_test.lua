@@ -0,0 +1,180 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local fork = require('testcase.fork')
+local sleep = require('testcase.timer').sleep
+local new_inet_client = require('net.stream.inet').client.new
+local new_server = require('net.http.server').new
+local new_response = require('net.http.message.response').new
+local new_scheduler = require('net.http.scheduler').new
+local fetch = require('net.http.fetch')
+
+function testcase.new()
+    -- test that create new instance of net.http.scheduler
+    local s = assert(new_scheduler())
+    assert.match(tostring(s), '^net.http.scheduler: ', false)
+
+    -- test that throws an error if opts is not table
+    local err = assert.throws(new_scheduler, true)
+    assert.match(err, 'opts must be table')
+
+    -- test that throws an error if opts.timeout is invalid
+    err = assert.throws(new_scheduler, {
+        timeout = 0,
+    })
+    assert.match(err, 'opts.timeout must be finite-number greater than 0')
+
+    -- test that throws an error if opts.deadline is invalid
+    err = assert.throws(new_scheduler, {
+        deadline = 0,
+    })
+    assert.match(err, 'opts.deadline must be finite-number greater than 0')
+
+    -- test that throws an error if opts.maxevents is invalid
+    err = assert.throws(new_scheduler, {
+        maxevents = 0,
+    })
+    assert.match(err, 'opts.maxevents must be integer greater than 0')
+end
+
+function testcase.spawn()
+    local s = assert(new_scheduler())
+    local res = {}
+
+    -- test that run the tasks with the arguments
+    s:spawn(function(a, b)
+        res[#res + 1] = a
+        res[#res + 1] = b
+    end, 'foo', 'bar')
+    s:spawn(function()
+        res[#res + 1] = 'baz'
+    end)
+    assert(s:run())
+    assert.equal(res, {
+        'foo',
+        'bar',
+        'baz',
+    })
+
+    -- test that the error of the task does not stop the others
+    res = {}
+    s:spawn(function()
+        error('task-error')
+    end)
+    s:spawn(function()
+        res[#res + 1] = 'qux'
+    end)
+    assert(s:run())
+    assert.equal(res, {
+        'qux',
+    })
+
+    -- test that throws an error if fn is not function
+    local err = assert.throws(s.spawn, s, true)
+    assert.match(err, 'fn must be function')
+
+    -- test that throws an error if wait() is called outside of the task
+    err = assert.throws(s.wait, s, 0)
+    assert.match(err, 'must be called from the task')
+end
+
+function testcase.sleep()
+    local s = assert(new_scheduler())
+    local res = {}
+
+    -- test that the sleeping task does not block the others
+    s:spawn(function()
+        s:sleep(0.1)
+        res[#res + 1] = 'foo'
+    end)
+    s:spawn(function()
+        res[#res + 1] = 'bar'
+    end)
+    assert(s:run())
+    assert.equal(res, {
+        'bar',
+        'foo',
+    })
+
+    -- test that throws an error if sleep() is called outside of the task
+    local err = assert.throws(s.sleep, s, 0)
+    assert.match(err, 'must be called from the task')
+end
+
+function testcase.serve()
+    local p = assert(fork())
+    if p:is_child() then
+        local server = assert(new_server('127.0.0.1:8082', {
+            reuseaddr = true,
+            idle_timeout = 1,
+        }))
+        assert(server:listen())
+        local s = assert(new_scheduler({
+            timeout = 1,
+        }))
+        s:serve(server, function(c)
+            local req = c:read_request()
+            while req do
+                local res = new_response()
+                assert(res:write(c, req.uri))
+                assert(c:flush())
+                req = c:read_request()
+            end
+        end)
+        assert(s:run())
+        os.exit(0)
+    end
+    sleep(0.2)
+
+    -- test that the idle connection does not block the other connections
+    local idle = assert(new_inet_client('127.0.0.1', 8082))
+    for _, uri in ipairs({
+        '/foo',
+        '/bar',
+    }) do
+        local res = assert(fetch('http://127.0.0.1:8082' .. uri))
+        assert.equal(res.content:read(), uri)
+    end
+
+    -- test that the idle connection is closed after the timeout
+    sleep(1.2)
+    assert.is_nil(idle:read())
+    idle:close()
+end
+
+function testcase.serve_deadline()
+    local p = assert(fork())
+    if p:is_child() then
+        local server = assert(new_server('127.0.0.1:8083', {
+            reuseaddr = true,
+        }))
+        assert(server:listen())
+        local s = assert(new_scheduler({
+            timeout = 1,
+            deadline = 1,
+        }))
+        s:serve(server, function(c)
+            local req = c:read_request()
+            while req do
+                local res = new_response()
+                assert(res:write(c, req.uri))
+                assert(c:flush())
+                req = c:read_request()
+            end
+        end)
+        assert(s:run())
+        os.exit(0)
+    end
+    sleep(0.2)
+
+    -- test that the slow client is closed after the deadline even though it
+    -- sends the bytes before each read times out
+    local slow = assert(new_inet_client('127.0.0.1', 8083))
+    assert(slow:write('GET / HTTP/1.1\r\n'))
+    for _ = 1, 6 do
+        sleep(0.3)
+        slow:write('X-Slow: true\r\n')
+    end
+    assert.is_nil(slow:read())
+    slow:close()
+end
@@ -10,6 +10,8 @@ local errno = require('errno')
 local fetch = require('net.http.fetch')
 local new_response = require('net.http.message.response').new
 local new_server = require('net.http.server').new
+local server = require('net.http.server')
+local process = require('net.http.process')
 
 local TLS_SERVER_CONFIG
 
@@ -91,6 +93,18 @@ function testcase.new_inet_server()
     -- test that throws an error if opts is not table
     err = assert.throws(new_server, '', true)
     assert.match(err, 'opts must be table')
+
+    -- test that throws an error if opts.max_requests is invalid
+    err = assert.throws(new_server, '127.0.0.1:8080', {
+        max_requests = 0,
+    })
+    assert.match(err, 'opts.max_requests must be integer greater than 0')
+
+    -- test that throws an error if opts.idle_timeout is invalid
+    err = assert.throws(new_server, '127.0.0.1:8080', {
+        idle_timeout = 0,
+    })
+    assert.match(err, 'opts.idle_timeout must be finite-number greater than 0')
 end
 
 function testcase.new_inet_tls_server()
@@ -183,3 +197,138 @@ function testcase.accept()
     assert(res.content:read(), 'hello world!')
 end
 
+
+function testcase.prefork()
+    local spid = process.getpid()
+    local p = assert(fork())
+    if p:is_child() then
+        spid = process.getpid()
+        assert(server.prefork('127.0.0.1:8081', {
+            workers = 1,
+            reuseaddr = true,
+            shutdown_timeout = 1,
+        }, function(s, id)
+            while not server.is_terminated() do
+                local peer = s:accept()
+                if peer then
+                    local req = peer:read_request()
+                    if req and req.path == '/crash' then
+                        os.exit(1)
+                    elseif req then
+                        local res = new_response()
+                        assert(res:write(peer, table.concat({
+                            spid,
+                            id,
+                            process.getpid(),
+                        }, ':')))
+                        assert(peer:flush())
+                    end
+                    peer:close()
+                end
+            end
+        end))
+        os.exit(0)
+    end
+    sleep(0.2)
+
+    -- test that the worker responds
+    local res = assert(fetch('http://127.0.0.1:8081', {
+        pool = false,
+    }))
+    local body = assert(res.content:read())
+    local sid, id, wpid = string.match(body, '^(%d+):(%d+):(%d+)$')
+    assert.not_equal(sid, tostring(spid))
+    assert.equal(id, '1')
+
+    -- test that the crashed worker is restarted
+    fetch('http://127.0.0.1:8081/crash', {
+        pool = false,
+    })
+    sleep(1.2)
+    res = assert(fetch('http://127.0.0.1:8081', {
+        pool = false,
+    }))
+    body = assert(res.content:read())
+    local sid2, id2, wpid2 = string.match(body, '^(%d+):(%d+):(%d+)$')
+    assert.equal(sid2, sid)
+    assert.equal(id2, '1')
+    assert.not_equal(wpid2, wpid)
+
+    -- test that shutdown the workers by SIGTERM
+    assert(process.kill(tonumber(sid), process.SIGTERM))
+    sleep(1.5)
+    local err
+    res, err = fetch('http://127.0.0.1:8081', {
+        pool = false,
+    })
+    assert.is_nil(res)
+    assert(error.is(err, errno.ECONNREFUSED))
+
+    -- test that throws an error if arguments are invalid
+    err = assert.throws(server.prefork, true)
+    assert.match(err, 'addr must be string')
+    err = assert.throws(server.prefork, '127.0.0.1:8081', {
+        workers = 0,
+    })
+    assert.match(err, 'opts.workers must be integer greater than 0')
+    err = assert.throws(server.prefork, '127.0.0.1:8081', {
+        shutdown_timeout = 0,
+    })
+    assert.match(err, 'opts.shutdown_timeout must be finite-number')
+    err = assert.throws(server.prefork, '127.0.0.1:8081', {})
+    assert.match(err, 'handler must be function')
+end
+
+function testcase.prefork_exit()
+    local p = assert(fork())
+    if p:is_child() then
+        assert(server.prefork('127.0.0.1:8085', {
+            workers = 1,
+            reuseaddr = true,
+        }, function(s)
+            -- exit normally after the first request
+            local peer = assert(s:accept())
+            local req = assert(peer:read_request())
+            local res = new_response()
+            assert(res:write(peer, req.path))
+            assert(peer:flush())
+            peer:close()
+        end))
+        os.exit(0)
+    end
+    sleep(0.2)
+
+    local res = assert(fetch('http://127.0.0.1:8085/exit', {
+        pool = false,
+    }))
+    assert.equal(res.content:read(), '/exit')
+
+    -- test that the worker that exits normally is not restarted
+    sleep(1.5)
+    local err
+    res, err = fetch('http://127.0.0.1:8085', {
+        pool = false,
+    })
+    assert.is_nil(res)
+    assert(error.is(err, errno.ECONNREFUSED))
+end
+
+function testcase.prefork_unsupported()
+    -- test that returns ENOTSUP error if net.http.process is not available
+    package.loaded['net.http.server'] = nil
+    package.loaded['net.http.process'] = nil
+    package.preload['net.http.process'] = function()
+        assert(false, 'module not found')
+    end
+    local ok, s = pcall(require, 'net.http.server')
+    package.preload['net.http.process'] = nil
+    package.loaded['net.http.process'] = process
+    package.loaded['net.http.server'] = server
+    assert(ok, s)
+    local err
+    ok, err = s.prefork('127.0.0.1:8081', nil, function()
+    end)
+    assert.is_false(ok)
+    assert.equal(err.type, errno.ENOTSUP)
+    assert.is_false(s.is_terminated())
+end
@@ -0,0 +1,94 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local new_header = require('net.http.header').new
+local template = require('net.http.template')
+local new_template = template.new
+
+function testcase.new()
+    local h = new_header()
+    h:set('server', 'example-server')
+    h:add('cache-control', 'no-cache')
+
+    -- test that compile header fields into block
+    local tmpl = new_template(h)
+    assert.match(tostring(tmpl), '^net.http.template: ', false)
+    assert.equal(tmpl.block, table.concat({
+        'Server: example-server',
+        'Cache-Control: no-cache',
+    }, '\r\n') .. '\r\n')
+    assert.is_nil(tmpl.line)
+    assert.is_true(tmpl:has('SERVER'))
+    assert.is_false(tmpl:has('Date'))
+
+    -- test that compile status-line
+    tmpl = new_template(h, 404)
+    assert.equal(tmpl.status, 404)
+    assert.equal(tmpl.version, 1.1)
+    assert.equal(tmpl.line, 'HTTP/1.1 404 Not Found\r\n')
+
+    -- test that compile table
+    tmpl = new_template({
+        ['x-foo'] = 'bar',
+    })
+    assert.equal(tmpl.block, 'X-Foo: bar\r\n')
+
+    -- test that throws an error if header is invalid
+    local err = assert.throws(new_template, 'foo')
+    assert.match(err, 'header must be table or net.http.header')
+
+    -- test that throws an error if status code is unsupported
+    err = assert.throws(new_template, h, 999)
+    assert.match(err, 'unsupported status code')
+end
+
+function testcase.merge()
+    local tmpl = new_template({
+        ['server'] = 'example-server',
+        ['x-foo'] = 'bar',
+    })
+    local h = new_header()
+    h:set('Date', 'now')
+    assert.is_false(tmpl:is_overridden(h))
+
+    -- test that merge the header fields that are not overridden
+    h:set('x-foo', 'baz')
+    assert.is_true(tmpl:is_overridden(h))
+    tmpl:merge(h)
+    assert.equal(h:get('x-foo'), 'baz')
+    assert.equal(h:get('server'), 'example-server')
+end
+
+function testcase.canned()
+    -- test that return the pre-serialized response
+    local res = template.canned(400)
+    assert.equal(res.head, 'HTTP/1.1 400 Bad Request\r\nDate: ')
+    assert.equal(res.tail, table.concat({
+        '',
+        'Content-Type: text/plain',
+        'Content-Length: 15',
+        'Connection: close',
+        '',
+        '',
+    }, '\r\n'))
+    assert.equal(res.content, '400 Bad Request')
+
+    -- test that return the same response
+    assert.equal(template.canned(400), res)
+    assert.is_true(rawequal(template.canned(400), res))
+
+    -- test that throws an error if status code is unsupported
+    local err = assert.throws(template.canned, 999)
+    assert.match(err, 'unsupported status code')
+
+    -- test that throws an error if status code cannot have a content
+    for _, code in ipairs({
+        100,
+        101,
+        204,
+        304,
+    }) do
+        err = assert.throws(template.canned, code)
+        assert.match(err, 'cannot have a content')
+    end
+end